@@ -0,0 +1,122 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_ALLOCATOR_FRONT_END_HPP
+#define VEIL_FABRIC_SRC_MEMORY_ALLOCATOR_FRONT_END_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/vm/errors.hpp"
+
+namespace veil::memory {
+
+    /// A front end of an \c Allocator specialized at compile time to the algorithm specific allocator \c T, for the
+    /// hot paths of the runtime which the algorithm is known statically. The operations are first served by the inline
+    /// fast paths \c T::try_allocate, \c T::try_acquire and \c T::try_release, which do not construct any request;
+    /// the rest are served by the slow paths invoking the methods of \c T without the virtual dispatch.
+    /// <br><br>
+    /// The errors are reported by \c AllocatorFrontEnd::get_error instead of the requests, an operation failing with
+    /// an error returns \c nullptr.
+    /// \attention The front end must only be used by the thread owning the allocator, and the allocator must be
+    /// created by the \c Management of the algorithm of \c T.
+    template<typename T>
+    class AllocatorFrontEnd : public ValueObject {
+    public:
+        /// \param allocator An allocator of type \c T returned by \c Management::create_allocator.
+        explicit AllocatorFrontEnd(Allocator &allocator);
+
+        /// \return The pointer of a memory sector of \a size, or \c nullptr if the allocation fails.
+        inline Pointer *allocate(uint64 size);
+
+        /// \return The current address of the acquired \a pointer, or \c nullptr if the acquisition fails.
+        inline uint8 *acquire(Pointer *pointer, bool exclusive = false);
+
+        inline void release(Pointer *pointer);
+
+        /// \return The error of the last failed operation, or \c ERR_NONE if none of the operations failed.
+        [[nodiscard]] uint32 get_error() const;
+
+        T &get_allocator();
+
+    private:
+        T &allocator;
+        uint32 error;
+
+        Pointer *allocate_slow(uint64 size);
+
+        uint8 *acquire_slow(Pointer *pointer, bool exclusive);
+
+        void release_slow(Pointer *pointer);
+    };
+
+    template<typename T>
+    AllocatorFrontEnd<T>::AllocatorFrontEnd(Allocator &allocator) :
+            allocator(static_cast<T &>(allocator)), error(ERR_NONE) {}
+
+    template<typename T>
+    inline Pointer *AllocatorFrontEnd<T>::allocate(uint64 size) {
+        Pointer *pointer = this->allocator.try_allocate(size);
+        return pointer ? pointer : this->allocate_slow(size);
+    }
+
+    template<typename T>
+    inline uint8 *AllocatorFrontEnd<T>::acquire(Pointer *pointer, bool exclusive) {
+        uint8 *address = this->allocator.try_acquire(pointer, exclusive);
+        return address ? address : this->acquire_slow(pointer, exclusive);
+    }
+
+    template<typename T>
+    inline void AllocatorFrontEnd<T>::release(Pointer *pointer) {
+        if (!this->allocator.try_release(pointer)) this->release_slow(pointer);
+    }
+
+    template<typename T>
+    uint32 AllocatorFrontEnd<T>::get_error() const { return this->error; }
+
+    template<typename T>
+    T &AllocatorFrontEnd<T>::get_allocator() { return this->allocator; }
+
+    // The methods of T are invoked with the qualified names, thus they are bound statically.
+
+    template<typename T>
+    Pointer *AllocatorFrontEnd<T>::allocate_slow(uint64 size) {
+        AllocateRequest request(size);
+        Pointer *pointer = this->allocator.T::allocate(request);
+        if (!request.is_ok()) this->error = request.get_error();
+        return pointer;
+    }
+
+    template<typename T>
+    uint8 *AllocatorFrontEnd<T>::acquire_slow(Pointer *pointer, bool exclusive) {
+        PointerAcquireRequest request(pointer, exclusive);
+        this->allocator.T::acquire(request);
+        if (!request.is_ok()) {
+            this->error = request.get_error();
+            return nullptr;
+        }
+        return request.get_address();
+    }
+
+    template<typename T>
+    void AllocatorFrontEnd<T>::release_slow(Pointer *pointer) {
+        PointerActionRequest request(pointer);
+        this->allocator.T::release(request);
+        if (!request.is_ok()) this->error = request.get_error();
+    }
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_ALLOCATOR_FRONT_END_HPP
@@ -14,8 +14,10 @@
 /// along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <cassert>
+#include <cstring>
 
 #include "src/memory/global.hpp"
+#include "src/memory/heap-cache.hpp"
 #include "src/memory/os.hpp"
 #include "src/vm/diagnostics.hpp"
 
@@ -25,82 +27,229 @@
 
 using namespace veil::memory;
 
+#if defined(VEIL_ENABLE_DEBUG)
+
+/// In the debug builds each object is prefixed by a header recording its size, which is checked against the size
+/// provided to the deletion; thus an object deleted via a base class without a virtual destructor is caught, instead of
+/// returning its block to the free list of another size class. The header keeps the object aligned to 16 bytes.
+static const uint64 OBJECT_SIZE_HEADER = 16;
+
+#endif
+
 void *HeapObject::operator new(size_t size) {
-    void *object = os::malloc(size);
 #   if defined(VEIL_ENABLE_PROFILING)
-    ((HeapObject *) object)->allocated_size = size;
-    uint64 _ = os_heap_allocated_size.fetch_add(size);
+    AllocationSampler::sample(size);
 #   endif
+#   if defined(VEIL_ENABLE_DEBUG)
+    auto *block = static_cast<uint8 *>(HeapCache::allocate(size + OBJECT_SIZE_HEADER));
+    VeilAssert(block != nullptr, "Failed to allocate memory from the OS heap.");
+    *reinterpret_cast<uint64 *>(block) = size;
+    return block + OBJECT_SIZE_HEADER;
+#   else
+    void *object = HeapCache::allocate(size);
     VeilAssert(object != nullptr, "Failed to allocate memory from the OS heap.");
     return object;
+#   endif
 }
 
-void HeapObject::operator delete(void *address) {
-#   if defined(VEIL_ENABLE_PROFILING)
-    uint64 _ = os_heap_allocated_size.fetch_sub(((HeapObject *) address)->allocated_size);
+void HeapObject::operator delete(void *address, size_t size) {
+    if (address == nullptr) return;
+#   if defined(VEIL_ENABLE_DEBUG)
+    uint8 *block = static_cast<uint8 *>(address) - OBJECT_SIZE_HEADER;
+    VeilAssert(*reinterpret_cast<uint64 *>(block) == size,
+               "Object deleted with a size different from its allocation, its destructor must be virtual.");
+    HeapCache::free(block, size + OBJECT_SIZE_HEADER);
+#   else
+    HeapCache::free(address, size);
 #   endif
-    os::free(address);
 }
 
-Region::Region(uint32 pool_size) : pool_size(pool_size), next(nullptr) {
+/// Pad the \a address forward to the next multiple of \a alignment.
+static uint8 *align_up(uint8 *address, uint32 alignment) {
+    VeilAssert(alignment != 0 && (alignment & (alignment - 1)) == 0, "Alignment must be a power of 2.");
+    auto value = reinterpret_cast<uint64>(address);
+    return reinterpret_cast<uint8 *>((value + alignment - 1) & ~(static_cast<uint64>(alignment) - 1));
+}
+
+Region::Region(uint64 pool_size) : pool_size(pool_size), live_map(nullptr), dead_count(0) {
     this->pool = static_cast<uint8 *>(os::malloc(pool_size));
     // The bump address will be at the start of the pool address.
     this->bump = this->pool;
 }
 
-void *Region::allocate(uint32 size) {
-    if (this->bump + size >= this->pool + this->pool_size) {
+void *Region::allocate(uint32 size, uint32 alignment) {
+    uint8 *aligned = align_up(this->bump, alignment);
+    if (aligned + size > this->pool + this->pool_size) {
         return nullptr;
     }
 
-    void *alloc = this->bump;
-    this->bump += size;
-    return alloc;
+    this->bump = aligned + size;
+    return aligned;
+}
+
+bool Region::contains(const void *address) const {
+    auto *target = static_cast<const uint8 *>(address);
+    return target >= this->pool && target < this->pool + this->pool_size;
 }
 
-Region::~Region() { veil::os::free(this->pool); }
+uint8 *Region::slot_base(uint32 alignment) const { return align_up(this->pool, alignment); }
 
-Arena::Arena(uint32 pool_size) : pool_size(pool_size), base(new Region(pool_size)) {}
+uint32 Region::slot_count(uint32 slot_size, uint32 alignment) const {
+    uint8 *base = this->slot_base(alignment);
+    return this->bump > base ? static_cast<uint32>((this->bump - base) / slot_size) : 0;
+}
 
-void *Arena::allocate(uint32 size) {
-    void *address = base->allocate(size);
+uint64 *Region::ensure_live_map(uint32 slot_size) {
+    if (this->live_map == nullptr) {
+        uint64 word_count = (this->pool_size / slot_size + 63) / 64;
+        this->live_map = static_cast<uint64 *>(os::malloc(word_count * sizeof(uint64)));
+        memset(this->live_map, 0, word_count * sizeof(uint64));
+    }
+    return this->live_map;
+}
+
+Region::~Region() {
+    veil::os::free(this->pool);
+    if (this->live_map != nullptr) veil::os::free(this->live_map);
+}
+
+Arena::Arena(uint32 pool_size) : pool_size(pool_size), base(new Region(pool_size)), region_count(0),
+                                 directory_capacity(DEFAULT_DIRECTORY_CAPACITY) {
+    this->directory = static_cast<Region **>(os::malloc(this->directory_capacity * sizeof(Region *)));
+    this->append_region(this->base);
+}
+
+void Arena::append_region(Region *region) {
+    if (this->region_count == this->directory_capacity) {
+        // The directory is doubled in capacity, the amortized cost of appending a region is constant.
+        auto **inflated = static_cast<Region **>(os::malloc(this->directory_capacity * 2 * sizeof(Region *)));
+        memcpy(inflated, this->directory, this->region_count * sizeof(Region *));
+        os::free(this->directory);
+        this->directory = inflated;
+        this->directory_capacity *= 2;
+    }
+    this->directory[this->region_count++] = region;
+}
+
+void *Arena::allocate(uint32 size, uint32 alignment) {
+#   if defined(VEIL_ENABLE_PROFILING)
+    AllocationSampler::sample(size);
+#   endif
+    void *address = base->allocate(size, alignment);
     if (!address) {
-        address = this->inflate(size);
+        address = this->inflate(size, alignment);
     }
     // The address from inflation will not be nullptr.
     return address;
 }
 
-void *Arena::inflate(uint32 init_offset) {
+void *Arena::inflate(uint32 init_offset, uint32 alignment) {
+    // The worst case padding required to align the memory section within a fresh pool.
+    uint64 padded_size = static_cast<uint64>(init_offset) + alignment - 1;
+    if (padded_size > this->pool_size) {
+        // The memory section will never fit into a regular region, a dedicated region is used without replacing the
+        // base region, so that the remaining space of the base region is still available to the subsequent allocations.
+        auto *dedicated = new Region(padded_size);
+        this->append_region(dedicated);
+
+        return dedicated->allocate(init_offset, alignment);
+    }
+
     auto *inflated = new Region(this->pool_size);
-    inflated->next = this->base;
+    this->append_region(inflated);
     this->base = inflated;
+    // Grow the pool size of the next region geometrically until it reaches the cap.
+    if (this->pool_size < MAX_POOL_SIZE)
+        this->pool_size = this->pool_size > MAX_POOL_SIZE / 2 ? MAX_POOL_SIZE : this->pool_size * 2;
 
-    return inflated->allocate(init_offset);
+    return inflated->allocate(init_offset, alignment);
 }
 
 void Arena::free() {
-    Region *target = this->base;
-    while (target) {
-        Region *next = target->next;
-        delete target;
-        target = next;
-    }
+    for (uint32 region_index = 0; region_index < this->region_count; region_index++)
+        delete this->directory[region_index];
+    os::free(this->directory);
+    this->directory = nullptr;
+    this->region_count = 0;
+    this->directory_capacity = 0;
+    this->base = nullptr;
 }
 
-Arena::Iterator::Iterator(Arena &arena) : target(arena.base), offset(0) {}
+Arena::Iterator::Iterator(Arena &arena) : arena(&arena), region_index(0), offset(0) {}
 
-void *Arena::Iterator::next(uint64 step) {
-    while (this->target) {
-        uint8 *offed = this->target->pool + this->offset;
+void *Arena::Iterator::next(uint64 step, uint32 alignment) {
+    while (this->region_index < this->arena->region_count) {
+        Region *target = this->arena->directory[this->region_index];
+        // The elements are padded identically as Region::allocate, as long as the same alignment is provided.
+        uint8 *offed = align_up(target->pool + this->offset, alignment);
         if (offed + step <= target->bump) {
-            this->offset += step;
+            this->offset = offed + step - target->pool;
             return offed;
         }
-        else if (this->target->next) {
-            this->target = target->next;
-            this->offset = 0;
-        } else break;
+        this->region_index++;
+        this->offset = 0;
     }
     return nullptr;
 }
+
+SegregatedArena::SegregatedArena(uint32 pool_size) : embedded(pool_size), free_lists(), oversize_free_list(nullptr) {}
+
+uint32 SegregatedArena::round_to_size_class(uint32 size) {
+    // A zero sized allocation still occupies a slot, as the slot must be able to hold the free list header when freed.
+    if (size == 0) return SIZE_CLASS_GRANULE;
+    // Rounded in 64 bits, as a size within a granule of 4GiB overflows 32 bits once rounded; such a size is kept as is,
+    // it is an oversize slot which is matched by its exact size anyway.
+    uint64 rounded = (static_cast<uint64>(size) + SIZE_CLASS_GRANULE - 1) / SIZE_CLASS_GRANULE * SIZE_CLASS_GRANULE;
+    return rounded > UINT32_MAX ? size : static_cast<uint32>(rounded);
+}
+
+void *SegregatedArena::allocate(uint32 size) {
+    uint32 class_size = round_to_size_class(size);
+
+    if (class_size <= MAX_SIZE_CLASS_SIZE) {
+        FreeSlot **free_list = &this->free_lists[class_size / SIZE_CLASS_GRANULE - 1];
+        if (*free_list != nullptr) {
+            FreeSlot *reused = *free_list;
+            *free_list = reused->next;
+            return reused;
+        }
+        return this->embedded.allocate(class_size);
+    }
+
+    // Oversize slots are only reused by an allocation of the exact same rounded size, splitting a larger slot would
+    // leave a remainder which is not trackable without a per-slot header.
+    FreeSlot *previous = nullptr, *current = this->oversize_free_list;
+    while (current != nullptr) {
+        if (current->size == class_size) {
+            if (previous == nullptr) this->oversize_free_list = current->next;
+            else previous->next = current->next;
+            return current;
+        }
+        previous = current;
+        current = current->next;
+    }
+    return this->embedded.allocate(class_size);
+}
+
+void SegregatedArena::deallocate(void *address, uint32 size) {
+    if (address == nullptr) return;
+
+    uint32 class_size = round_to_size_class(size);
+    auto *freed = static_cast<FreeSlot *>(address);
+    freed->size = class_size;
+
+    if (class_size <= MAX_SIZE_CLASS_SIZE) {
+        FreeSlot **free_list = &this->free_lists[class_size / SIZE_CLASS_GRANULE - 1];
+        freed->next = *free_list;
+        *free_list = freed;
+    } else {
+        freed->next = this->oversize_free_list;
+        this->oversize_free_list = freed;
+    }
+}
+
+void SegregatedArena::free() {
+    this->embedded.free();
+    for (FreeSlot *&free_list: this->free_lists) free_list = nullptr;
+    this->oversize_free_list = nullptr;
+}
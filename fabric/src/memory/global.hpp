@@ -19,6 +19,8 @@
 #include <cstddef>
 
 #include "src/typedefs.hpp"
+#include "src/util/bits.hpp"
+#include "src/vm/diagnostics.hpp"
 
 namespace veil::memory {
 
@@ -27,21 +29,18 @@ namespace veil::memory {
 
     /// All VM objects which will be allocated in the process heap should extend this class, this class provides a
     /// generalized backend of how the memory is allocated, and log error and force terminate the process on a failed
-    /// allocation.
+    /// allocation. The allocations are served by the thread caching front-end \c HeapCache.
+    /// \attention The object is deallocated with its size, thus an object must be deleted with its exact type or via a
+    /// virtual destructor; the size is verified on the deletion in the debug builds.
     class HeapObject {
     public:
         void *operator new(size_t size);
 
-        void operator delete(void *address);
+        void operator delete(void *address, size_t size);
 
         void *operator new[](size_t size) = delete;
 
         void operator delete[](void *address) = delete;
-
-#   if defined(VEIL_ENABLE_PROFILING)
-    private:
-        std::size_t allocated_size = 0;
-#   endif
     };
 
     /// All VM objects that only allocate on the program stack or embedded directly to its parent object should extend
@@ -59,62 +58,185 @@ namespace veil::memory {
     class ArenaObject {
     };
 
+    /// The byte size of a cache line of the host processor, objects which are contended by multiple threads should be
+    /// aligned to this value to avoid sharing a cache line with their neighbours.
+    static const uint32 CACHE_LINE_SIZE = 64;
+
+    /// A bump allocator which allocates from a directory of \c Region, when the current region is exhausted a new
+    /// region is inflated with twice the pool size of the previous one until \c Arena::MAX_POOL_SIZE is reached, thus a
+    /// bulk of allocations only costs a logarithmic number of allocations from the host heap. Any allocation which is
+    /// not able to fit into a freshly inflated region is served by a dedicated region of its own size.
+    /// <br><br>
+    /// The regions are indexed by a compact directory in the order of their inflation, thus iterating the arena visits
+    /// the memory sections in the order of allocation without chasing pointers between regions.
     class Arena : public ValueObject {
     public:
         class Iterator;
 
         static const uint32 DEFAULT_POOL_SIZE = 4096;
+        /// The cap of the pool size of the geometrically growing regions.
+        static const uint32 MAX_POOL_SIZE = 1 << 20;
 
         explicit Arena(uint32 pool_size = DEFAULT_POOL_SIZE);
 
-        void *allocate(uint32 size);
+        /// Allocate a memory section from the arena.
+        /// \param size      The byte size of the memory section.
+        /// \param alignment The byte alignment of the returned address, must be a power of 2.
+        /// \return          The address of the memory section.
+        void *allocate(uint32 size, uint32 alignment = 1);
 
-        void *inflate(uint32 init_offset);
+        /// Inflate the arena with a new region and allocate the memory section from it, the new region becomes the
+        /// base region for subsequent allocations, unless the memory section is too large for a regular region which
+        /// a dedicated region is appended to the directory without replacing the base region.
+        /// \param init_offset The byte size of the memory section to be allocated from the new region.
+        /// \param alignment   The byte alignment of the memory section, must be a power of 2.
+        /// \return            The address of the memory section.
+        void *inflate(uint32 init_offset, uint32 alignment = 1);
 
         void free();
 
     private:
+        /// The initial capacity of the region directory.
+        static const uint32 DEFAULT_DIRECTORY_CAPACITY = 8;
+
+        /// The pool size of the next region to be inflated.
         uint32 pool_size;
+        /// The region which the allocations are bumped from.
         Region *base;
+        /// All regions of this arena in the order of their inflation.
+        Region **directory;
+        uint32 region_count;
+        uint32 directory_capacity;
+
+        /// Append the \a region to the end of the directory, the directory is doubled in capacity if it is full.
+        void append_region(Region *region);
 
         friend class Arena::Iterator;
+
+        template<typename T>
+        friend class TArena;
+
+        template<typename T>
+        friend class TArenaIterator;
     };
 
     class Region : public HeapObject {
     public:
 
-        explicit Region(uint32 pool_size);
+        /// \param pool_size The byte size of the pool, which is 64-bit as a dedicated region holding an allocation
+        ///                  close to 4GiB exceeds 32 bits once padded.
+        explicit Region(uint64 pool_size);
 
         ~Region();
 
-        void *allocate(uint32 size);
+        /// Allocate a memory section by bumping the address forward, the bump address is first padded to \a alignment.
+        /// \return The address of the memory section, or \c nullptr if the pool cannot fit the padded memory section.
+        void *allocate(uint32 size, uint32 alignment = 1);
+
+        /// \return Whether the \a address is located within the pool of this region.
+        [[nodiscard]] bool contains(const void *address) const;
 
     private:
         uint64 pool_size;
         uint8 *pool;
         uint8 *bump;
 
-        Region *next;
+        /// The live-object bitmap of the fixed size slots allocated from this region by a \c TArena, which a set bit
+        /// marks the slot of the same index to be holding a live object; \c nullptr if no slot is allocated yet.
+        uint64 *live_map;
+        /// The number of slots deallocated from this region and yet to be reused.
+        uint32 dead_count;
+
+        /// \return The address of the first slot of the pool aligned to \a alignment.
+        [[nodiscard]] uint8 *slot_base(uint32 alignment) const;
+
+        /// \return The number of slots of \a slot_size that have been bumped from the pool.
+        [[nodiscard]] uint32 slot_count(uint32 slot_size, uint32 alignment) const;
+
+        /// \return The live-object bitmap of this region, which is allocated on the first call with a capacity of all
+        ///         slots of \a slot_size that are able to fit into the pool.
+        uint64 *ensure_live_map(uint32 slot_size);
 
         friend class Arena;
 
         friend class Arena::Iterator;
+
+        template<typename T>
+        friend class TArena;
+
+        template<typename T>
+        friend class TArenaIterator;
     };
 
     class Arena::Iterator : public ValueObject {
     public:
         explicit Iterator(Arena &arena);
 
-        void *next(uint64 step);
+        /// \param step      The byte size of each element.
+        /// \param alignment The byte alignment of each element, must be the same value used in the allocation.
+        /// \return          The address of the next element, or \c nullptr if the arena is exhausted.
+        void *next(uint64 step, uint32 alignment = 1);
 
     private:
-        Region *target;
+        Arena *arena;
+        uint32 region_index;
         uint64 offset;
     };
 
+    /// An arena which segregates its allocations into size classes of \c SegregatedArena::SIZE_CLASS_GRANULE bytes,
+    /// each size class keeps a free list of the slots returned by \c SegregatedArena::deallocate which will be reused
+    /// by the subsequent allocations of the same size class, thus a workload with a steady allocation pattern will
+    /// reach a fixed memory footprint instead of inflating the embedded \c Arena indefinitely.
+    /// \attention The free lists are threaded through the freed slots themselves, there is no per-slot header, thus the
+    /// caller must provide the same size to \c SegregatedArena::deallocate as it did to \c SegregatedArena::allocate.
+    class SegregatedArena : public ValueObject {
+    public:
+        /// The byte granularity of the size classes, all allocations are rounded up to a multiple of this value.
+        static const uint32 SIZE_CLASS_GRANULE = 16;
+        /// The number of size classes which have their own free list.
+        static const uint32 SIZE_CLASS_COUNT = 32;
+        /// The largest allocation which can be served by a size class, allocations larger than this value shares a
+        /// single free list matched by the exact rounded size.
+        static const uint32 MAX_SIZE_CLASS_SIZE = SIZE_CLASS_GRANULE * SIZE_CLASS_COUNT;
+
+        explicit SegregatedArena(uint32 pool_size = Arena::DEFAULT_POOL_SIZE);
+
+        /// Allocate a slot from the free list of the size class of \a size, or from the embedded \c Arena if the free
+        /// list is empty.
+        /// \param size The byte size of the allocation.
+        /// \return     The address of the allocated slot.
+        void *allocate(uint32 size);
+
+        /// Return a slot to the free list of its size class for reuse.
+        /// \param address The address of the slot returned from \c SegregatedArena::allocate.
+        /// \param size    The byte size provided to \c SegregatedArena::allocate when allocating this slot.
+        void deallocate(void *address, uint32 size);
+
+        /// Release all memory held by the embedded \c Arena, all slots become invalid after this call.
+        void free();
+
+    private:
+        /// The header written into a freed slot to link it into the free list.
+        struct FreeSlot {
+            FreeSlot *next;
+            /// The rounded byte size of the slot, only used by the free list of the oversize slots.
+            uint32 size;
+        };
+
+        Arena embedded;
+        FreeSlot *free_lists[SIZE_CLASS_COUNT];
+        /// The free list of slots larger than \c SegregatedArena::MAX_SIZE_CLASS_SIZE.
+        FreeSlot *oversize_free_list;
+
+        static uint32 round_to_size_class(uint32 size);
+    };
+
     template<typename T>
     class TArenaIterator;
 
+    /// An arena of fixed size slots of type \c T, each region of the embedded \c Arena keeps a live-object bitmap of
+    /// its slots, thus the slots returned by \c TArena<T>::deallocate are skipped by \c TArenaIterator<T> without being
+    /// touched, and are reused by the subsequent allocations.
     template<typename T>
     class TArena {
     public:
@@ -122,23 +244,80 @@ namespace veil::memory {
 
         explicit TArena(uint32 pool_len = DEFAULT_POOL_LEN);
 
+        /// Allocate an uninitialized slot, a dead slot is reused if there is any.
+        /// \return The address of the slot, which the object should be constructed with the placement new.
         T *allocate();
 
+        /// Mark the slot of the \a object as dead, the slot will be reused by the subsequent allocations.
+        /// \attention The \a object must be destructed by the caller beforehand.
+        /// \param object The object allocated from this arena.
+        void deallocate(T *object);
+
         void destruct_objects();
 
         void free();
 
     private:
         Arena embedded;
+        /// The number of dead slots of all regions, used to skip the search of a dead slot if there is none.
+        uint32 dead_count;
 
         friend class TArenaIterator<T>;
     };
 
+    // The pool is padded by alignof(T) - 1 bytes, as the pool address from the host heap might need to be padded to
+    // align the first object, so that each region is still able to fit pool_len objects.
     template<typename T>
-    TArena<T>::TArena(uint32 pool_len) : embedded(sizeof(T) * pool_len) {}
+    TArena<T>::TArena(uint32 pool_len) : embedded(sizeof(T) * pool_len + alignof(T) - 1), dead_count(0) {}
 
     template<typename T>
-    T *TArena<T>::allocate() { return static_cast<T *>(embedded.allocate(sizeof(T))); }
+    T *TArena<T>::allocate() {
+        if (this->dead_count > 0) {
+            for (uint32 region_index = 0; region_index < this->embedded.region_count; region_index++) {
+                Region *region = this->embedded.directory[region_index];
+                if (region->dead_count == 0) continue;
+                uint32 slot_count = region->slot_count(sizeof(T), alignof(T));
+                for (uint32 word_index = 0; word_index * 64 < slot_count; word_index++) {
+                    uint64 vacant = ~region->live_map[word_index];
+                    if (vacant == 0) continue;
+                    uint32 slot_index = word_index * 64 + util::count_trailing_zeros(vacant);
+                    // The vacant bits beyond the bumped slots are not dead slots.
+                    if (slot_index >= slot_count) break;
+                    region->live_map[word_index] |= 1ULL << (slot_index % 64);
+                    region->dead_count--;
+                    this->dead_count--;
+                    uint8 *slot = region->slot_base(alignof(T)) + static_cast<uint64>(slot_index) * sizeof(T);
+                    return reinterpret_cast<T *>(slot);
+                }
+            }
+        }
+
+        auto *address = static_cast<uint8 *>(this->embedded.allocate(sizeof(T), alignof(T)));
+        // The pool of a regular region always fits a slot, thus the slot is always bumped from the base region.
+        Region *region = this->embedded.base;
+        VeilAssert(region->contains(address), "Slot is not allocated from the base region.");
+        uint64 *live_map = region->ensure_live_map(sizeof(T));
+        auto slot_index = static_cast<uint32>((address - region->slot_base(alignof(T))) / sizeof(T));
+        live_map[slot_index / 64] |= 1ULL << (slot_index % 64);
+        return reinterpret_cast<T *>(address);
+    }
+
+    template<typename T>
+    void TArena<T>::deallocate(T *object) {
+        auto *address = reinterpret_cast<uint8 *>(object);
+        for (uint32 region_index = 0; region_index < this->embedded.region_count; region_index++) {
+            Region *region = this->embedded.directory[region_index];
+            if (!region->contains(address)) continue;
+            auto slot_index = static_cast<uint32>((address - region->slot_base(alignof(T))) / sizeof(T));
+            uint64 slot_bit = 1ULL << (slot_index % 64);
+            VeilAssert(region->live_map[slot_index / 64] & slot_bit, "Deallocating a dead slot.");
+            region->live_map[slot_index / 64] &= ~slot_bit;
+            region->dead_count++;
+            this->dead_count++;
+            return;
+        }
+        veil::implementation_fault("Deallocating an object not allocated from this arena.", VeilGetLineInfo);
+    }
 
     template<typename T>
     void TArena<T>::destruct_objects() {
@@ -157,25 +336,51 @@ namespace veil::memory {
     template<typename T>
     void TArena<T>::free() {
         this->embedded.free();
+        this->dead_count = 0;
     }
 
+    /// Iterates the live objects of a \c TArena<T> in the order of allocation, the dead slots are skipped by scanning
+    /// the live-object bitmap of each region a word at a time.
     template<typename T>
-    class TArenaIterator : public Arena::Iterator {
+    class TArenaIterator : public ValueObject {
     public:
         explicit TArenaIterator(TArena<T> &arena);
 
+        /// \return The next live object, or \c nullptr if all live objects are iterated.
         T *next();
 
     private:
         TArena<T> *arena;
+        uint32 region_index;
+        uint32 slot_index;
     };
 
     template<typename T>
-    TArenaIterator<T>::TArenaIterator(TArena<T> &arena) : Arena::Iterator(arena.embedded) {}
+    TArenaIterator<T>::TArenaIterator(TArena<T> &arena) : arena(&arena), region_index(0), slot_index(0) {}
 
     template<typename T>
     T *TArenaIterator<T>::next() {
-        return static_cast<T *>(this->Arena::Iterator::next(sizeof(T)));
+        Arena &embedded = this->arena->embedded;
+        while (this->region_index < embedded.region_count) {
+            Region *region = embedded.directory[this->region_index];
+            uint32 slot_count = region->live_map != nullptr ? region->slot_count(sizeof(T), alignof(T)) : 0;
+            while (this->slot_index < slot_count) {
+                uint32 word_index = this->slot_index / 64;
+                // Mask off the bits of the slots before the current slot index.
+                uint64 live = region->live_map[word_index] & (~0ULL << (this->slot_index % 64));
+                if (live == 0) {
+                    this->slot_index = (word_index + 1) * 64;
+                    continue;
+                }
+                uint32 found = word_index * 64 + util::count_trailing_zeros(live);
+                if (found >= slot_count) break;
+                this->slot_index = found + 1;
+                return reinterpret_cast<T *>(region->slot_base(alignof(T)) + static_cast<uint64>(found) * sizeof(T));
+            }
+            this->region_index++;
+            this->slot_index = 0;
+        }
+        return nullptr;
     }
 
 }
@@ -0,0 +1,260 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "src/memory/heap-cache.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/os.hpp"
+#include "src/threading/os.hpp"
+
+#if defined(VEIL_ENABLE_PROFILING)
+#include "src/memory/profiling.hpp"
+#endif
+
+using namespace veil::memory;
+
+/// A fixed capacity stack of free blocks of a single size class.
+/// \attention Magazines are allocated from the host heap directly, as allocating a \c HeapObject here will recurse.
+struct Magazine {
+    Magazine *next;
+    uint32 count;
+    void *blocks[HeapCache::MAGAZINE_CAPACITY];
+
+    [[nodiscard]] bool is_empty() const { return count == 0; }
+
+    [[nodiscard]] bool is_full() const { return count == HeapCache::MAGAZINE_CAPACITY; }
+
+    static Magazine *create() {
+        auto *magazine = static_cast<Magazine *>(veil::os::malloc(sizeof(Magazine)));
+        magazine->next = nullptr;
+        magazine->count = 0;
+        return magazine;
+    }
+};
+
+/// The process wide depot of magazines, each size class has a shelf of its own.
+/// \attention The spin locks cannot be replaced by \c os::Mutex, as the construction of a mutex allocates a
+/// \c HeapObject which will recurse into the depot.
+class MagazineDepot {
+public:
+    /// Take a loaded magazine, a batch of blocks is carved from the host heap if there is no loaded magazine left.
+    Magazine *take_loaded(uint32 class_index) {
+        Shelf &shelf = this->shelves[class_index];
+        Magazine *magazine = shelf.pop(shelf.loaded);
+        if (magazine != nullptr) return magazine;
+
+        magazine = take_empty(class_index);
+        uint64 block_size = (class_index + 1) * HeapCache::SIZE_CLASS_GRANULE;
+        // The batch is never returned to the host heap, the blocks carved from it circulates within the magazines.
+        auto *batch = static_cast<uint8 *>(veil::os::malloc(block_size * HeapCache::MAGAZINE_CAPACITY));
+        for (uint32 i = 0; i < HeapCache::MAGAZINE_CAPACITY; i++) magazine->blocks[i] = batch + i * block_size;
+        magazine->count = HeapCache::MAGAZINE_CAPACITY;
+        return magazine;
+    }
+
+    /// Take an empty magazine, a new magazine is created if there is no empty magazine left.
+    Magazine *take_empty(uint32 class_index) {
+        Shelf &shelf = this->shelves[class_index];
+        Magazine *magazine = shelf.pop(shelf.empty);
+        return magazine != nullptr ? magazine : Magazine::create();
+    }
+
+    /// Return a magazine to the depot, which is stacked according to whether it holds any block.
+    void put(uint32 class_index, Magazine *magazine) {
+        if (magazine == nullptr) return;
+        Shelf &shelf = this->shelves[class_index];
+        shelf.push(magazine->is_empty() ? shelf.empty : shelf.loaded, magazine);
+    }
+
+private:
+    /// The stacks of loaded and empty magazines of a size class protected by a spin lock, each shelf occupies its own
+    /// cache line as the shelves of different size classes are contended independently.
+    struct alignas(veil::memory::CACHE_LINE_SIZE) Shelf {
+        veil::os::atomic_u32_t lock = veil::os::atomic_u32_t(0);
+        Magazine *loaded = nullptr;
+        Magazine *empty = nullptr;
+
+        Magazine *pop(Magazine *&stack) {
+            while (this->lock.exchange(1)) veil::os::Thread::static_sleep(0);
+            Magazine *magazine = stack;
+            if (magazine != nullptr) stack = magazine->next;
+            this->lock.store(0);
+            return magazine;
+        }
+
+        void push(Magazine *&stack, Magazine *magazine) {
+            while (this->lock.exchange(1)) veil::os::Thread::static_sleep(0);
+            magazine->next = stack;
+            stack = magazine;
+            this->lock.store(0);
+        }
+    };
+
+    Shelf shelves[HeapCache::SIZE_CLASS_COUNT];
+};
+
+/// The depot is constructed on its first use, as a HeapObject can be allocated by the static initializer of another
+/// translation unit before the static initializer of this translation unit.
+static MagazineDepot &depot() {
+    static MagazineDepot instance;
+    return instance;
+}
+
+/// The lifecycle state of the magazines of a thread.
+enum class CacheState : uint8 {
+    /// The magazines are not used yet.
+    UNUSED = 0,
+    /// The magazines are in use, and will be flushed on the exit of the thread.
+    ACTIVE,
+    /// The thread is exiting and the magazines are flushed, all subsequent operations goes through the depot.
+    RETIRED
+};
+
+/// The magazines of a thread, which is a plain structure so that it is constant initialized and remains accessible
+/// during the destruction of the other thread local objects.
+struct ThreadMagazines {
+    CacheState state;
+    /// The magazine which the blocks are popped from and pushed into.
+    Magazine *active[HeapCache::SIZE_CLASS_COUNT];
+    /// The magazine exchanged with the active magazine when it is exhausted or full, keeping the previous magazine
+    /// avoids the alternating allocation and deallocation on the boundary of a magazine to thrash the depot.
+    Magazine *previous[HeapCache::SIZE_CLASS_COUNT];
+    /// The allocated byte size of this thread yet to be merged into the process wide counter.
+    int64 unmerged_allocated_size;
+};
+
+static thread_local ThreadMagazines thread_magazines;
+
+/// The destructor of this object flushes the magazines of the exiting thread.
+struct ThreadMagazinesRetirement {
+    ~ThreadMagazinesRetirement() {
+        HeapCache::flush();
+        thread_magazines.state = CacheState::RETIRED;
+    }
+};
+
+#if defined(VEIL_ENABLE_PROFILING)
+
+static veil::os::atomic_u64_t merged_heap_allocated_size(0);
+
+uint64 veil::memory::os_heap_allocated_size() { return merged_heap_allocated_size.load(); }
+
+#endif
+
+static void account_allocated_size(int64 size) {
+#   if defined(VEIL_ENABLE_PROFILING)
+    if (thread_magazines.state != CacheState::ACTIVE) {
+        uint64 _ = merged_heap_allocated_size.fetch_add(static_cast<uint64>(size));
+        return;
+    }
+    int64 unmerged = thread_magazines.unmerged_allocated_size + size;
+    if (unmerged >= HeapCache::PROFILING_MERGE_THRESHOLD || -unmerged >= HeapCache::PROFILING_MERGE_THRESHOLD) {
+        // The signed value is added in two's complement, which wraps to a subtraction for a negative value.
+        uint64 _ = merged_heap_allocated_size.fetch_add(static_cast<uint64>(unmerged));
+        unmerged = 0;
+    }
+    thread_magazines.unmerged_allocated_size = unmerged;
+#   endif
+}
+
+static void activate_thread_magazines() {
+    // The retirement object is constructed on the first use of the magazines within the thread, which registers its
+    // destructor to be invoked on the exit of the thread.
+    static thread_local ThreadMagazinesRetirement retirement;
+    (void) retirement;
+    thread_magazines.state = CacheState::ACTIVE;
+}
+
+void *HeapCache::allocate(uint64 size) {
+    if (size > MAX_CACHED_SIZE) {
+        account_allocated_size(static_cast<int64>(size));
+        return veil::os::malloc(size);
+    }
+
+    uint32 class_index = size == 0 ? 0 : static_cast<uint32>((size - 1) / SIZE_CLASS_GRANULE);
+    account_allocated_size((class_index + 1) * SIZE_CLASS_GRANULE);
+
+    if (thread_magazines.state == CacheState::UNUSED) activate_thread_magazines();
+    if (thread_magazines.state == CacheState::RETIRED) {
+        // The thread local magazines are no longer available, borrow a loaded magazine from the depot.
+        Magazine *borrowed = depot().take_loaded(class_index);
+        void *block = borrowed->blocks[--borrowed->count];
+        depot().put(class_index, borrowed);
+        return block;
+    }
+
+    Magazine *&active = thread_magazines.active[class_index];
+    Magazine *&previous = thread_magazines.previous[class_index];
+    if (active == nullptr || active->is_empty()) {
+        if (previous != nullptr && !previous->is_empty()) {
+            Magazine *exchanged = active;
+            active = previous;
+            previous = exchanged;
+        } else {
+            // Both magazines are exhausted, return the previous magazine to the depot and load a new magazine.
+            depot().put(class_index, previous);
+            previous = active;
+            active = depot().take_loaded(class_index);
+        }
+    }
+    return active->blocks[--active->count];
+}
+
+void HeapCache::free(void *address, uint64 size) {
+    if (size > MAX_CACHED_SIZE) {
+        account_allocated_size(-static_cast<int64>(size));
+        veil::os::free(address);
+        return;
+    }
+
+    uint32 class_index = size == 0 ? 0 : static_cast<uint32>((size - 1) / SIZE_CLASS_GRANULE);
+    account_allocated_size(-static_cast<int64>((class_index + 1) * SIZE_CLASS_GRANULE));
+
+    if (thread_magazines.state == CacheState::UNUSED) activate_thread_magazines();
+    if (thread_magazines.state == CacheState::RETIRED) {
+        Magazine *borrowed = depot().take_empty(class_index);
+        borrowed->blocks[borrowed->count++] = address;
+        depot().put(class_index, borrowed);
+        return;
+    }
+
+    Magazine *&active = thread_magazines.active[class_index];
+    Magazine *&previous = thread_magazines.previous[class_index];
+    if (active == nullptr || active->is_full()) {
+        if (previous != nullptr && !previous->is_full()) {
+            Magazine *exchanged = active;
+            active = previous;
+            previous = exchanged;
+        } else {
+            // Both magazines are full, return the previous magazine to the depot and load an empty magazine.
+            depot().put(class_index, previous);
+            previous = active;
+            active = depot().take_empty(class_index);
+        }
+    }
+    active->blocks[active->count++] = address;
+}
+
+void HeapCache::flush() {
+    for (uint32 class_index = 0; class_index < SIZE_CLASS_COUNT; class_index++) {
+        depot().put(class_index, thread_magazines.active[class_index]);
+        depot().put(class_index, thread_magazines.previous[class_index]);
+        thread_magazines.active[class_index] = nullptr;
+        thread_magazines.previous[class_index] = nullptr;
+    }
+#   if defined(VEIL_ENABLE_PROFILING)
+    uint64 _ = merged_heap_allocated_size.fetch_add(static_cast<uint64>(thread_magazines.unmerged_allocated_size));
+    thread_magazines.unmerged_allocated_size = 0;
+#   endif
+}
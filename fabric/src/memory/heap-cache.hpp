@@ -0,0 +1,64 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_HEAP_CACHE_HPP
+#define VEIL_FABRIC_SRC_MEMORY_HEAP_CACHE_HPP
+
+#include "src/typedefs.hpp"
+
+namespace veil::memory {
+
+    /// The thread caching front-end of the process heap used by \c HeapObject, the design follows the magazine layer of
+    /// the slab allocator: each thread holds two magazines (fixed capacity stacks of free blocks) per size class, thus
+    /// the allocation and deallocation of a common sized \c HeapObject is served by the calling thread without any
+    /// synchronization. The magazines are exchanged with a shared depot in batches of \c HeapCache::MAGAZINE_CAPACITY
+    /// blocks only when both magazines of the thread are exhausted (or full).
+    /// <br><br>
+    /// When profiling is enabled, each thread accumulates its allocated size locally, and merges it into the process
+    /// wide counter lazily after a threshold is exceeded or when the thread exits.
+    /// \attention The blocks of a size class are carved from batches of the host heap and are retained by the cache,
+    /// thus a block must be freed with the same size as it is allocated.
+    class HeapCache {
+    public:
+        /// The byte granularity of the size classes.
+        static const uint32 SIZE_CLASS_GRANULE = 16;
+        /// The number of cached size classes.
+        static const uint32 SIZE_CLASS_COUNT = 16;
+        /// The largest allocation served by the cache, larger allocations are forwarded to the host heap directly.
+        static const uint32 MAX_CACHED_SIZE = SIZE_CLASS_GRANULE * SIZE_CLASS_COUNT;
+        /// The number of blocks held by a magazine.
+        static const uint32 MAGAZINE_CAPACITY = 32;
+        /// The absolute value of the thread local allocated size to be accumulated before merging into the process
+        /// wide counter.
+        static const uint32 PROFILING_MERGE_THRESHOLD = 64 * 1024;
+
+        /// Allocate a block from the magazines of the calling thread.
+        /// \param size The byte size of the block.
+        /// \return     The address of the block.
+        static void *allocate(uint64 size);
+
+        /// Free a block into the magazines of the calling thread.
+        /// \param address The address of the block.
+        /// \param size    The byte size provided to \c HeapCache::allocate when allocating this block.
+        static void free(void *address, uint64 size);
+
+        /// Return all magazines of the calling thread to the depot and merge its profiling counter, this is invoked
+        /// automatically on the exit of the thread.
+        static void flush();
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_HEAP_CACHE_HPP
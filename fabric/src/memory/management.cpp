@@ -23,29 +23,138 @@ using namespace veil::memory;
 
 Algorithm::Algorithm(std::string &name) : vm::HasName(name) {}
 
-Allocator::Allocator(Management &management) : vm::HasRoot<Management>(management) {}
+Allocator::Allocator(Management &management) : vm::HasRoot<Management>(management) {
+    os::CriticalSection _(management.statistics_m);
+    this->statistics.next = management.allocator_statistics;
+    management.allocator_statistics = &this->statistics;
+}
+
+const AllocatorStatistics &Allocator::get_statistics() const { return this->statistics; }
+
+void *Algorithm::get_structure(Management &management) { return management.structure; }
+
+void Algorithm::set_structure(Management &management, void *structure) { management.structure = structure; }
+
+void Algorithm::heap_map(Management &management, HeapMapRequest &request) { management.heap_map(request); }
+
+void Algorithm::heap_unmap(Management &management, HeapUnmapRequest &request) { management.heap_unmap(request); }
+
+CollectionStatistics &Algorithm::collection_statistics(Management &management) {
+    return management.collection_statistics;
+}
+
+void *Allocator::get_structure() { return this->root()->structure; }
+
+void Allocator::heap_map(HeapMapRequest &request) { this->root()->heap_map(request); }
+
+void Allocator::heap_unmap(HeapUnmapRequest &request) { this->root()->heap_unmap(request); }
+
+void Allocator::set_address(PointerAcquireRequest &request, uint8 *address) { request.address = address; }
+
+void Allocator::set_address(PointerBatchAcquireRequest &request, uint32 index, uint8 *address) {
+    request.addresses[index] = address;
+}
+
+void Allocator::acquire_batch(PointerBatchAcquireRequest &request) {
+    for (uint32 index = 0; index < request.count; index++) {
+        PointerAcquireRequest acquire_request(request.pointers[index], request.exclusive);
+        this->acquire(acquire_request);
+        if (!acquire_request.is_ok()) {
+            PointerBatchReleaseRequest release_request(request.pointers, index);
+            this->release_batch(release_request);
+            vm::RequestExecutor::set_error(request, acquire_request.get_error());
+            return;
+        }
+        set_address(request, index, acquire_request.get_address());
+    }
+}
+
+void Allocator::release_batch(PointerBatchReleaseRequest &request) {
+    for (uint32 index = request.count; index > 0; index--) {
+        PointerActionRequest release_request(request.pointers[index - 1]);
+        this->release(release_request);
+    }
+}
 
 Allocator *Management::create_allocator(vm::Request &request) {
     return this->algorithm->create_allocator(*this, request);
 }
 
+void Management::terminate(Management *management, vm::Request &request) {
+    management->algorithm->terminate(*management, request);
+    delete management;
+}
+
 Management *Management::new_instance(Runtime &runtime, MemoryInitRequest &request) {
     if (!request.algorithm) {
         vm::RequestExecutor::set_error(request, memory::ERR_NO_ALGO);
         return nullptr;
     }
 
-    uint32 host_page_size = os::get_page_size();
-    // Ensure that the max heap size is a multiple of the host page size.
-    uint64 max_heap_size = request.max_heap_size % host_page_size ?
-                           request.max_heap_size + host_page_size : request.max_heap_size;
+    const HeapMapOptions &options = request.heap_map_options;
+    if (options.numa_policy != HeapMapOptions::NumaPolicy::DEFAULT && !options.numa_node_mask) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_MAP_OPTION);
+        return nullptr;
+    }
+
+    // The contiguous heap range is committed in units of the huge page size if huge pages are requested, so that
+    // every committed section is eligible to be backed by huge pages.
+    uint64 heap_granularity = os::get_page_size();
+    if (options.page_mode != HeapMapOptions::PageMode::DEFAULT) {
+        uint64 huge_page_size = os::get_huge_page_size();
+        if (huge_page_size > heap_granularity) heap_granularity = huge_page_size;
+    }
+    if (request.soft_heap_percent > 100 || request.container_heap_percent > 100) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_HEAP_SIZE);
+        return nullptr;
+    }
+    uint64 max_heap_size = request.max_heap_size;
+    if (request.container_heap_percent) {
+        // The heap committed beyond the container limit gets the process killed by the host rather than failing the
+        // mapping gracefully, thus the heap is sized to a share of the limit leaving room for the native memory.
+        uint32 error;
+        uint64 container_heap_size = os::get_memory_limit(error) / 100 * request.container_heap_percent;
+        if (container_heap_size && (!max_heap_size || container_heap_size < max_heap_size))
+            max_heap_size = container_heap_size;
+    }
+    // Ensure that the max heap size is a multiple of the heap granularity.
+    max_heap_size = (max_heap_size + heap_granularity - 1) / heap_granularity * heap_granularity;
     // Ensure the adjusted max heap size is supported by the algorithm.
-    if (max_heap_size > request.algorithm->max_supported_heap_size()) {
+    if (!max_heap_size || max_heap_size > request.algorithm->max_supported_heap_size()) {
         vm::RequestExecutor::set_error(request, memory::ERR_INV_HEAP_SIZE);
         return nullptr;
     }
 
-    auto *management = new Management(runtime, request.algorithm, max_heap_size);
+    // Reserve the heap range, no physical page is associated with the reservation until a section is committed.
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // Windows can only release a reservation as a whole, and it does not commit large pages within a reservation, thus
+    // the base of the range is not aligned to the granularity.
+    uint64 reserved_size = max_heap_size;
+#   else
+    // Extra space is reserved to align the base of the range to the granularity.
+    uint64 reserved_size = max_heap_size + heap_granularity;
+#   endif
+    uint32 error;
+    auto *reserved = static_cast<uint8 *>(os::mmap(nullptr, reserved_size, false, false, false, false, error));
+    if (!reserved) {
+        vm::RequestExecutor::set_error(request, memory::ERR_HOST_NOMEM);
+        return nullptr;
+    }
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    uint8 *heap_base = reserved;
+#   else
+    auto *heap_base = reinterpret_cast<uint8 *>(
+            (reinterpret_cast<uint64>(reserved) + heap_granularity - 1) / heap_granularity * heap_granularity);
+    // Trim the excess reservation around the aligned range.
+    if (heap_base > reserved) os::munmap(reserved, heap_base - reserved, error);
+    uint8 *reserved_end = reserved + reserved_size;
+    if (reserved_end > heap_base + max_heap_size)
+        os::munmap(heap_base + max_heap_size, reserved_end - (heap_base + max_heap_size), error);
+#   endif
+
+    uint64 soft_heap_size = max_heap_size / 100 * request.soft_heap_percent;
+    auto *management = new Management(runtime, request.algorithm, max_heap_size, soft_heap_size, options, heap_base,
+                                      heap_granularity);
 
     AlgorithmInitRequest algo_request(management, request.algorithm_params);
     request.algorithm->initialize(algo_request);
@@ -59,34 +168,296 @@ Management *Management::new_instance(Runtime &runtime, MemoryInitRequest &reques
     return management;
 }
 
-Management::Management(Runtime &runtime, Algorithm *algorithm, uint64 max_heap_size) :
+struct Management::HeapSection : public memory::HeapObject {
+    uint8 *address;
+    uint64 size;
+    HeapSection *next;
+
+    HeapSection(uint8 *address, uint64 size, HeapSection *next) : address(address), size(size), next(next) {}
+};
+
+Management::Management(Runtime &runtime, Algorithm *algorithm, uint64 max_heap_size, uint64 soft_heap_size,
+                       HeapMapOptions heap_map_options, uint8 *heap_base, uint64 heap_granularity) :
         vm::HasRoot<Runtime>(runtime),
         MAX_HEAP_SIZE(max_heap_size),
-        algorithm(algorithm),
+        SOFT_HEAP_SIZE(soft_heap_size),
         mapped_heap_size(0),
+        heap_base(heap_base),
+        heap_granularity(heap_granularity),
+        heap_top(heap_base),
+        free_sections(nullptr),
+        heap_map_options(heap_map_options),
+        large_objects(nullptr),
+        large_size(0),
+        allocator_statistics(nullptr),
+        pressure_listeners(nullptr),
+        soft_pressured(false),
+        algorithm(algorithm),
         structure(nullptr) {}
 
+Management::~Management() {
+    // The segments of the remaining large objects are unmapped along with the heap range.
+    while (this->large_objects) {
+        LargeObject *object = this->large_objects;
+        this->large_objects = object->next;
+        delete object;
+    }
+    uint32 error;
+    os::munmap(this->heap_base, this->MAX_HEAP_SIZE, error);
+    while (this->free_sections) {
+        HeapSection *section = this->free_sections;
+        this->free_sections = section->next;
+        delete section;
+    }
+}
+
 void Management::heap_map(HeapMapRequest &request) {
-    // Increment atomically by the request size.
-    uint64 current_mapped_size = this->mapped_heap_size.fetch_add(request.size);
-    // The total mapped size from the host should not be greater than the limit.
-    if (current_mapped_size > this->MAX_HEAP_SIZE) {
-        vm::RequestExecutor::set_error(request, memory::ERR_HEAP_OVERFLOW);
+    uint64 granularity = this->heap_granularity;
+    uint64 size = request.size ? (request.size + granularity - 1) / granularity * granularity : granularity;
+
+    uint8 *address = this->take_section(size);
+    if (!address) {
+        // The listeners might release enough sections for the mapping to fit before failing on the hard limit.
+        this->relieve_pressure(MemoryPressure::CRITICAL);
+        address = this->take_section(size);
+        if (!address) {
+            vm::RequestExecutor::set_error(request, memory::ERR_HEAP_OVERFLOW);
+            return;
+        }
+    }
+
+    const HeapMapOptions &options = this->heap_map_options;
+    uint32 error = veil::ERR_NONE;
+    bool huge_committed = false;
+    if (options.page_mode == HeapMapOptions::PageMode::EXPLICIT_HUGE) {
+        os::commit(address, size, true, error);
+        huge_committed = error == veil::ERR_NONE;
+    }
+    if (!huge_committed) os::commit(address, size, false, error);
+    if (error != veil::ERR_NONE) {
+        {
+            os::CriticalSection _(this->heap_map_m);
+            this->free_section(address, size);
+        }
+        switch (error) {
+        case os::ERR_NOMEM:
+            vm::RequestExecutor::set_error(request, memory::ERR_HOST_NOMEM);
+            break;
+        default:
+            vm::RequestExecutor::set_error(request, memory::ERR_INV_MAP_OPTION);
+            break;
+        }
         return;
     }
+
+    // The following options are advisory, failures are tolerated as the section is still usable with regular pages
+    // placed by the host.
+    if (!huge_committed && options.page_mode != HeapMapOptions::PageMode::DEFAULT)
+        os::advise_huge_pages(address, size, error);
+    // The pages must not be faulted in before the NUMA policy is applied, otherwise they are placed on the local node.
+    if (options.numa_policy != HeapMapOptions::NumaPolicy::DEFAULT)
+        os::numa_bind(address, size, options.numa_node_mask,
+                      options.numa_policy == HeapMapOptions::NumaPolicy::INTERLEAVE, error);
+    if (options.pre_fault) os::pre_fault(address, size, error);
+
+    uint64 mapped_heap_size = this->mapped_heap_size.fetch_add(size);
+    request.address = address;
+    // Only the mapping crossing the soft limit notifies the listeners, until the mapped size falls back to the limit.
+    if (mapped_heap_size > this->SOFT_HEAP_SIZE && !this->soft_pressured.load() &&
+        !this->soft_pressured.exchange(true))
+        this->relieve_pressure(MemoryPressure::SOFT);
+}
+
+uint8 *Management::take_section(uint64 size) {
+    os::CriticalSection _(this->heap_map_m);
+    // Reuse the lowest fitting decommitted section, this keeps the committed sections packed towards the base such
+    // that the heap top can be lowered when the upper sections are unmapped.
+    for (HeapSection **link = &this->free_sections; *link; link = &(*link)->next) {
+        HeapSection *section = *link;
+        if (section->size < size) continue;
+        uint8 *address = section->address;
+        if (section->size == size) {
+            *link = section->next;
+            delete section;
+        } else {
+            section->address += size;
+            section->size -= size;
+        }
+        return address;
+    }
+    // The total committed size from the host should not be greater than the limit.
+    if (size > this->MAX_HEAP_SIZE - (this->heap_top - this->heap_base)) return nullptr;
+    uint8 *address = this->heap_top;
+    this->heap_top += size;
+    return address;
+}
+
+void Management::heap_unmap(HeapUnmapRequest &request) {
+    uint64 granularity = this->heap_granularity;
+    uint64 size = request.size ? (request.size + granularity - 1) / granularity * granularity : granularity;
+    if (!this->heap_contains(request.address) || this->heap_offset(request.address) % granularity ||
+        size > this->MAX_HEAP_SIZE - this->heap_offset(request.address)) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_MAP_OPTION);
+        return;
+    }
+
     uint32 error;
-    request.address = static_cast<uint8 *>(os::mmap(nullptr, request.size, true, true, error));
-    switch (error) {
-    case os::ERR_NOMEM: vm::RequestExecutor::set_error(request, memory::ERR_HOST_NOMEM);
-    case veil::ERR_NONE:
-    default: break;
+    os::decommit(request.address, size, error);
+    if (error != veil::ERR_NONE) {
+        // The section remains committed, thus its range must not be reused.
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_MAP_OPTION);
+        return;
+    }
+    if (this->mapped_heap_size.fetch_sub(size) <= this->SOFT_HEAP_SIZE && this->soft_pressured.load())
+        this->soft_pressured.store(false);
+
+    os::CriticalSection _(this->heap_map_m);
+    this->free_section(request.address, size);
+}
+
+LargeObject *Management::allocate_large(LargeAllocateRequest &request) {
+    uint64 granularity = this->heap_granularity;
+    uint64 segment_size = request.segment_size && request.segment_size < request.size ? request.segment_size :
+                          request.size;
+    // The segments are padded to the heap granularity by the mapping anyway, thus the padding is utilized.
+    segment_size = (segment_size + granularity - 1) / granularity * granularity;
+    uint64 segment_count = segment_size ? (request.size + segment_size - 1) / segment_size : 0;
+    if (!segment_count || segment_count > UINT32_MAX) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_POINTER_SIZE);
+        return nullptr;
+    }
+
+    auto *object = new LargeObject(request.size, segment_size, static_cast<uint32>(segment_count));
+    for (uint32 index = 0; index < object->segment_count; index++) {
+        HeapMapRequest map_request(object->get_segment_size(index));
+        this->heap_map(map_request);
+        if (!map_request.is_ok()) {
+            for (uint32 mapped = 0; mapped < index; mapped++) {
+                HeapUnmapRequest unmap_request(object->segments[mapped], object->get_segment_size(mapped));
+                this->heap_unmap(unmap_request);
+            }
+            delete object;
+            vm::RequestExecutor::set_error(request, map_request.get_error());
+            return nullptr;
+        }
+        object->segments[index] = map_request.get_address();
+    }
+
+    {
+        os::CriticalSection _(this->large_m);
+        object->next = this->large_objects;
+        if (this->large_objects) this->large_objects->previous = object;
+        this->large_objects = object;
+    }
+    (void) this->large_size.fetch_add(object->size);
+    return object;
+}
+
+void Management::free_large(LargeObject *object, vm::Request &request) {
+    {
+        os::CriticalSection _(this->large_m);
+        if (object->previous) object->previous->next = object->next;
+        else this->large_objects = object->next;
+        if (object->next) object->next->previous = object->previous;
+    }
+    (void) this->large_size.fetch_sub(object->size);
+
+    for (uint32 index = 0; index < object->segment_count; index++) {
+        HeapUnmapRequest unmap_request(object->segments[index], object->get_segment_size(index));
+        this->heap_unmap(unmap_request);
+        // The remaining segments are still unmapped, the failed one stays committed until the termination.
+        if (!unmap_request.is_ok()) vm::RequestExecutor::set_error(request, unmap_request.get_error());
+    }
+    delete object;
+}
+
+uint64 Management::get_large_size() const { return this->large_size.load(); }
+
+void Management::add_pressure_listener(PressureListener &listener) {
+    os::CriticalSection _(this->pressure_m);
+    listener.next = this->pressure_listeners;
+    this->pressure_listeners = &listener;
+}
+
+void Management::remove_pressure_listener(PressureListener &listener) {
+    os::CriticalSection _(this->pressure_m);
+    for (PressureListener **link = &this->pressure_listeners; *link; link = &(*link)->next) {
+        if (*link != &listener) continue;
+        *link = listener.next;
+        listener.next = nullptr;
+        return;
+    }
+}
+
+void Management::relieve_pressure(MemoryPressure pressure) {
+    os::CriticalSection _(this->pressure_m);
+    for (PressureListener *listener = this->pressure_listeners; listener; listener = listener->next)
+        listener->relieve(*this, pressure);
+}
+
+void Management::get_statistics(HeapStatistics &statistics) {
+    statistics = HeapStatistics();
+    statistics.mapped_size = this->mapped_heap_size.load();
+    statistics.large_size = this->large_size.load();
+    {
+        // The registry is only locked against the creation of the allocators.
+        os::CriticalSection _(this->statistics_m);
+        for (AllocatorStatistics *current = this->allocator_statistics; current; current = current->next) {
+            statistics.allocated_size += current->get_allocated_size();
+            statistics.allocation_count += current->get_allocation_count();
+            statistics.freed_size += current->get_freed_size();
+            for (uint32 index = 0; index < AllocatorStatistics::SIZE_CLASS_COUNT; index++)
+                statistics.class_counts[index] += current->get_class_count(index);
+        }
+    }
+    CollectionStatistics &collections = this->collection_statistics;
+    statistics.collected_size = collections.get_collected_size();
+    statistics.copied_size = collections.get_copied_size();
+    statistics.collection_count = collections.get_collection_count();
+    statistics.collection_time = collections.get_collection_time();
+    statistics.max_collection_time = collections.get_max_collection_time();
+}
+
+void Management::free_section(uint8 *address, uint64 size) {
+    HeapSection *previous = nullptr, *next = this->free_sections;
+    while (next && next->address < address) {
+        previous = next;
+        next = next->next;
+    }
+
+    HeapSection *section;
+    if (previous && previous->address + previous->size == address) {
+        previous->size += size;
+        section = previous;
+    } else {
+        section = new HeapSection(address, size, next);
+        if (previous) previous->next = section;
+        else this->free_sections = section;
+    }
+    if (next && section->address + section->size == next->address) {
+        section->size += next->size;
+        section->next = next->next;
+        delete next;
+    }
+
+    // The topmost section is merged back to the never committed range.
+    if (section->next == nullptr && section->address + section->size == this->heap_top) {
+        HeapSection **link = &this->free_sections;
+        while (*link != section) link = &(*link)->next;
+        *link = nullptr;
+        this->heap_top = section->address;
+        delete section;
     }
 }
 
 Pointer::Pointer(uint32 size) : size(size) {}
 
-MemoryInitRequest::MemoryInitRequest(uint64 max_heap_size, Algorithm *algorithm, void *algorithm_params) :
-        max_heap_size(max_heap_size), algorithm(algorithm), algorithm_params(algorithm_params) {}
+PressureListener::PressureListener() : next(nullptr) {}
+
+MemoryInitRequest::MemoryInitRequest(uint64 max_heap_size, Algorithm *algorithm, void *algorithm_params,
+                                     HeapMapOptions heap_map_options) :
+        max_heap_size(max_heap_size), algorithm(algorithm), algorithm_params(algorithm_params),
+        heap_map_options(heap_map_options) {}
 
 AllocateRequest::AllocateRequest(uint64 size) : size(size) {}
 
@@ -99,8 +470,58 @@ uint8 *PointerAcquireRequest::get_address() {
     return this->address;
 }
 
+/// Sift the pointer at the \a root down the max heap of \a pointers ending at \a end, ordered by their addresses.
+static void sift_down(Pointer **pointers, uint32 root, uint32 end) {
+    while (root * 2 + 1 < end) {
+        uint32 child = root * 2 + 1;
+        if (child + 1 < end && pointers[child] < pointers[child + 1]) child++;
+        if (!(pointers[root] < pointers[child])) return;
+        Pointer *swapped = pointers[root];
+        pointers[root] = pointers[child];
+        pointers[child] = swapped;
+        root = child;
+    }
+}
+
+PointerBatchAcquireRequest::PointerBatchAcquireRequest(Pointer **pointers, uint32 count, uint8 **addresses,
+                                                       bool exclusive) :
+        pointers(pointers), count(count), exclusive(exclusive), addresses(addresses) {
+    // Heap sort the pointers by their addresses, which is the global order of the acquisitions.
+    for (uint32 index = count / 2; index > 0; index--) sift_down(pointers, index - 1, count);
+    for (uint32 end = count; end > 1; end--) {
+        Pointer *largest = pointers[0];
+        pointers[0] = pointers[end - 1];
+        pointers[end - 1] = largest;
+        sift_down(pointers, 0, end - 1);
+    }
+}
+
+uint8 *PointerBatchAcquireRequest::get_address(uint32 index) {
+    return this->addresses[index];
+}
+
+PointerBatchReleaseRequest::PointerBatchReleaseRequest(Pointer *const *pointers, uint32 count) :
+        pointers(pointers), count(count) {}
+
+LargeAllocateRequest::LargeAllocateRequest(uint64 size, uint64 segment_size) :
+        AllocateRequest(size), segment_size(segment_size) {}
+
+LargeObject::LargeObject(uint64 size, uint64 segment_size, uint32 segment_count) :
+        size(size), segment_size(segment_size), segment_count(segment_count), previous(nullptr), next(nullptr) {
+    this->segments = static_cast<uint8 **>(os::malloc(segment_count * sizeof(uint8 *)));
+}
+
+LargeObject::~LargeObject() { os::free(this->segments); }
+
+uint64 LargeObject::get_segment_size(uint32 index) const {
+    return index + 1 < this->segment_count ? this->segment_size :
+           this->size - static_cast<uint64>(this->segment_count - 1) * this->segment_size;
+}
+
 HeapMapRequest::HeapMapRequest(uint64 size) : AllocateRequest(size) {}
 
+HeapUnmapRequest::HeapUnmapRequest(uint8 *address, uint64 size) : address(address), size(size) {}
+
 uint8 *HeapMapRequest::get_address() {
     return this->address;
 }
@@ -21,6 +21,7 @@
 #include "src/typedefs.hpp"
 #include "src/vm/structures.hpp"
 #include "src/core/runtime.forward.hpp"
+#include "src/memory/statistics.hpp"
 #include "src/threading/os.hpp"
 
 /// The namespace of the memory management system of the Veil virtual machine, this system is designed to provide only
@@ -39,6 +40,10 @@ namespace veil::memory {
 
     class Algorithm;
 
+    class HeapMapRequest;
+
+    struct HeapUnmapRequest;
+
     /// The request as a parameter for allocating a \c Pointer from an \c Allocator.
     struct AllocateRequest : public vm::Request {
         /// The byte size of the pointer to be allocated.
@@ -67,6 +72,9 @@ namespace veil::memory {
     private:
         /// The current address of the pointer, a returned parameter of the request.
         uint8 *address;
+
+        // Allow the algorithm specific allocators to return the address.
+        friend class Allocator;
     };
 
     /// The request as a parameter for performing actions to a \c Pointer from an \c Allocator.
@@ -78,20 +86,191 @@ namespace veil::memory {
         explicit PointerActionRequest(Pointer *pointer);
     };
 
+    /// The request as a parameter for acquiring a group of \c Pointer from an \c Allocator in a single operation.
+    /// \attention The pointers are acquired in the ascending order of their addresses, thus the batch acquisitions of
+    /// overlapping groups never deadlock against each other; the array of pointers is sorted into this order on the
+    /// construction of the request.
+    class PointerBatchAcquireRequest : public vm::Request {
+    public:
+        /// The pointers to be acquired, in the order of acquisition.
+        Pointer **const pointers;
+        /// The number of the pointers to be acquired.
+        const uint32 count;
+        /// Whether the acquisitions are exclusive or not, with the same semantics as
+        /// \c PointerAcquireRequest::exclusive.
+        const bool exclusive;
+
+        /// \param pointers  The array of the pointers to be acquired, which is sorted in place.
+        /// \param count     The number of the pointers within \a pointers.
+        /// \param addresses The array of at least \a count elements to store the current addresses of the pointers.
+        /// \param exclusive Whether the acquisitions are exclusive or not, defaults to \c false.
+        PointerBatchAcquireRequest(Pointer **pointers, uint32 count, uint8 **addresses, bool exclusive = false);
+
+        /// \return The current address of the pointer at the \a index of \c PointerBatchAcquireRequest::pointers.
+        uint8 *get_address(uint32 index);
+
+    private:
+        /// The current addresses of the pointers, a returned parameter of the request.
+        uint8 **addresses;
+
+        // Allow the algorithm specific allocators to return the addresses.
+        friend class Allocator;
+    };
+
+    /// The request as a parameter for releasing a group of \c Pointer acquired by a \c PointerBatchAcquireRequest.
+    struct PointerBatchReleaseRequest : public vm::Request {
+        /// The pointers to be released, which are released in the reverse order of the array.
+        Pointer *const *const pointers;
+        /// The number of the pointers to be released.
+        const uint32 count;
+
+        /// \param pointers The pointers to be released, typically \c PointerBatchAcquireRequest::pointers.
+        /// \param count    The number of the pointers within \a pointers.
+        PointerBatchReleaseRequest(Pointer *const *pointers, uint32 count);
+    };
+
+    /// The request as a parameter for allocating a \c LargeObject from the large-object space of a \c Management.
+    struct LargeAllocateRequest : public AllocateRequest {
+        /// The byte size of each segment of the object, or 0 if the object is mapped as a single contiguous segment.
+        const uint64 segment_size;
+
+        /// \param size         The byte size of the object.
+        /// \param segment_size The byte size of each segment of the object, defaults to 0 for a contiguous object.
+        explicit LargeAllocateRequest(uint64 size, uint64 segment_size = 0);
+    };
+
+    /// An object allocated from the large-object space of a \c Management, which is not bound by the 4GiB limit of
+    /// \c Pointer. The object consists of one or more segments, each mapped as a dedicated heap memory section; all
+    /// segments have the size \c LargeObject::segment_size except the last one which holds the remainder. A segmented
+    /// object does not require a contiguous range of the heap, which suits the large arrays accessed by index.
+    class LargeObject : public HeapObject {
+    public:
+        /// The byte size of the object.
+        const uint64 size;
+        /// The byte size of each segment except the last one, which is a multiple of the heap granularity.
+        const uint64 segment_size;
+        /// The number of the segments.
+        const uint32 segment_count;
+
+        /// \return The address of the byte at the \a offset of the object.
+        inline uint8 *address_of(uint64 offset) const {
+            return this->segments[offset / this->segment_size] + offset % this->segment_size;
+        }
+
+        /// \return The address of the segment of the \a index.
+        inline uint8 *get_segment(uint32 index) const { return this->segments[index]; }
+
+        /// \return The byte size of the segment of the \a index.
+        [[nodiscard]] uint64 get_segment_size(uint32 index) const;
+
+    private:
+        /// The addresses of the segments.
+        uint8 **segments;
+        /// The links within the side table of the large-object space.
+        LargeObject *previous;
+        LargeObject *next;
+
+        LargeObject(uint64 size, uint64 segment_size, uint32 segment_count);
+
+        ~LargeObject();
+
+        friend class Management;
+    };
+
+    /// The options of the host pages backing the heap memory sections mapped by the memory management.
+    struct HeapMapOptions {
+        /// The page size backing the heap memory sections.
+        enum class PageMode : uint8 {
+            /// The host default page size.
+            DEFAULT,
+            /// Advise the host to back the sections with transparent huge pages when available.
+            TRANSPARENT_HUGE,
+            /// Back the sections with explicit huge pages reserved by the host, the mapping falls back to
+            /// \c PageMode::TRANSPARENT_HUGE if the host is unable to provide them.
+            EXPLICIT_HUGE
+        };
+
+        /// The placement of the heap memory sections on the NUMA nodes of the host.
+        enum class NumaPolicy : uint8 {
+            /// The pages are placed on the node of the thread that first faults them in.
+            DEFAULT,
+            /// The pages are placed only on the nodes within \c HeapMapOptions::numa_node_mask.
+            BIND,
+            /// The pages are interleaved across the nodes within \c HeapMapOptions::numa_node_mask.
+            INTERLEAVE
+        };
+
+        PageMode page_mode = PageMode::DEFAULT;
+        /// Whether the pages of the sections are faulted in on mapping, this trades the mapping latency for the
+        /// absence of page faults on the first access of the heap.
+        bool pre_fault = false;
+        NumaPolicy numa_policy = NumaPolicy::DEFAULT;
+        /// The bit mask of the NUMA nodes used by \c HeapMapOptions::numa_policy, must not be empty if the policy is
+        /// not \c NumaPolicy::DEFAULT.
+        uint64 numa_node_mask = 0;
+    };
+
     /// The request as a parameter to initialize the memory management and provide params for the chosen \c Algorithm.
     struct MemoryInitRequest : public vm::Request {
+        /// The default of \c MemoryInitRequest::soft_heap_percent.
+        static const uint32 DEFAULT_SOFT_HEAP_PERCENT = 80;
+        /// The default of \c MemoryInitRequest::container_heap_percent.
+        static const uint32 DEFAULT_CONTAINER_HEAP_PERCENT = 75;
+
         /// The maximum utilizable heap memory managed by the memory management, this is padded with extra bits to be
-        /// commensurate with the system page size.
+        /// commensurate with the system page size. If set to 0, the heap is sized to the container memory limit by
+        /// \c MemoryInitRequest::container_heap_percent.
         uint64 max_heap_size;
         /// The memory management algorithm to be used in the current \c Management object.
         Algorithm *algorithm;
         /// The pointer of the parameters (if any) for the chosen \c Algorithm.
         void *algorithm_params;
+        /// The options of the host pages backing the heap memory sections.
+        HeapMapOptions heap_map_options;
+        /// The percentage of the max heap size at which the registered \c PressureListener are notified of
+        /// \c MemoryPressure::SOFT, within [0, 100]; the soft limit is disabled with 100.
+        uint32 soft_heap_percent = DEFAULT_SOFT_HEAP_PERCENT;
+        /// The percentage of the memory limit of the container detected on instantiation, to which the max heap size
+        /// is capped, within [0, 100]; the detection is disabled with 0.
+        uint32 container_heap_percent = DEFAULT_CONTAINER_HEAP_PERCENT;
 
         /// \param max_heap_size The maximum utilizable heap memory managed by the memory management.
         /// \param algorithm The memory management algorithm to be used in the current \c Management object.
         /// \param algorithm_params The pointer of the parameters (if any) for the chosen \c Algorithm.
-        explicit MemoryInitRequest(uint64 max_heap_size, Algorithm *algorithm, void *algorithm_params = nullptr);
+        /// \param heap_map_options The options of the host pages backing the heap memory sections.
+        explicit MemoryInitRequest(uint64 max_heap_size, Algorithm *algorithm, void *algorithm_params = nullptr,
+                                   HeapMapOptions heap_map_options = HeapMapOptions());
+    };
+
+    /// The levels of the memory pressure notified to the \c PressureListener of a \c Management.
+    enum class MemoryPressure : uint8 {
+        /// The mapped heap size exceeds \c Management::SOFT_HEAP_SIZE, notified once until the mapped heap size falls
+        /// back to the soft limit.
+        SOFT,
+        /// A heap mapping is about to fail for reaching \c Management::MAX_HEAP_SIZE, the mapping is retried once
+        /// after the listeners are notified.
+        CRITICAL
+    };
+
+    /// A listener registered to a \c Management to release the memory it can spare under memory pressure, for example
+    /// a cache evictor or a pool trimmer.
+    /// \attention The listener is invoked on the thread mapping the heap, which might be amid an allocation of the
+    /// \c Algorithm; thus the listener must not allocate from the management, nor free any \c Pointer of the
+    /// algorithm, but it might free the memory it owns directly such as a \c LargeObject.
+    class PressureListener {
+    public:
+        PressureListener();
+
+        virtual ~PressureListener() = default;
+
+        /// Release the memory this listener can spare under the \a pressure of the \a management.
+        virtual void relieve(Management &management, MemoryPressure pressure) = 0;
+
+    private:
+        /// The next listener registered to the same management.
+        PressureListener *next;
+
+        friend class Management;
     };
 
     /// The request as a parameter to initialize the memory management algorithm, with attributes as a subset of
@@ -127,7 +306,7 @@ namespace veil::memory {
     ///          exclusive, the algorithm held the final decision on whether the acquisition
     ///          will be exclusive. </li>
     ///     <li> The maximum memory size associated with a \c Pointer must not exceed 4GiB, allocation larger than this
-    ///          should be handled beyond the management algorithm. </li>
+    ///          is handled beyond the management algorithm by \c Management::allocate_large. </li>
     /// </ul>
     class Algorithm : public vm::RequestExecutor, public memory::ValueObject, public vm::HasName {
     public:
@@ -142,8 +321,9 @@ namespace veil::memory {
 
         /// \brief Terminate all the implicit algorithm-specific sub-routines and delete all implicit algorithm-specific
         /// data structures within the memory management.
-        /// \param request The request of the termination operation.
-        virtual void terminate(vm::Request &request) = 0;
+        /// \param management The root \c Management of the structures to be deleted.
+        /// \param request    The request of the termination operation.
+        virtual void terminate(Management &management, vm::Request &request) = 0;
 
         /// \brief The maximum supported heap size of this memory management algorithm implementation.
         /// \attention The root \c Management will check this value on initialization, if this value is smaller than
@@ -160,6 +340,23 @@ namespace veil::memory {
         /// \param request    The request of the action.
         /// \return           An \c Allocator of the provided \a management.
         virtual Allocator *create_allocator(Management &management, vm::Request &request) = 0;
+
+    protected:
+        /// \return The algorithm specific structure stored within \c Management::structure.
+        static void *get_structure(Management &management);
+
+        /// Install the algorithm specific structure into \c Management::structure.
+        static void set_structure(Management &management, void *structure);
+
+        /// Delegate of \c Management::heap_map for the algorithm implementations.
+        static void heap_map(Management &management, HeapMapRequest &request);
+
+        /// Delegate of \c Management::heap_unmap for the algorithm implementations.
+        static void heap_unmap(Management &management, HeapUnmapRequest &request);
+
+        /// \return The statistics of the collections of the \a management, which a garbage collecting algorithm
+        ///         records its collections into.
+        static CollectionStatistics &collection_statistics(Management &management);
     };
 
     /// A \c Pointer represents a static placeholder that stores the address and byte size of the its associated memory
@@ -220,12 +417,66 @@ namespace veil::memory {
         /// \param request   The request of the operation.
         virtual void release(PointerActionRequest &request) = 0;
 
+        /// \brief Acquire the access right to a group of pointers in a single operation, with the same semantics as
+        /// \c Allocator::acquire applied to each of the pointers in order.
+        /// \attention The default implementation acquires the pointers one by one with \c Allocator::acquire, an
+        /// algorithm might override this method to amortize the cost of the acquisitions. If any of the acquisitions
+        /// fails, the pointers acquired by this operation are released and the error is set to the \a request.
+        /// \param request The request of the operation.
+        virtual void acquire_batch(PointerBatchAcquireRequest &request);
+
+        /// \brief Release the access right to a group of pointers in a single operation, with the same semantics as
+        /// \c Allocator::release applied to each of the pointers in the reverse order.
+        /// \attention The default implementation releases the pointers one by one with \c Allocator::release.
+        /// \param request The request of the operation.
+        virtual void release_batch(PointerBatchReleaseRequest &request);
+
+        /// \return The statistics of the memory sectors allocated and freed by this allocator, which are readable
+        ///         from any thread.
+        [[nodiscard]] const AllocatorStatistics &get_statistics() const;
+
+        /// \brief The inline fast path of \c Allocator::allocate used by \c AllocatorFrontEnd, an algorithm specific
+        /// allocator provides its own fast path by hiding this method.
+        /// \return The pointer of the memory sector of \a size, or \c nullptr if the allocation must be served by
+        /// \c Allocator::allocate.
+        inline Pointer *try_allocate(uint64) { return nullptr; }
+
+        /// \brief The inline fast path of \c Allocator::acquire used by \c AllocatorFrontEnd, an algorithm specific
+        /// allocator provides its own fast path by hiding this method.
+        /// \return The current address of the acquired pointer, or \c nullptr if the acquisition must be served by
+        /// \c Allocator::acquire.
+        inline uint8 *try_acquire(Pointer *, bool) { return nullptr; }
+
+        /// \brief The inline fast path of \c Allocator::release used by \c AllocatorFrontEnd, an algorithm specific
+        /// allocator provides its own fast path by hiding this method.
+        /// \return Whether the pointer is released, otherwise the release must be served by \c Allocator::release.
+        inline bool try_release(Pointer *) { return false; }
+
         /// The allocator must be provided by the memory management directly, the way to instantiate an object of this
         /// class is to call the constructor on a memory section with the size of this class.
         void *operator new(size_t size) = delete;
 
         /// The allocator must be recycled or deleted by it's root \c Management.
         void operator delete(void *) = delete;
+
+    protected:
+        /// The statistics recorded by the algorithm specific allocator, which is registered to the root management.
+        AllocatorStatistics statistics;
+
+        /// \return The algorithm specific structure stored within \c Management::structure of the root management.
+        void *get_structure();
+
+        /// Delegate of \c Management::heap_map of the root management.
+        void heap_map(HeapMapRequest &request);
+
+        /// Delegate of \c Management::heap_unmap of the root management.
+        void heap_unmap(HeapUnmapRequest &request);
+
+        /// Return the current address of the acquired pointer to the \a request.
+        static void set_address(PointerAcquireRequest &request, uint8 *address);
+
+        /// Return the current address of the acquired pointer at the \a index to the \a request.
+        static void set_address(PointerBatchAcquireRequest &request, uint32 index, uint8 *address);
     };
 
     /// The request as a parameter to map a heap memory section.
@@ -245,6 +496,18 @@ namespace veil::memory {
         friend class Management;
     };
 
+    /// The request as a parameter to unmap a heap memory section mapped by \c Management::heap_map.
+    struct HeapUnmapRequest : public vm::Request {
+        /// The address of the memory section returned by \c HeapMapRequest::get_address.
+        uint8 *const address;
+        /// The size of the memory section, which must be identical to \c HeapMapRequest::size of the mapping.
+        const uint64 size;
+
+        /// \param address The address of the memory section to be unmapped.
+        /// \param size    The size of the memory section to be unmapped.
+        HeapUnmapRequest(uint8 *address, uint64 size);
+    };
+
     // TODO: Add documentations.
     class Management : memory::HeapObject, vm::RequestExecutor, vm::HasRoot<Runtime> {
     public:
@@ -252,6 +515,10 @@ namespace veil::memory {
         /// commensurate with the system page size.
         const uint64 MAX_HEAP_SIZE;
 
+        /// The mapped heap size above which the registered \c PressureListener are notified of
+        /// \c MemoryPressure::SOFT, derived from \c MemoryInitRequest::soft_heap_percent.
+        const uint64 SOFT_HEAP_SIZE;
+
         /// \brief Construct a new instance of memory management.
         /// \param runtime The host runtime where this management belongs.
         /// \param request The request of the construction.
@@ -261,14 +528,118 @@ namespace veil::memory {
         // TODO: Add documentations.
         Allocator *create_allocator(vm::Request &request);
 
+        /// \brief Terminate the memory management instance, the chosen \c Algorithm deletes all its structures and the
+        /// contiguous heap range is unmapped, thus all the allocators and pointers are invalidated.
+        /// \param management The management instance to be terminated, which is deleted by this method.
+        /// \param request    The request of the termination.
+        static void terminate(Management *management, vm::Request &request);
+
+        /// \brief Allocate a \c LargeObject from the large-object space, each segment of the object is mapped as a
+        /// dedicated heap memory section with \c Management::heap_map, bypassing the \c Algorithm; the object is
+        /// recorded in the side table of the space until it is freed.
+        /// \attention The memory of the object is zeroed, and it is neither traced nor moved by the algorithm, thus
+        /// the object must not contain any reference to the pointers of the algorithm.
+        /// \param request The request of the allocation, the error \c ERR_INV_POINTER_SIZE is set if the size is 0 or
+        ///                the object consists of more than \c UINT32_MAX segments.
+        /// \return        The allocated object, or \c nullptr if the allocation fails.
+        LargeObject *allocate_large(LargeAllocateRequest &request);
+
+        /// \brief Free a \c LargeObject allocated by \c Management::allocate_large, the segments are unmapped
+        /// immediately, thus their physical pages are returned to the host eagerly.
+        /// \param object  The object to be freed, which is deleted by this method.
+        /// \param request The request of the operation.
+        void free_large(LargeObject *object, vm::Request &request);
+
+        /// \return The total byte size of the objects within the large-object space.
+        [[nodiscard]] uint64 get_large_size() const;
+
+        /// Register the \a listener to be notified of the memory pressure, a listener must not be registered to more
+        /// than one management at a time.
+        void add_pressure_listener(PressureListener &listener);
+
+        /// Unregister the \a listener registered by \c Management::add_pressure_listener, which might be deleted
+        /// afterwards.
+        void remove_pressure_listener(PressureListener &listener);
+
+        /// Take a snapshot of the heap usage into the \a statistics, without blocking any allocator or collector.
+        void get_statistics(HeapStatistics &statistics);
+
+        /// \return Whether the \a address lies within the contiguous heap range of this management.
+        inline bool heap_contains(const void *address) const {
+            auto *target = static_cast<const uint8 *>(address);
+            return target >= this->heap_base && target < this->heap_base + this->MAX_HEAP_SIZE;
+        }
+
+        /// \attention The offset fits in 32 bits as long as \c Management::MAX_HEAP_SIZE does not exceed 4GiB, which
+        /// allows the heap addresses to be stored in a compressed form.
+        /// \return The offset of the heap \a address from the base of the contiguous heap range.
+        inline uint64 heap_offset(const void *address) const {
+            return static_cast<const uint8 *>(address) - this->heap_base;
+        }
+
+        /// \return The heap address of the \a offset returned by \c Management::heap_offset.
+        inline uint8 *heap_address(uint64 offset) const { return this->heap_base + offset; }
+
     private:
-        // TODO: Add documentations.
+        /// A decommitted heap memory section below \c Management::heap_top available for subsequent mappings.
+        struct HeapSection;
+
+        /// The total size of the committed heap memory sections.
         os::atomic_u64_t mapped_heap_size;
 
+        /// The base address of the contiguous heap range of \c Management::MAX_HEAP_SIZE, reserved without any access
+        /// permission on instantiation, the heap memory sections are committed within this range on demand.
+        uint8 *heap_base;
+
+        /// The granularity of the committed heap memory sections, which is the huge page size if huge pages are
+        /// requested by \c Management::heap_map_options, or the host page size otherwise.
+        uint64 heap_granularity;
+
+        /// The mutex guarding \c Management::heap_top and \c Management::free_sections.
+        os::Mutex heap_map_m;
+
+        /// The address above which the heap range has never been committed.
+        uint8 *heap_top;
+
+        /// The decommitted heap memory sections ordered by address, adjacent sections are coalesced.
+        HeapSection *free_sections;
+
+        /// The options of the host pages backing the heap memory sections.
+        const HeapMapOptions heap_map_options;
+
+        /// The mutex guarding \c Management::large_objects.
+        os::Mutex large_m;
+
+        /// The side table of the large-object space, which is a list of the objects linked by \c LargeObject::next.
+        LargeObject *large_objects;
+
+        /// The total byte size of the objects within the large-object space.
+        os::atomic_u64_t large_size;
+
+        /// The mutex guarding \c Management::allocator_statistics.
+        os::Mutex statistics_m;
+
+        /// The registry of the statistics of the allocators, linked by \c AllocatorStatistics::next.
+        AllocatorStatistics *allocator_statistics;
+
+        CollectionStatistics collection_statistics;
+
+        /// The mutex guarding \c Management::pressure_listeners, which is held along the notification of the
+        /// listeners to prevent the removal of a listener amid its invocation.
+        os::Mutex pressure_m;
+
+        /// The registered listeners linked by \c PressureListener::next.
+        PressureListener *pressure_listeners;
+
+        /// Whether the \c MemoryPressure::SOFT is notified since the mapped heap size exceeds the soft limit.
+        os::atomic_bool_t soft_pressured;
+
         // TODO: Add documentations.
-        Management(Runtime &runtime, Algorithm *algorithm, uint64 max_heap_size);
+        Management(Runtime &runtime, Algorithm *algorithm, uint64 max_heap_size, uint64 soft_heap_size,
+                   HeapMapOptions heap_map_options, uint8 *heap_base, uint64 heap_granularity);
 
-        ~Management() = default;
+        /// Unmap the contiguous heap range, all heap memory sections are invalidated.
+        ~Management();
 
         // TODO: Add documentations.
         Algorithm *algorithm;
@@ -279,11 +650,29 @@ namespace veil::memory {
         ///  the static \c Management::create method.
         void *structure;
 
-        /// Map a heap memory section in 64bit swap memory space, the mapped section is permitted to perform
-        /// READ & WRITE operations.
+        /// Map a heap memory section by committing a range within the contiguous heap range, the mapped section is
+        /// permitted to perform READ & WRITE operations, and is backed by the pages specified by
+        /// \c Management::heap_map_options. The size of the section is padded to the heap granularity.
         /// \param request The request of the mapping.
         void heap_map(HeapMapRequest &request);
 
+        /// Unmap a heap memory section mapped by \c Management::heap_map, the physical pages of the section are
+        /// returned to the host and its range is available to the subsequent mappings.
+        /// \param request The request of the unmapping.
+        void heap_unmap(HeapUnmapRequest &request);
+
+        /// Return the range of a heap memory section to \c Management::free_sections, the caller must hold
+        /// \c Management::heap_map_m.
+        void free_section(uint8 *address, uint64 size);
+
+        /// Take the range of a heap memory section of the \a size from \c Management::free_sections or above
+        /// \c Management::heap_top.
+        /// \return The address of the range, or \c nullptr if the range exceeds \c Management::MAX_HEAP_SIZE.
+        uint8 *take_section(uint64 size);
+
+        /// Notify the registered listeners of the \a pressure.
+        void relieve_pressure(MemoryPressure pressure);
+
         // The class Allocator needs to access delegate functions encapsulating the operations from the algorithm.
         friend class Allocator;
 
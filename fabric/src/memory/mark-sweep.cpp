@@ -0,0 +1,1517 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "src/memory/mark-sweep.hpp"
+#include "src/memory/os.hpp"
+#include "src/threading/os.hpp"
+#include "src/vm/errors.hpp"
+#include "src/vm/os.hpp"
+
+using namespace veil::memory;
+
+/// The index of an absent cell.
+static const uint32 NO_CELL = UINT32_MAX;
+
+/// The interval in milliseconds the collector and the waiting threads poll their conditions, as the condition
+/// variables do not carry a predicate and a notification might be missed.
+static const uint32 POLL_INTERVAL = 10;
+
+/// The size allocated by an allocator before it is accounted to the heap.
+static const uint64 ACCOUNT_THRESHOLD = 64 * 1024;
+
+/// The binary logarithm of the byte size of the heap range covered by a card.
+static const uint32 CARD_SHIFT = 9;
+
+/// The number of the empty nursery chunks kept for the allocators, the subsequent ones are unmapped.
+static const uint32 FREE_CHUNK_CAPACITY = 4;
+
+struct veil::memory::MarkSweepBlock : public HeapObject {
+    uint8 *const base;
+    const uint32 size_class;
+    const uint32 cell_size;
+    const uint32 cell_count;
+    /// The pointer of each cell, \c nullptr if the cell is free.
+    MarkSweepPointer **owners;
+    /// The free cells are linked by the index stored within the first word of the cell.
+    uint32 free_head;
+    /// The cells beyond this index have never been allocated, thus they are not linked to the free cells.
+    uint32 bump_index;
+    uint32 live_count;
+    /// The epoch of the collection which the block is last swept for.
+    uint32 swept_epoch;
+    MarkSweepBlock *next;
+
+    MarkSweepBlock(uint8 *base, uint32 size_class, uint32 swept_epoch) :
+            base(base), size_class(size_class), cell_size(MarkSweepAllocator::cell_size_of(size_class)),
+            cell_count(MarkSweepAllocator::BLOCK_SIZE / MarkSweepAllocator::cell_size_of(size_class)),
+            free_head(NO_CELL), bump_index(0), live_count(0), swept_epoch(swept_epoch), next(nullptr) {
+        this->owners = static_cast<MarkSweepPointer **>(veil::os::malloc(this->cell_count * sizeof(void *)));
+        memset(this->owners, 0, this->cell_count * sizeof(void *));
+    }
+
+    ~MarkSweepBlock() {
+        veil::os::free(this->owners);
+    }
+
+    [[nodiscard]] bool has_free_cell() const {
+        return this->free_head != NO_CELL || this->bump_index < this->cell_count;
+    }
+
+    uint32 take_cell() {
+        if (this->free_head != NO_CELL) {
+            uint32 index = this->free_head;
+            this->free_head = *reinterpret_cast<uint32 *>(this->base + index * this->cell_size);
+            return index;
+        }
+        return this->bump_index++;
+    }
+
+    void free_cell(uint32 index) {
+        *reinterpret_cast<uint32 *>(this->base + index * this->cell_size) = this->free_head;
+        this->free_head = index;
+        this->owners[index] = nullptr;
+        this->live_count--;
+    }
+};
+
+/// A large object mapped as a dedicated heap memory section.
+struct MarkSweepLarge : public HeapObject {
+    MarkSweepPointer *const owner;
+    const uint64 size;
+    MarkSweepLarge *next;
+
+    MarkSweepLarge(MarkSweepPointer *owner, uint64 size, MarkSweepLarge *next) : owner(owner), size(size), next(next) {}
+};
+
+struct veil::memory::MarkSweepChunk : public HeapObject {
+    uint8 *const base;
+    const uint32 size;
+    /// The offset of the next object, only modified by the allocator owning the chunk.
+    uint32 bump;
+    /// The pointers of the objects in the order of allocation, or of the pinned objects once promoted in place.
+    PointerStack objects;
+    /// The number of the objects promoted in place, the chunk is returned to the host once all of them are dead.
+    uint32 pinned_count;
+    MarkSweepChunk *next;
+
+    MarkSweepChunk(uint8 *base, uint32 size) : base(base), size(size), bump(0), pinned_count(0), next(nullptr) {}
+};
+
+/// The blocks of a size class which are not owned by any allocator.
+struct MarkSweepClass {
+    veil::os::Mutex class_m;
+    /// The blocks which are not swept since the last marking.
+    MarkSweepBlock *unswept = nullptr;
+    /// The swept blocks with free cells.
+    MarkSweepBlock *available = nullptr;
+    /// The swept blocks without free cells.
+    MarkSweepBlock *exhausted = nullptr;
+};
+
+class veil::memory::MarkSweepHeap : public HeapObject {
+public:
+    Management &management;
+    /// The statistics of the collections of the management.
+    CollectionStatistics &collections;
+    ReferenceScanner *const scanner;
+    const uint32 trigger_percent;
+    const uint64 min_trigger_size;
+    const uint32 compact_percent;
+    /// The parallel marker shared with the other heaps, \c nullptr if the collector marks alone.
+    ParallelMarker *const marker;
+
+    MarkSweepClass classes[MarkSweepAllocator::SIZE_CLASS_COUNT];
+
+    /// The mutex guarding the storage and the free stack of the pointers.
+    os::Mutex pointer_m;
+    TArena<MarkSweepPointer> pointers;
+    MarkSweepPointer *free_pointers;
+
+    os::Mutex large_m;
+    MarkSweepLarge *large_objects;
+
+    os::Mutex roots_m;
+    PointerStack roots;
+
+    /// The mutex held by the collector throughout a collection, which holds off the collections during a snapshot.
+    os::Mutex collection_m;
+
+    /// The mutex guarding the barrier stack and the termination of the marking.
+    os::Mutex barrier_m;
+    PointerStack barrier_stack;
+
+    /// The epoch of the latest started collection.
+    os::atomic_u32_t epoch;
+    /// The epoch of the latest collection whose marking is terminated, the objects marked below this epoch are dead.
+    os::atomic_u32_t marked_epoch;
+    os::atomic_bool_t marking;
+
+    /// The size allocated since the start of the last collection.
+    os::atomic_u64_t allocated_size;
+    /// The size marked by the last collection.
+    os::atomic_u64_t live_size;
+    /// The size marked by the collection in progress, including the objects blackened by the barrier.
+    os::atomic_u64_t marked_size;
+
+    os::atomic_u32_t started_cycles;
+    os::atomic_u32_t completed_cycles;
+    /// The number of the cycle requested by \c TracingAllocator::collect.
+    os::atomic_u32_t requested_cycles;
+    os::atomic_bool_t terminating;
+    os::ConditionVariable collector_cv;
+    os::ConditionVariable completion_cv;
+    os::Thread collector_thread;
+    vm::Executable *collector;
+
+    os::Mutex allocators_m;
+    TArena<MarkSweepAllocator> allocators;
+
+    const uint32 nursery_size;
+    const uint64 minor_trigger_size;
+    /// The card table over the contiguous heap range, \c nullptr if the generations are disabled.
+    volatile uint8 *cards;
+    uint64 card_count;
+    /// Whether the marking in progress is of a minor collection.
+    os::atomic_bool_t minor;
+    /// The mutex guarding the filled and the empty nursery chunks.
+    os::Mutex nursery_m;
+    MarkSweepChunk *filled_chunks;
+    MarkSweepChunk *free_chunks;
+    uint32 free_chunk_count;
+    /// The size of the filled nursery chunks since the last minor collection.
+    os::atomic_u64_t filled_size;
+    /// The chunks holding the objects promoted in place, only accessed by the collector.
+    MarkSweepChunk *pinned_chunks;
+    os::atomic_u32_t minor_cycles;
+
+    MarkSweepHeap(Management &management, CollectionStatistics &collections, MarkSweepParams &params) :
+            management(management), collections(collections), scanner(params.scanner),
+            trigger_percent(params.trigger_percent), min_trigger_size(params.min_trigger_size),
+            compact_percent(params.compact_percent), marker(params.marker), free_pointers(nullptr),
+            large_objects(nullptr), epoch(0),
+            marked_epoch(0), marking(false), allocated_size(0), live_size(0), marked_size(0), started_cycles(0),
+            completed_cycles(0), requested_cycles(0), terminating(false), collector(nullptr),
+            nursery_size(params.nursery_size), minor_trigger_size(params.minor_trigger_size), cards(nullptr),
+            card_count(0), minor(false), filled_chunks(nullptr), free_chunks(nullptr), free_chunk_count(0),
+            filled_size(0), pinned_chunks(nullptr), minor_cycles(0) {}
+
+    /// Dirty the card of the object starting at the \a address.
+    void dirty(const uint8 *address) {
+        this->cards[this->management.heap_offset(address) >> CARD_SHIFT] = 1;
+    }
+
+    /// Clean the cards within the heap range of the \a size from the \a address.
+    /// \return Whether any of the cards is dirty.
+    bool clean(const uint8 *address, uint64 size) {
+        uint64 first = this->management.heap_offset(address) >> CARD_SHIFT;
+        uint64 last = (this->management.heap_offset(address) + size - 1) >> CARD_SHIFT;
+        bool dirty = false;
+        for (uint64 card = first; card <= last; card++) {
+            if (!this->cards[card]) continue;
+            this->cards[card] = 0;
+            dirty = true;
+        }
+        return dirty;
+    }
+
+    /// Shade the \a pointer if it is traced by the marking in progress, a minor marking only traces the young objects.
+    /// The young objects which are not condemned are either allocated black, or not condemned yet as the marking is
+    /// started before the nursery chunks are seized.
+    /// \return Whether the pointer is shaded by this invocation, which must be pushed onto a mark stack.
+    bool trace(MarkSweepPointer *pointer, uint32 epoch) {
+        if (this->minor.load() && pointer->generation == MarkSweepPointer::GEN_OLD) return false;
+        return shade(pointer, epoch);
+    }
+
+    /// \return The mark of an object allocated at this moment.
+    [[nodiscard]] uint32 allocation_mark() const { return (this->epoch.load() << 1) | 1; }
+
+    /// \return The size allocated to trigger the next collection.
+    [[nodiscard]] uint64 trigger_size() const {
+        uint64 proportional = this->live_size.load() / 100 * this->trigger_percent;
+        return proportional > this->min_trigger_size ? proportional : this->min_trigger_size;
+    }
+
+    /// \return Whether the live objects of the swept \a block should be evacuated.
+    [[nodiscard]] bool is_sparse(const MarkSweepBlock &block) const {
+        return static_cast<uint64>(block.live_count) * 100 <
+               static_cast<uint64>(block.cell_count) * this->compact_percent;
+    }
+
+    /// Shade the \a pointer gray in the collection of the \a epoch.
+    /// \return Whether the pointer is shaded by this invocation, which must be pushed onto a mark stack.
+    static bool shade(MarkSweepPointer *pointer, uint32 epoch) {
+        uint32 gray = epoch << 1;
+        uint32 mark = pointer->mark.load();
+        while (mark < gray) {
+            uint32 witnessed = pointer->mark.compare_exchange(mark, gray);
+            if (witnessed == mark) return true;
+            mark = witnessed;
+        }
+        return false;
+    }
+
+    /// Return the \a pointers linked by \c MarkSweepPointer::next_free to the free stack.
+    void free_pointer_list(MarkSweepPointer *pointers) {
+        if (!pointers) return;
+        // The capacities of the dead objects are accounted before the pointers are reused.
+        uint64 collected_size = pointers->capacity;
+        MarkSweepPointer *last = pointers;
+        while (last->next_free) {
+            last = last->next_free;
+            collected_size += last->capacity;
+        }
+        this->collections.record_collected(collected_size);
+        os::CriticalSection _(this->pointer_m);
+        last->next_free = this->free_pointers;
+        this->free_pointers = pointers;
+    }
+
+    /// Sweep the \a block for the marking of the \a epoch, the pointers of the dead objects are returned to the free
+    /// stack. The caller must either own the block or hold the mutex of its size class.
+    void sweep(MarkSweepBlock *block, uint32 epoch) {
+        uint32 threshold = epoch << 1;
+        MarkSweepPointer *dead = nullptr;
+        for (uint32 index = 0; index < block->bump_index; index++) {
+            MarkSweepPointer *owner = block->owners[index];
+            if (!owner || owner->mark.load() >= threshold || owner->pins.load()) continue;
+            block->free_cell(index);
+            owner->next_free = dead;
+            dead = owner;
+        }
+        block->swept_epoch = epoch;
+        this->free_pointer_list(dead);
+    }
+};
+
+/// Collects the references enumerated by the \c ReferenceScanner onto a stack.
+class ReferenceCollector : public veil::vm::Consumer<Pointer *> {
+public:
+    explicit ReferenceCollector(PointerStack &target) : target(target) {}
+
+    void execute(Pointer *pointer) override {
+        if (pointer) this->target.push(pointer);
+    }
+
+private:
+    PointerStack &target;
+};
+
+/// Shades the references enumerated by the \c ReferenceScanner, the shaded references are pushed onto a stack.
+class ReferenceShader : public veil::vm::Consumer<Pointer *> {
+public:
+    ReferenceShader(MarkSweepHeap &heap, PointerStack &target, uint32 epoch) :
+            heap(heap), target(target), epoch(epoch), young(false) {}
+
+    void execute(Pointer *pointer) override {
+        if (!pointer) return;
+        auto *reference = static_cast<MarkSweepPointer *>(pointer);
+        if (this->heap.trace(reference, this->epoch)) this->target.push(pointer);
+        if (reference->generation == MarkSweepPointer::GEN_NURSERY) this->young = true;
+    }
+
+    /// \return Whether any reference is to an object in a nursery chunk which is not condemned.
+    [[nodiscard]] bool has_young() const { return this->young; }
+
+private:
+    MarkSweepHeap &heap;
+    PointerStack &target;
+    const uint32 epoch;
+    bool young;
+};
+
+/// Finds whether any reference enumerated by the \c ReferenceScanner is to an object in a nursery chunk which is not
+/// condemned.
+class YoungReferenceFinder : public veil::vm::Consumer<Pointer *> {
+public:
+    YoungReferenceFinder() : young(false) {}
+
+    void execute(Pointer *pointer) override {
+        if (pointer && static_cast<MarkSweepPointer *>(pointer)->generation == MarkSweepPointer::GEN_NURSERY)
+            this->young = true;
+    }
+
+    [[nodiscard]] bool has_young() const { return this->young; }
+
+private:
+    bool young;
+};
+
+/// Records the references enumerated by the \c ReferenceScanner into a heap snapshot, the references not visited yet
+/// are pushed onto a stack to be written.
+class SnapshotRecorder : public veil::vm::Consumer<Pointer *> {
+public:
+    SnapshotRecorder(HeapSnapshotWriter &writer, PointerSet &visited, PointerStack &pending) :
+            writer(writer), visited(visited), pending(pending) {}
+
+    void execute(Pointer *pointer) override {
+        if (!pointer) return;
+        this->writer.write_reference(pointer);
+        if (this->visited.insert(pointer)) this->pending.push(pointer);
+    }
+
+private:
+    HeapSnapshotWriter &writer;
+    PointerSet &visited;
+    PointerStack &pending;
+};
+
+class MarkSweepAlgorithm::Collector final : public vm::Executable, public MarkTracer {
+public:
+    explicit Collector(MarkSweepHeap &heap) : heap(heap), client(true), worker_clients(nullptr), tracing_epoch(0) {
+        if (!heap.marker) return;
+        // The workers other than the collector itself acquire the objects with their own clients, all of which restore
+        // the biases towards the allocators as the objects are only visited.
+        uint32 worker_count = heap.marker->get_worker_count();
+        this->worker_clients = static_cast<threading::ThinLockClient *>(
+                os::malloc(worker_count * sizeof(threading::ThinLockClient)));
+        for (uint32 index = 1; index < worker_count; index++)
+            ::new(&this->worker_clients[index]) threading::ThinLockClient(true);
+    }
+
+    ~Collector() {
+        if (!this->worker_clients) return;
+        for (uint32 index = 1; index < this->heap.marker->get_worker_count(); index++)
+            this->worker_clients[index].~ThinLockClient();
+        os::free(this->worker_clients);
+    }
+
+    void execute() override {
+        MarkSweepHeap &target = this->heap;
+        while (!target.terminating.load()) {
+            bool requested = target.requested_cycles.load() > target.completed_cycles.load();
+            bool major = requested || target.allocated_size.load() >= target.trigger_size();
+            // A requested collection collects the nursery chunks before the full marking, as the full marking does
+            // not reclaim the objects of the nursery chunks.
+            bool minor = target.cards && (requested || target.filled_size.load() >= target.minor_trigger_size);
+            if (!major && !minor) {
+                target.collector_cv.wait_for(POLL_INTERVAL);
+                continue;
+            }
+            os::CriticalSection _(target.collection_m);
+            if (minor) this->minor_cycle();
+            // The promotion might trigger a full collection.
+            if (major || target.allocated_size.load() >= target.trigger_size()) {
+                this->cycle();
+                target.completion_cv.notify_all();
+            }
+        }
+    }
+
+private:
+    MarkSweepHeap &heap;
+    /// The mark stack of the collector.
+    PointerStack stack;
+    /// The objects to be rescanned regardless of their marks.
+    PointerStack rescans;
+    /// The client used to acquire the objects to be scanned or relocated, which restores the biases it revokes.
+    threading::ThinLockClient client;
+    /// The blocks the sparse blocks are evacuated into, or the survivors of the nursery chunks are promoted into per
+    /// size class.
+    MarkSweepBlock *destinations[MarkSweepAllocator::SIZE_CLASS_COUNT] = {};
+    /// The old objects of the dirty cards to be scanned by a minor collection.
+    PointerStack remembered;
+    /// The objects promoted in place within the nursery chunk being promoted.
+    PointerStack survivors;
+    /// The clients of the parallel marking workers indexed by the worker, the index 0 is the collector itself.
+    threading::ThinLockClient *worker_clients;
+    /// The epoch of the parallel marking in progress.
+    uint32 tracing_epoch;
+
+    void cycle() {
+        MarkSweepHeap &target = this->heap;
+        uint64 start_time = os::current_time_nanoseconds();
+        uint32 epoch = target.epoch.load() + 1;
+        (void) target.started_cycles.fetch_add(1);
+        target.allocated_size.store(0);
+        target.marked_size.store(0);
+
+        {
+            // The objects are allocated black once the epoch is advanced.
+            os::CriticalSection _(target.barrier_m);
+            target.epoch.store(epoch);
+            target.marking.store(true);
+        }
+        {
+            os::CriticalSection _(target.roots_m);
+            for (uint32 index = 0; index < target.roots.size(); index++) {
+                auto *root = static_cast<MarkSweepPointer *>(target.roots.at(index));
+                if (MarkSweepHeap::shade(root, epoch)) this->stack.push(root);
+            }
+        }
+        this->mark(epoch);
+
+        target.live_size.store(target.marked_size.load());
+        this->sweep(epoch);
+        target.collections.record_collection(os::current_time_nanoseconds() - start_time);
+        (void) target.completed_cycles.fetch_add(1);
+    }
+
+    void minor_cycle() {
+        MarkSweepHeap &target = this->heap;
+        uint64 start_time = os::current_time_nanoseconds();
+        uint32 epoch = target.epoch.load() + 1;
+        {
+            // The marking is started before the chunks are seized, otherwise a reference moved from a young object
+            // into an object allocated after the seizure is not shaded by any barrier.
+            os::CriticalSection _(target.barrier_m);
+            target.epoch.store(epoch);
+            target.minor.store(true);
+            target.marking.store(true);
+        }
+        MarkSweepChunk *condemned;
+        {
+            os::CriticalSection _(target.nursery_m);
+            condemned = target.filled_chunks;
+            target.filled_chunks = nullptr;
+            target.filled_size.store(0);
+        }
+        {
+            // The chunks being filled are seized as well, thus every young object is condemned.
+            os::CriticalSection _(target.allocators_m);
+            TArenaIterator<MarkSweepAllocator> iterator(target.allocators);
+            for (MarkSweepAllocator *allocator = iterator.next(); allocator; allocator = iterator.next()) {
+                while (allocator->nursery_lock.exchange(1)) os::Thread::static_sleep(0);
+                MarkSweepChunk *chunk = allocator->nursery;
+                if (chunk && chunk->bump) {
+                    allocator->nursery = nullptr;
+                    chunk->next = condemned;
+                    condemned = chunk;
+                }
+                allocator->nursery_lock.store(0);
+            }
+        }
+        if (!condemned) {
+            // The objects shaded by the barriers are young objects which are left in their chunks.
+            os::CriticalSection _(target.barrier_m);
+            target.marking.store(false);
+            target.minor.store(false);
+            while (target.barrier_stack.pop());
+            return;
+        }
+        for (MarkSweepChunk *chunk = condemned; chunk; chunk = chunk->next) {
+            for (uint32 index = 0; index < chunk->objects.size(); index++)
+                static_cast<MarkSweepPointer *>(chunk->objects.at(index))->generation = MarkSweepPointer::GEN_CONDEMNED;
+        }
+
+        {
+            os::CriticalSection _(target.roots_m);
+            for (uint32 index = 0; index < target.roots.size(); index++) {
+                auto *root = static_cast<MarkSweepPointer *>(target.roots.at(index));
+                if (target.trace(root, epoch)) this->stack.push(root);
+            }
+        }
+        this->scan_cards(epoch);
+        this->mark(epoch);
+
+        this->promote(condemned, epoch);
+        target.collections.record_collection(os::current_time_nanoseconds() - start_time);
+        (void) target.minor_cycles.fetch_add(1);
+    }
+
+    /// Collect the old objects starting within the dirty cards of the heap range of the \a size from the \a base,
+    /// the cards are cleaned before the objects are scanned thus a concurrent release dirties them again.
+    void collect_dirty(uint8 *base, uint64 size, uint32 cell_size, MarkSweepPointer **owners) {
+        MarkSweepHeap &target = this->heap;
+        uint64 first = target.management.heap_offset(base) >> CARD_SHIFT;
+        uint64 last = (target.management.heap_offset(base) + size - 1) >> CARD_SHIFT;
+        for (uint64 card = first; card <= last; card++) {
+            if (!target.cards[card]) continue;
+            target.cards[card] = 0;
+            uint8 *card_base = target.management.heap_address(card << CARD_SHIFT);
+            uint64 begin = card_base > base ? card_base - base : 0;
+            uint64 end = card_base + (1 << CARD_SHIFT) - base;
+            for (uint64 cell = (begin + cell_size - 1) / cell_size; cell * cell_size < end && cell * cell_size < size;
+                 cell++) {
+                MarkSweepPointer *owner = owners[cell];
+                if (owner && owner->generation == MarkSweepPointer::GEN_OLD) this->remembered.push(owner);
+            }
+        }
+    }
+
+    /// Shade the condemned objects referenced by the old objects of the dirty cards.
+    void scan_cards(uint32 epoch) {
+        MarkSweepHeap &target = this->heap;
+        // The objects are collected with the locks of the spaces, then scanned after the locks are released as the
+        // scanning waits for the holders of the objects.
+        for (MarkSweepClass &size_class: target.classes) {
+            os::CriticalSection _(size_class.class_m);
+            for (MarkSweepBlock *list: {size_class.unswept, size_class.available, size_class.exhausted}) {
+                for (MarkSweepBlock *block = list; block; block = block->next)
+                    this->collect_dirty(block->base, block->cell_count * block->cell_size, block->cell_size,
+                                        block->owners);
+            }
+        }
+        {
+            os::CriticalSection _(target.large_m);
+            for (MarkSweepLarge *large = target.large_objects; large; large = large->next) {
+                if (target.clean(large->owner->address, 1)) this->remembered.push(large->owner);
+            }
+        }
+        for (MarkSweepChunk *chunk = target.pinned_chunks; chunk; chunk = chunk->next) {
+            for (uint32 index = 0; index < chunk->objects.size(); index++) {
+                auto *pinned = static_cast<MarkSweepPointer *>(chunk->objects.at(index));
+                if (target.clean(pinned->address, 1)) this->remembered.push(pinned);
+            }
+        }
+
+        while (!this->remembered.is_empty()) {
+            auto *object = static_cast<MarkSweepPointer *>(this->remembered.pop());
+            this->client.wait(*object);
+            ReferenceShader shader(target, this->stack, epoch);
+            target.scanner->scan(*object, object->address, shader);
+            // The references to the objects allocated after the condemnation are kept in the remembered set.
+            if (shader.has_young()) target.dirty(object->address);
+            this->client.exit(*object);
+        }
+    }
+
+    /// Promote the survivors of the \a condemned chunks of the minor marking of the \a epoch, the survivors are copied
+    /// into the old space unless they are pinned, the chunks without any pinned survivor are recycled.
+    void promote(MarkSweepChunk *condemned, uint32 epoch) {
+        MarkSweepHeap &target = this->heap;
+        uint32 threshold = epoch << 1;
+        uint64 promoted_size = 0;
+        MarkSweepPointer *dead = nullptr;
+        while (condemned) {
+            MarkSweepChunk *chunk = condemned;
+            condemned = chunk->next;
+            // The cards of the chunk are dirtied again only for the objects promoted in place.
+            target.clean(chunk->base, chunk->size);
+            for (uint32 index = 0; index < chunk->objects.size(); index++) {
+                auto *object = static_cast<MarkSweepPointer *>(chunk->objects.at(index));
+                bool marked = object->mark.load() >= threshold;
+                if (!marked && !object->pins.load()) {
+                    // A dead pointer must not be traced through any stale reference.
+                    object->generation = MarkSweepPointer::GEN_OLD;
+                    object->next_free = dead;
+                    dead = object;
+                    continue;
+                }
+                if (this->copy(object, target.marked_epoch.load())) {
+                    promoted_size += object->capacity;
+                    continue;
+                }
+                // The marked objects promoted in place are remembered conservatively, while an unmarked pinned object
+                // is reserved thus does not contain any valid reference.
+                object->generation = MarkSweepPointer::GEN_OLD;
+                if (marked) target.dirty(object->address);
+                this->survivors.push(object);
+            }
+            while (chunk->objects.pop());
+            chunk->pinned_count = this->survivors.size();
+            this->survivors.transfer(chunk->objects);
+
+            if (chunk->pinned_count) {
+                chunk->next = target.pinned_chunks;
+                target.pinned_chunks = chunk;
+            } else {
+                this->recycle(chunk);
+            }
+        }
+        for (uint32 class_index = 0; class_index < MarkSweepAllocator::SIZE_CLASS_COUNT; class_index++)
+            this->retire_destination(class_index);
+        target.free_pointer_list(dead);
+        (void) target.allocated_size.fetch_add(promoted_size);
+    }
+
+    /// Copy the young \a object into a destination block of its size class.
+    /// \return Whether the object is copied, an object acquired or reserved is not copied.
+    bool copy(MarkSweepPointer *object, uint32 swept_epoch) {
+        if (object->pins.load()) return false;
+        MarkSweepBlock *destination = this->destination_of(MarkSweepAllocator::size_class_of(object->capacity),
+                                                           swept_epoch);
+        if (!destination) return false;
+
+        this->client.wait(*object);
+        bool copied = !object->pins.load();
+        if (copied) {
+            uint32 cell = destination->take_cell();
+            uint8 *address = destination->base + cell * destination->cell_size;
+            memcpy(address, object->address, object->capacity);
+            memset(address + object->capacity, 0, destination->cell_size - object->capacity);
+            this->heap.collections.record_copy(object->capacity, destination->cell_size);
+            object->address = address;
+            object->capacity = destination->cell_size;
+            object->generation = MarkSweepPointer::GEN_OLD;
+            destination->owners[cell] = object;
+            destination->live_count++;
+
+            YoungReferenceFinder finder;
+            this->heap.scanner->scan(*object, object->address, finder);
+            if (finder.has_young()) this->heap.dirty(object->address);
+        }
+        this->client.exit(*object);
+        return copied;
+    }
+
+    /// Recycle the empty nursery \a chunk for the allocators.
+    void recycle(MarkSweepChunk *chunk) {
+        MarkSweepHeap &target = this->heap;
+        target.clean(chunk->base, chunk->size);
+        chunk->bump = 0;
+        {
+            os::CriticalSection _(target.nursery_m);
+            if (target.free_chunk_count < FREE_CHUNK_CAPACITY) {
+                chunk->next = target.free_chunks;
+                target.free_chunks = chunk;
+                target.free_chunk_count++;
+                return;
+            }
+        }
+        HeapUnmapRequest unmap_request(chunk->base, chunk->size);
+        heap_unmap(target.management, unmap_request);
+        delete chunk;
+    }
+
+    /// Scan the \a object while acquired by the collector.
+    /// \param force Whether the object is scanned even if it is black.
+    void scan(MarkSweepPointer *object, uint32 epoch, bool force) {
+        this->scan(object, epoch, force, this->client, this->stack);
+    }
+
+    /// Scan the \a object with the \a scanner_client, the shaded references are pushed onto the \a gray stack.
+    void scan(MarkSweepPointer *object, uint32 epoch, bool force, threading::ThinLockClient &scanner_client,
+              PointerStack &gray) {
+        scanner_client.wait(*object);
+        uint32 black = (epoch << 1) | 1;
+        if (force || object->mark.load() != black) {
+            ReferenceShader shader(this->heap, gray, epoch);
+            this->heap.scanner->scan(*object, object->address, shader);
+            if (object->mark.load() != black) {
+                object->mark.store(black);
+                (void) this->heap.marked_size.fetch_add(object->capacity);
+            }
+        }
+        scanner_client.exit(*object);
+    }
+
+    void scan(Pointer *object, uint32 worker, PointerStack &gray) override {
+        this->scan(static_cast<MarkSweepPointer *>(object), this->tracing_epoch, false,
+                   worker ? this->worker_clients[worker] : this->client, gray);
+    }
+
+    void drain(uint32 epoch) {
+        if (this->heap.marker && !this->stack.is_empty()) {
+            this->tracing_epoch = epoch;
+            this->heap.marker->mark(*this, this->stack);
+            return;
+        }
+        while (!this->stack.is_empty()) {
+            this->scan(static_cast<MarkSweepPointer *>(this->stack.pop()), epoch, false);
+        }
+    }
+
+    /// Shade the objects held by the allocators, the objects held exclusively are rescanned after they are released.
+    void shade_held(uint32 epoch) {
+        MarkSweepHeap &target = this->heap;
+        {
+            os::CriticalSection _(target.allocators_m);
+            TArenaIterator<MarkSweepAllocator> iterator(target.allocators);
+            for (MarkSweepAllocator *allocator = iterator.next(); allocator; allocator = iterator.next()) {
+                while (allocator->held_lock.exchange(1)) os::Thread::static_sleep(0);
+                for (uint32 index = 0; index < allocator->held.size(); index++) {
+                    auto *held = static_cast<MarkSweepPointer *>(allocator->held.at(index));
+                    if (target.trace(held, epoch)) this->stack.push(held);
+                    if (held->written) this->rescans.push(held);
+                }
+                allocator->held_lock.store(0);
+            }
+        }
+        // The rescans wait for the holders to release the objects, thus no lock is held here.
+        while (!this->rescans.is_empty())
+            this->scan(static_cast<MarkSweepPointer *>(this->rescans.pop()), epoch, true);
+    }
+
+    void mark(uint32 epoch) {
+        MarkSweepHeap &target = this->heap;
+        while (true) {
+            this->drain(epoch);
+            {
+                os::CriticalSection _(target.barrier_m);
+                target.barrier_stack.transfer(this->stack);
+            }
+            if (!this->stack.is_empty()) continue;
+
+            this->shade_held(epoch);
+            this->drain(epoch);
+
+            os::CriticalSection _(target.barrier_m);
+            if (target.barrier_stack.is_empty()) {
+                // The barriers observe the termination atomically with the barrier stack, thus no shaded object is
+                // left unscanned.
+                target.marking.store(false);
+                // A minor marking does not mark the old objects, thus the sweeping is still bound to the last full
+                // marking.
+                if (target.minor.load()) target.minor.store(false);
+                else target.marked_epoch.store(epoch);
+                return;
+            }
+            target.barrier_stack.transfer(this->stack);
+        }
+    }
+
+    void sweep(uint32 epoch) {
+        MarkSweepHeap &target = this->heap;
+        uint32 threshold = epoch << 1;
+
+        for (MarkSweepClass &size_class: target.classes) {
+            os::CriticalSection _(size_class.class_m);
+            for (MarkSweepBlock **list: {&size_class.available, &size_class.exhausted}) {
+                while (*list) {
+                    MarkSweepBlock *block = *list;
+                    *list = block->next;
+                    block->next = size_class.unswept;
+                    size_class.unswept = block;
+                }
+            }
+        }
+
+        MarkSweepPointer *dead = nullptr;
+        MarkSweepLarge *dead_large = nullptr;
+        {
+            os::CriticalSection _(target.large_m);
+            MarkSweepLarge **link = &target.large_objects;
+            while (*link) {
+                MarkSweepLarge *large = *link;
+                if (large->owner->mark.load() >= threshold || large->owner->pins.load()) {
+                    link = &large->next;
+                    continue;
+                }
+                *link = large->next;
+                large->next = dead_large;
+                dead_large = large;
+            }
+        }
+        while (dead_large) {
+            MarkSweepLarge *large = dead_large;
+            dead_large = large->next;
+            HeapUnmapRequest unmap_request(large->owner->address, large->size);
+            heap_unmap(target.management, unmap_request);
+            large->owner->next_free = dead;
+            dead = large->owner;
+            delete large;
+        }
+        MarkSweepChunk **link = &target.pinned_chunks;
+        while (*link) {
+            MarkSweepChunk *chunk = *link;
+            while (!chunk->objects.is_empty()) {
+                auto *object = static_cast<MarkSweepPointer *>(chunk->objects.pop());
+                if (object->mark.load() >= threshold || object->pins.load()) {
+                    this->survivors.push(object);
+                    continue;
+                }
+                object->next_free = dead;
+                dead = object;
+            }
+            chunk->pinned_count = this->survivors.size();
+            this->survivors.transfer(chunk->objects);
+            if (chunk->pinned_count) {
+                link = &chunk->next;
+                continue;
+            }
+            *link = chunk->next;
+            target.clean(chunk->base, chunk->size);
+            HeapUnmapRequest unmap_request(chunk->base, chunk->size);
+            heap_unmap(target.management, unmap_request);
+            delete chunk;
+        }
+        target.free_pointer_list(dead);
+
+        // The remaining blocks are swept in the background, racing with the allocators sweeping on demand.
+        for (uint32 class_index = 0; class_index < MarkSweepAllocator::SIZE_CLASS_COUNT; class_index++) {
+            MarkSweepClass &size_class = target.classes[class_index];
+            while (!target.terminating.load()) {
+                MarkSweepBlock *empty = nullptr;
+                MarkSweepBlock *sparse = nullptr;
+                {
+                    os::CriticalSection _(size_class.class_m);
+                    MarkSweepBlock *block = size_class.unswept;
+                    if (!block) break;
+                    size_class.unswept = block->next;
+                    target.sweep(block, epoch);
+                    if (block->live_count == 0) {
+                        empty = block;
+                    } else if (target.is_sparse(*block)) {
+                        // The block is detached from the lists while evacuated, thus no allocator can take it.
+                        sparse = block;
+                    } else {
+                        MarkSweepBlock **list = block->has_free_cell() ? &size_class.available :
+                                                &size_class.exhausted;
+                        block->next = *list;
+                        *list = block;
+                    }
+                }
+                if (sparse) {
+                    this->evacuate(*sparse, epoch);
+                    if (sparse->live_count == 0) {
+                        empty = sparse;
+                    } else {
+                        // The pinned objects are left in place.
+                        os::CriticalSection _(size_class.class_m);
+                        sparse->next = size_class.available;
+                        size_class.available = sparse;
+                    }
+                }
+                if (empty) {
+                    HeapUnmapRequest unmap_request(empty->base, MarkSweepAllocator::BLOCK_SIZE);
+                    heap_unmap(target.management, unmap_request);
+                    delete empty;
+                }
+            }
+            this->retire_destination(class_index);
+        }
+    }
+
+    /// \return The block the objects of the \a size_class are evacuated into, or \c nullptr if no block can be mapped.
+    MarkSweepBlock *destination_of(uint32 size_class, uint32 epoch) {
+        MarkSweepBlock *destination = this->destinations[size_class];
+        if (destination && destination->has_free_cell()) return destination;
+        this->retire_destination(size_class);
+
+        MarkSweepClass &target = this->heap.classes[size_class];
+        {
+            os::CriticalSection _(target.class_m);
+            if (target.available) {
+                destination = target.available;
+                target.available = destination->next;
+                this->destinations[size_class] = destination;
+                return destination;
+            }
+        }
+        HeapMapRequest map_request(MarkSweepAllocator::BLOCK_SIZE);
+        heap_map(this->heap.management, map_request);
+        if (!map_request.is_ok()) return nullptr;
+        destination = new MarkSweepBlock(map_request.get_address(), size_class, epoch);
+        this->destinations[size_class] = destination;
+        return destination;
+    }
+
+    /// Return the destination block of the \a size_class to the lists of the size class.
+    void retire_destination(uint32 size_class) {
+        MarkSweepBlock *destination = this->destinations[size_class];
+        if (!destination) return;
+        this->destinations[size_class] = nullptr;
+        MarkSweepClass &target = this->heap.classes[size_class];
+        os::CriticalSection _(target.class_m);
+        MarkSweepBlock **list = destination->has_free_cell() ? &target.available : &target.exhausted;
+        destination->next = *list;
+        *list = destination;
+    }
+
+    /// Relocate the live objects of the swept \a block into the destination blocks of its size class, the objects
+    /// which are acquired or reserved are left in place.
+    void evacuate(MarkSweepBlock &block, uint32 epoch) {
+        for (uint32 index = 0; index < block.bump_index; index++) {
+            MarkSweepPointer *owner = block.owners[index];
+            if (!owner || owner->pins.load()) continue;
+            MarkSweepBlock *destination = this->destination_of(block.size_class, epoch);
+            if (!destination) return;
+
+            // The holders read the address only after acquiring the pointer, thus the object is relocated while the
+            // collector holds the pointer.
+            this->client.wait(*owner);
+            if (!owner->pins.load()) {
+                uint32 cell = destination->take_cell();
+                uint8 *address = destination->base + cell * destination->cell_size;
+                memcpy(address, owner->address, block.cell_size);
+                owner->address = address;
+                destination->owners[cell] = owner;
+                destination->live_count++;
+                block.free_cell(index);
+                // The references of the object to the nursery chunks are remembered conservatively.
+                if (this->heap.cards) this->heap.dirty(address);
+            }
+            this->client.exit(*owner);
+        }
+    }
+};
+
+MarkSweepParams::MarkSweepParams(ReferenceScanner *scanner, uint32 trigger_percent, uint64 min_trigger_size,
+                                 uint32 compact_percent, uint32 nursery_size, uint64 minor_trigger_size,
+                                 ParallelMarker *marker) :
+        scanner(scanner), trigger_percent(trigger_percent), min_trigger_size(min_trigger_size),
+        compact_percent(compact_percent), nursery_size(nursery_size), minor_trigger_size(minor_trigger_size),
+        marker(marker) {}
+
+MarkSweepPointer::MarkSweepPointer(uint32 size, uint8 *address, uint32 capacity, uint32 mark, uint8 generation) :
+        Pointer(size), address(address), capacity(capacity), mark(mark), pins(0), hold_depth(0), written(false),
+        reserved(false), generation(generation), next_free(nullptr) {}
+
+/// Reconstruct a \a pointer which is no longer referenced for a new object, the lock of the pointer is biased towards
+/// the \a client of the allocating thread.
+static MarkSweepPointer *renew(MarkSweepPointer *pointer, veil::threading::ThinLockClient &client, uint32 size,
+                               uint8 *address, uint32 capacity, uint32 mark,
+                               uint8 generation = MarkSweepPointer::GEN_OLD) {
+    pointer->~MarkSweepPointer();
+    new(pointer) MarkSweepPointer(size, address, capacity, mark, generation);
+    pointer->bias(client);
+    return pointer;
+}
+
+static std::string mark_sweep_algorithm_name = "mark-sweep";
+
+MarkSweepAlgorithm::MarkSweepAlgorithm() : Algorithm(mark_sweep_algorithm_name) {}
+
+void MarkSweepAlgorithm::initialize(AlgorithmInitRequest &request) {
+    auto *params = static_cast<MarkSweepParams *>(request.algorithm_params);
+    if (!params || !params->scanner) {
+        vm::RequestExecutor::set_error(request, memory::ERR_ALGO_INIT);
+        return;
+    }
+    // A nursery chunk must fit any object of the size classes.
+    if (params->nursery_size && params->nursery_size < MarkSweepAllocator::MAX_CELL_SIZE) {
+        vm::RequestExecutor::set_error(request, memory::ERR_ALGO_INIT);
+        return;
+    }
+
+    auto *heap = new MarkSweepHeap(*request.management, collection_statistics(*request.management), *params);
+    if (heap->nursery_size) {
+        // The card table covers the whole heap range, its pages are only committed once the cards are dirtied.
+        uint32 error = 0;
+        heap->card_count = (request.management->MAX_HEAP_SIZE >> CARD_SHIFT) + 1;
+        heap->cards = static_cast<uint8 *>(os::mmap(nullptr, heap->card_count, true, false, false, false, error));
+        if (error) {
+            delete heap;
+            vm::RequestExecutor::set_error(request, memory::ERR_ALGO_INIT);
+            return;
+        }
+    }
+    heap->collector = new Collector(*heap);
+    heap->collector_thread.start(*heap->collector);
+    set_structure(*request.management, heap);
+}
+
+void MarkSweepAlgorithm::terminate(Management &management, vm::Request &request) {
+    auto *heap = static_cast<MarkSweepHeap *>(get_structure(management));
+    if (!heap) return;
+
+    heap->terminating.store(true);
+    heap->collector_cv.notify();
+    heap->collector_thread.join();
+    delete static_cast<Collector *>(heap->collector);
+
+    auto unmap_block = [&management](MarkSweepBlock *block) {
+        HeapUnmapRequest unmap_request(block->base, MarkSweepAllocator::BLOCK_SIZE);
+        heap_unmap(management, unmap_request);
+        delete block;
+    };
+    auto unmap_chunk = [&management](MarkSweepChunk *chunk) {
+        HeapUnmapRequest unmap_request(chunk->base, chunk->size);
+        heap_unmap(management, unmap_request);
+        delete chunk;
+    };
+
+    TArenaIterator<MarkSweepAllocator> iterator(heap->allocators);
+    for (MarkSweepAllocator *allocator = iterator.next(); allocator; allocator = iterator.next()) {
+        for (MarkSweepBlock *block: allocator->blocks) if (block) unmap_block(block);
+        if (allocator->nursery) unmap_chunk(allocator->nursery);
+        allocator->~MarkSweepAllocator();
+    }
+    heap->allocators.free();
+    for (MarkSweepChunk *list: {heap->filled_chunks, heap->free_chunks, heap->pinned_chunks}) {
+        while (list) {
+            MarkSweepChunk *chunk = list;
+            list = chunk->next;
+            unmap_chunk(chunk);
+        }
+    }
+
+    for (MarkSweepClass &size_class: heap->classes) {
+        for (MarkSweepBlock *list: {size_class.unswept, size_class.available, size_class.exhausted}) {
+            while (list) {
+                MarkSweepBlock *block = list;
+                list = block->next;
+                unmap_block(block);
+            }
+        }
+    }
+    while (heap->large_objects) {
+        MarkSweepLarge *large = heap->large_objects;
+        heap->large_objects = large->next;
+        HeapUnmapRequest unmap_request(large->owner->address, large->size);
+        heap_unmap(management, unmap_request);
+        delete large;
+    }
+    heap->pointers.destruct_objects();
+    heap->pointers.free();
+    if (heap->cards) {
+        uint32 error = 0;
+        os::munmap(const_cast<uint8 *>(heap->cards), heap->card_count, error);
+    }
+
+    delete heap;
+    set_structure(management, nullptr);
+}
+
+uint64 MarkSweepAlgorithm::max_supported_heap_size() { return MAX_SUPPORTED_HEAP_SIZE; }
+
+Allocator *MarkSweepAlgorithm::create_allocator(Management &management, vm::Request &request) {
+    auto *heap = static_cast<MarkSweepHeap *>(get_structure(management));
+    os::CriticalSection _(heap->allocators_m);
+    // The class specific operator new of Allocator is deleted, thus the global placement new is used explicitly.
+    return ::new(heap->allocators.allocate()) MarkSweepAllocator(management, *heap);
+}
+
+MarkSweepAllocator::MarkSweepAllocator(Management &management, MarkSweepHeap &heap) :
+        TracingAllocator(management), heap(&heap), blocks(), nursery(nullptr), cached_pointers(nullptr),
+        cached_count(0), reserved(), unflushed_size(0) {}
+
+MarkSweepAllocator::~MarkSweepAllocator() = default;
+
+uint32 MarkSweepAllocator::size_class_of(uint64 size) {
+    if (size <= SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT) return size ? (size - 1) / SIZE_CLASS_GRANULE : 0;
+    if (size > MAX_CELL_SIZE) return SIZE_CLASS_COUNT;
+
+    uint32 size_class = SMALL_CLASS_COUNT;
+    uint64 capacity = SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT * 2;
+    while (capacity < size) {
+        capacity <<= 1;
+        size_class++;
+    }
+    return size_class;
+}
+
+uint32 MarkSweepAllocator::cell_size_of(uint32 size_class) {
+    if (size_class < SMALL_CLASS_COUNT) return (size_class + 1) * SIZE_CLASS_GRANULE;
+    return SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT << (size_class - SMALL_CLASS_COUNT + 1);
+}
+
+MarkSweepPointer *MarkSweepAllocator::take_pointer() {
+    if (!this->cached_pointers) {
+        os::CriticalSection _(this->heap->pointer_m);
+        for (uint32 index = 0; index < POINTER_CACHE_CAPACITY; index++) {
+            MarkSweepPointer *pointer = this->heap->free_pointers;
+            if (pointer) this->heap->free_pointers = pointer->next_free;
+            else pointer = new(this->heap->pointers.allocate()) MarkSweepPointer(0, nullptr, 0, 0);
+            pointer->next_free = this->cached_pointers;
+            this->cached_pointers = pointer;
+        }
+        this->cached_count = POINTER_CACHE_CAPACITY;
+    }
+    MarkSweepPointer *pointer = this->cached_pointers;
+    this->cached_pointers = pointer->next_free;
+    this->cached_count--;
+    return pointer;
+}
+
+bool MarkSweepAllocator::refill(uint32 size_class, vm::Request &request) {
+    MarkSweepClass &target = this->heap->classes[size_class];
+    MarkSweepBlock *retired = this->blocks[size_class];
+    this->blocks[size_class] = nullptr;
+
+    {
+        os::CriticalSection _(target.class_m);
+        if (retired) {
+            // A block retired after a marking terminated might contain dead objects.
+            MarkSweepBlock **list = retired->swept_epoch != this->heap->marked_epoch.load() ? &target.unswept :
+                                    &target.exhausted;
+            retired->next = *list;
+            *list = retired;
+        }
+        if (target.available) {
+            this->blocks[size_class] = target.available;
+            target.available = target.available->next;
+            return true;
+        }
+        while (target.unswept) {
+            MarkSweepBlock *block = target.unswept;
+            target.unswept = block->next;
+            this->heap->sweep(block, this->heap->marked_epoch.load());
+            if (block->has_free_cell()) {
+                this->blocks[size_class] = block;
+                return true;
+            }
+            block->next = target.exhausted;
+            target.exhausted = block;
+        }
+    }
+
+    HeapMapRequest map_request(BLOCK_SIZE);
+    this->heap_map(map_request);
+    if (!map_request.is_ok()) {
+        vm::RequestExecutor::set_error(request, map_request.get_error());
+        return false;
+    }
+    this->blocks[size_class] = new MarkSweepBlock(map_request.get_address(), size_class,
+                                                  this->heap->marked_epoch.load());
+    return true;
+}
+
+uint8 *MarkSweepAllocator::allocate_large(uint64 capacity, vm::Request &request) {
+    HeapMapRequest map_request(capacity);
+    this->heap_map(map_request);
+    if (!map_request.is_ok()) {
+        vm::RequestExecutor::set_error(request, map_request.get_error());
+        return nullptr;
+    }
+    return map_request.get_address();
+}
+
+void MarkSweepAllocator::account(uint64 size) {
+    this->unflushed_size += size;
+    if (this->unflushed_size < ACCOUNT_THRESHOLD) return;
+    uint64 allocated = this->heap->allocated_size.fetch_add(this->unflushed_size);
+    this->unflushed_size = 0;
+    if (allocated >= this->heap->trigger_size()) this->heap->collector_cv.notify();
+}
+
+Pointer *MarkSweepAllocator::allocate(AllocateRequest &request) {
+    if (request.size > UINT32_MAX) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_POINTER_SIZE);
+        return nullptr;
+    }
+    auto size = static_cast<uint32>(request.size);
+    uint32 size_class = size_class_of(size);
+
+    MarkSweepPointer **link = &this->reserved[size_class];
+    while (*link && (*link)->capacity < size) link = &(*link)->next_free;
+    if (*link) {
+        MarkSweepPointer *recycled = *link;
+        *link = recycled->next_free;
+        // The sweeping of the size class is excluded while the pointer is reconstructed, as the sweeper reads the
+        // mark and the pins of the pointer.
+        os::Mutex &sweep_m = size_class < SIZE_CLASS_COUNT ? this->heap->classes[size_class].class_m :
+                             this->heap->large_m;
+        os::CriticalSection _(sweep_m);
+        memset(recycled->address, 0, recycled->capacity);
+        this->statistics.record_allocation(recycled->capacity);
+        return renew(recycled, this->client, size, recycled->address, recycled->capacity,
+                     this->heap->allocation_mark(), recycled->generation);
+    }
+    if (this->heap->cards && size_class < SIZE_CLASS_COUNT) return this->allocate_young(size, request);
+
+    if (size_class == SIZE_CLASS_COUNT) {
+        uint64 capacity = (static_cast<uint64>(size) + SIZE_CLASS_GRANULE - 1) / SIZE_CLASS_GRANULE *
+                          SIZE_CLASS_GRANULE;
+        if (capacity > UINT32_MAX) {
+            vm::RequestExecutor::set_error(request, memory::ERR_INV_POINTER_SIZE);
+            return nullptr;
+        }
+        uint8 *address = this->allocate_large(capacity, request);
+        if (!address) return nullptr;
+        MarkSweepPointer *pointer = renew(this->take_pointer(), this->client, size, address,
+                                          static_cast<uint32>(capacity), this->heap->allocation_mark());
+        {
+            os::CriticalSection _(this->heap->large_m);
+            this->heap->large_objects = new MarkSweepLarge(pointer, capacity, this->heap->large_objects);
+        }
+        this->account(capacity);
+        this->statistics.record_allocation(capacity);
+        return pointer;
+    }
+
+    MarkSweepBlock *block = this->blocks[size_class];
+    if (!block || !block->has_free_cell()) {
+        if (!this->refill(size_class, request)) return nullptr;
+        block = this->blocks[size_class];
+    }
+    uint32 index = block->take_cell();
+    // The object might be scanned by the barrier before its holder initializes it, thus it must not contain any stale
+    // references; the sections of the large objects are freshly mapped thus already zeroed.
+    memset(block->base + index * block->cell_size, 0, block->cell_size);
+    MarkSweepPointer *pointer = renew(this->take_pointer(), this->client, size,
+                                      block->base + index * block->cell_size, block->cell_size,
+                                      this->heap->allocation_mark());
+    block->owners[index] = pointer;
+    block->live_count++;
+    this->account(block->cell_size);
+    this->statistics.record_allocation(block->cell_size);
+    return pointer;
+}
+
+Pointer *MarkSweepAllocator::allocate_young(uint32 size, vm::Request &request) {
+    MarkSweepHeap *target = this->heap;
+    uint32 capacity = size ? (size + NURSERY_ALIGNMENT - 1) / NURSERY_ALIGNMENT * NURSERY_ALIGNMENT :
+                      NURSERY_ALIGNMENT;
+    // The collector seizes the chunk being filled only while the lock is held.
+    while (this->nursery_lock.exchange(1)) os::Thread::static_sleep(0);
+    MarkSweepChunk *chunk = this->nursery;
+    if (!chunk || chunk->size - chunk->bump < capacity) {
+        this->nursery = nullptr;
+        bool triggered = false;
+        {
+            os::CriticalSection _(target->nursery_m);
+            if (chunk) {
+                chunk->next = target->filled_chunks;
+                target->filled_chunks = chunk;
+                triggered = target->filled_size.fetch_add(chunk->bump) >= target->minor_trigger_size;
+            }
+            chunk = target->free_chunks;
+            if (chunk) {
+                target->free_chunks = chunk->next;
+                target->free_chunk_count--;
+                chunk->next = nullptr;
+            }
+        }
+        if (triggered) target->collector_cv.notify();
+        if (!chunk) {
+            HeapMapRequest map_request(target->nursery_size);
+            this->heap_map(map_request);
+            if (!map_request.is_ok()) {
+                this->nursery_lock.store(0);
+                vm::RequestExecutor::set_error(request, map_request.get_error());
+                return nullptr;
+            }
+            chunk = new MarkSweepChunk(map_request.get_address(), target->nursery_size);
+        }
+        this->nursery = chunk;
+    }
+    uint8 *address = chunk->base + chunk->bump;
+    chunk->bump += capacity;
+    memset(address, 0, capacity);
+    MarkSweepPointer *pointer = renew(this->take_pointer(), this->client, size, address, capacity,
+                                      target->allocation_mark(), MarkSweepPointer::GEN_NURSERY);
+    chunk->objects.push(pointer);
+    this->nursery_lock.store(0);
+    this->statistics.record_allocation(capacity);
+    return pointer;
+}
+
+void MarkSweepAllocator::reserve(PointerActionRequest &request) {
+    auto *pointer = static_cast<MarkSweepPointer *>(request.pointer);
+    (void) pointer->pins.fetch_add(1);
+    pointer->reserved = true;
+    MarkSweepPointer **stack = &this->reserved[size_class_of(pointer->capacity)];
+    pointer->next_free = *stack;
+    *stack = pointer;
+    this->statistics.record_free(pointer->capacity);
+}
+
+void MarkSweepAllocator::scan_barrier(MarkSweepPointer *object) {
+    ReferenceCollector collector(this->barrier_buffer);
+    this->heap->scanner->scan(*object, object->address, collector);
+}
+
+void MarkSweepAllocator::flush_barrier(Pointer *const *blackened, uint32 count) {
+    os::CriticalSection _(this->heap->barrier_m);
+    if (this->heap->marking.load()) {
+        uint32 epoch = this->heap->epoch.load();
+        while (!this->barrier_buffer.is_empty()) {
+            auto *reference = static_cast<MarkSweepPointer *>(this->barrier_buffer.pop());
+            if (this->heap->trace(reference, epoch)) this->heap->barrier_stack.push(reference);
+        }
+        uint32 black = (epoch << 1) | 1;
+        for (uint32 index = 0; index < count; index++) {
+            auto *object = static_cast<MarkSweepPointer *>(blackened[index]);
+            if (object->mark.load() != black) {
+                object->mark.store(black);
+                (void) this->heap->marked_size.fetch_add(object->capacity);
+            }
+        }
+    }
+    // The references are discarded if the marking is terminated.
+    while (this->barrier_buffer.pop());
+}
+
+void MarkSweepAllocator::acquire(PointerAcquireRequest &request) {
+    // The pointer is constant to the caller, while the lock embedded within the pointer is mutable.
+    auto *pointer = static_cast<MarkSweepPointer *>(const_cast<Pointer *>(request.pointer));
+    (void) pointer->pins.fetch_add(1);
+    this->client.wait(*pointer);
+    pointer->hold_depth++;
+
+    while (this->held_lock.exchange(1)) os::Thread::static_sleep(0);
+    if (request.exclusive) pointer->written = true;
+    this->held.push(pointer);
+    this->held_lock.store(0);
+
+    if (request.exclusive && this->heap->marking.load()) {
+        uint32 black = (this->heap->epoch.load() << 1) | 1;
+        // The snapshot of the references is preserved before the holder modifies the object.
+        if (pointer->mark.load() != black) {
+            this->scan_barrier(pointer);
+            Pointer *blackened = pointer;
+            this->flush_barrier(&blackened, 1);
+        }
+    }
+    set_address(request, pointer->address);
+}
+
+void MarkSweepAllocator::release(PointerActionRequest &request) {
+    auto *pointer = static_cast<MarkSweepPointer *>(request.pointer);
+    bool last = --pointer->hold_depth == 0;
+    bool written = last && pointer->written;
+    // The references stored into the object during the marking are shaded before the object is released.
+    if (written && this->heap->marking.load()) {
+        this->scan_barrier(pointer);
+        this->flush_barrier(nullptr, 0);
+    }
+
+    while (this->held_lock.exchange(1)) os::Thread::static_sleep(0);
+    if (last) pointer->written = false;
+    this->held.remove(pointer);
+    this->held_lock.store(0);
+
+    // The object might store references to the young objects, it is remembered until the next minor collection.
+    if (written && this->heap->cards) this->heap->dirty(pointer->address);
+    this->client.exit(*pointer);
+    (void) pointer->pins.fetch_sub(1);
+}
+
+void MarkSweepAllocator::acquire_batch(PointerBatchAcquireRequest &request) {
+    for (uint32 index = 0; index < request.count; index++) {
+        auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index]);
+        (void) pointer->pins.fetch_add(1);
+        this->client.wait(*pointer);
+        pointer->hold_depth++;
+    }
+
+    while (this->held_lock.exchange(1)) os::Thread::static_sleep(0);
+    for (uint32 index = 0; index < request.count; index++) {
+        auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index]);
+        if (request.exclusive) pointer->written = true;
+        this->held.push(pointer);
+    }
+    this->held_lock.store(0);
+
+    if (request.exclusive && this->heap->marking.load()) {
+        uint32 black = (this->heap->epoch.load() << 1) | 1;
+        for (uint32 index = 0; index < request.count; index++) {
+            auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index]);
+            if (pointer->mark.load() != black) this->scan_barrier(pointer);
+        }
+        // The references of the whole group are shaded within a single critical section of the barrier.
+        this->flush_barrier(request.pointers, request.count);
+    }
+    for (uint32 index = 0; index < request.count; index++)
+        set_address(request, index, static_cast<MarkSweepPointer *>(request.pointers[index])->address);
+}
+
+void MarkSweepAllocator::release_batch(PointerBatchReleaseRequest &request) {
+    bool marking = this->heap->marking.load();
+    bool scanned = false;
+    for (uint32 index = request.count; index > 0; index--) {
+        auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index - 1]);
+        // The references stored into the object during the marking are shaded before the object is released.
+        if (--pointer->hold_depth == 0 && pointer->written && marking) {
+            this->scan_barrier(pointer);
+            scanned = true;
+        }
+    }
+    if (scanned) this->flush_barrier(nullptr, 0);
+
+    while (this->held_lock.exchange(1)) os::Thread::static_sleep(0);
+    for (uint32 index = request.count; index > 0; index--) {
+        auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index - 1]);
+        // A pointer occurring more than once within the group is only last released by its first occurrence here.
+        if (!pointer->hold_depth && pointer->written) {
+            pointer->written = false;
+            if (this->heap->cards) this->heap->dirty(pointer->address);
+        }
+        this->held.remove(pointer);
+    }
+    this->held_lock.store(0);
+
+    for (uint32 index = request.count; index > 0; index--) {
+        auto *pointer = static_cast<MarkSweepPointer *>(request.pointers[index - 1]);
+        this->client.exit(*pointer);
+        (void) pointer->pins.fetch_sub(1);
+    }
+}
+
+void MarkSweepAllocator::add_root(PointerActionRequest &request) {
+    auto *pointer = static_cast<MarkSweepPointer *>(request.pointer);
+    {
+        os::CriticalSection _(this->heap->roots_m);
+        this->heap->roots.push(pointer);
+    }
+    // A root registered during the marking is not within the snapshot of the roots.
+    os::CriticalSection _(this->heap->barrier_m);
+    if (this->heap->marking.load() && this->heap->trace(pointer, this->heap->epoch.load()))
+        this->heap->barrier_stack.push(pointer);
+}
+
+void MarkSweepAllocator::remove_root(PointerActionRequest &request) {
+    os::CriticalSection _(this->heap->roots_m);
+    this->heap->roots.remove(request.pointer);
+}
+
+void MarkSweepAllocator::collect(vm::Request &request) {
+    MarkSweepHeap *target = this->heap;
+    // The collection in progress might be started before the request, thus the subsequent one is waited.
+    uint32 cycle = target->started_cycles.load() + 1;
+    uint32 requested = target->requested_cycles.load();
+    while (requested < cycle) {
+        uint32 witnessed = target->requested_cycles.compare_exchange(requested, cycle);
+        if (witnessed == requested) break;
+        requested = witnessed;
+    }
+    target->collector_cv.notify();
+    while (target->completed_cycles.load() < cycle) target->completion_cv.wait_for(POLL_INTERVAL);
+}
+
+void MarkSweepAllocator::snapshot(HeapSnapshotRequest &request) {
+    MarkSweepHeap *target = this->heap;
+    HeapSnapshotWriter writer;
+    if (!writer.open(request.path)) {
+        vm::RequestExecutor::set_error(request, memory::ERR_SNAPSHOT_IO);
+        return;
+    }
+
+    // No object is reclaimed or relocated by the collector while the collections are held off, and an object which
+    // is reachable is either marked by the last marking or allocated after it, thus it is not reclaimed by the lazy
+    // sweeping of the allocators either.
+    os::CriticalSection _(target->collection_m);
+    PointerSet visited;
+    PointerStack pending;
+    // The pointers held by the other allocators are not waited for, as their holders might be waiting for a collection
+    // held off by this snapshot.
+    PointerSet foreign;
+    {
+        os::CriticalSection _(target->roots_m);
+        for (uint32 index = 0; index < target->roots.size(); index++) {
+            Pointer *root = target->roots.at(index);
+            writer.write_root(root);
+            if (visited.insert(root)) pending.push(root);
+        }
+    }
+    {
+        os::CriticalSection _(target->allocators_m);
+        TArenaIterator<MarkSweepAllocator> iterator(target->allocators);
+        for (MarkSweepAllocator *allocator = iterator.next(); allocator; allocator = iterator.next()) {
+            while (allocator->held_lock.exchange(1)) os::Thread::static_sleep(0);
+            for (uint32 index = 0; index < allocator->held.size(); index++) {
+                Pointer *held = allocator->held.at(index);
+                writer.write_root(held);
+                if (visited.insert(held)) pending.push(held);
+                if (allocator != this) foreign.insert(held);
+            }
+            allocator->held_lock.store(0);
+        }
+    }
+
+    uint64 skipped_count = 0;
+    while (!pending.is_empty()) {
+        auto *object = static_cast<MarkSweepPointer *>(pending.pop());
+        bool held = this->held.contains(object);
+        if (!held && foreign.contains(object)) {
+            writer.write_object(object, object->capacity);
+            skipped_count++;
+            continue;
+        }
+        if (!held) this->client.wait(*object);
+        writer.write_object(object, object->capacity);
+        SnapshotRecorder recorder(writer, visited, pending);
+        target->scanner->scan(*object, object->address, recorder);
+        if (!held) this->client.exit(*object);
+    }
+    set_skipped_count(request, skipped_count);
+    if (!writer.close()) vm::RequestExecutor::set_error(request, memory::ERR_SNAPSHOT_IO);
+}
@@ -0,0 +1,278 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_MARK_SWEEP_HPP
+#define VEIL_FABRIC_SRC_MEMORY_MARK_SWEEP_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/memory/parallel-marker.hpp"
+#include "src/memory/tracing.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/threading/thin-lock.hpp"
+
+namespace veil::memory {
+
+    /// The parameters of \c MarkSweepAlgorithm, passed with \c MemoryInitRequest::algorithm_params.
+    struct MarkSweepParams {
+        /// The scanner of the references of the VM objects, must not be \c nullptr.
+        ReferenceScanner *scanner;
+        /// A collection is triggered once the size allocated since the last collection exceeds this percentage of the
+        /// live size of the last collection.
+        uint32 trigger_percent;
+        /// The minimum size allocated since the last collection to trigger a collection.
+        uint64 min_trigger_size;
+        /// A block whose live cells are below this percentage after sweeping is evacuated, 0 disables the compaction.
+        uint32 compact_percent;
+        /// The byte size of the nursery chunk of each allocator, 0 disables the generations; must not be smaller than
+        /// \c MarkSweepAllocator::MAX_CELL_SIZE otherwise.
+        uint32 nursery_size;
+        /// A minor collection is triggered once the size of the filled nursery chunks exceeds this size.
+        uint64 minor_trigger_size;
+        /// The marker tracing the heap in parallel, \c nullptr to trace on the collector thread alone; the marker
+        /// must be started by the embedder and outlive the memory management.
+        ParallelMarker *marker;
+
+        /// \param scanner            The scanner of the references of the VM objects.
+        /// \param trigger_percent    The percentage of the live size allocated to trigger a collection.
+        /// \param min_trigger_size   The minimum size allocated to trigger a collection.
+        /// \param compact_percent    The percentage of the live cells below which a block is evacuated.
+        /// \param nursery_size       The byte size of the nursery chunk of each allocator.
+        /// \param minor_trigger_size The size of the filled nursery chunks to trigger a minor collection.
+        /// \param marker             The marker tracing the heap in parallel.
+        explicit MarkSweepParams(ReferenceScanner *scanner, uint32 trigger_percent = 100,
+                                 uint64 min_trigger_size = 8 * 1024 * 1024, uint32 compact_percent = 0,
+                                 uint32 nursery_size = 0, uint64 minor_trigger_size = 4 * 1024 * 1024,
+                                 ParallelMarker *marker = nullptr);
+    };
+
+    /// The \c Pointer of \c MarkSweepAlgorithm, the pointer is a handle to its object stored within a cell of a size
+    /// class block (or a dedicated section for large objects), the handle is reclaimed together with the object.
+    struct MarkSweepPointer : public Pointer, public threading::ThinLock, public ArenaObject {
+        /// The object is allocated in the old space.
+        static const uint8 GEN_OLD = 0;
+        /// The object is allocated in a nursery chunk.
+        static const uint8 GEN_NURSERY = 1;
+        /// The object is allocated in a nursery chunk collected by the minor collection in progress.
+        static const uint8 GEN_CONDEMNED = 2;
+
+        /// The address of the object, which might be changed by the compaction while the pointer is not acquired.
+        uint8 *address;
+        /// The byte size of the cell of the object, which is changed once the object is promoted.
+        uint32 capacity;
+        /// The mark of the object, which is (epoch << 1) for an object shaded gray in the collection of the epoch, and
+        /// ((epoch << 1) | 1) for an object which is scanned (black) or allocated during the collection.
+        os::atomic_u32_t mark;
+        /// The number of threads acquiring (or reserving) the pointer, a pinned object is never reclaimed.
+        os::atomic_u32_t pins;
+        /// The depth of the nested acquisitions of the holder, only modified by the holder.
+        uint32 hold_depth;
+        /// Whether the object is acquired exclusively by the holder, the object is rescanned on its last release if
+        /// the marking is in progress.
+        bool written;
+        /// Whether the pointer is reserved by \c Allocator::reserve.
+        bool reserved;
+        /// The generation of the object, modified by the collector only.
+        uint8 generation;
+        /// The next pointer of the free stack or the reserved stack.
+        MarkSweepPointer *next_free;
+
+        MarkSweepPointer(uint32 size, uint8 *address, uint32 capacity, uint32 mark, uint8 generation = GEN_OLD);
+    };
+
+    /// The heap wide structure of \c MarkSweepAlgorithm stored within \c Management::structure.
+    class MarkSweepHeap;
+
+    /// A block of the cells of a size class.
+    struct MarkSweepBlock;
+
+    /// A nursery chunk of an allocator.
+    struct MarkSweepChunk;
+
+    /// A concurrent mark-sweep memory management algorithm, the heap is segregated into blocks of size classes where
+    /// each block is owned by at most one allocator at a time.
+    /// <br><br>
+    /// <b>Marking</b>: A dedicated collector thread traces the heap from the registered roots while the VM threads
+    /// keep running, the acquire/release bracket of the pointers is used as the barrier:
+    /// <ul>
+    ///     <li> The objects acquired when the marking terminates are shaded, thus the acquired objects are roots. </li>
+    ///     <li> An object acquired exclusively during the marking is scanned before the acquisition returns, which
+    ///          preserves the snapshot of its references (snapshot-at-the-beginning). </li>
+    ///     <li> An object acquired exclusively is rescanned on its last release if the marking is still in progress,
+    ///          which covers the references stored into the object. </li>
+    ///     <li> The objects allocated during the marking are allocated black. </li>
+    /// </ul>
+    /// The marking terminates once the mark stack and the barrier stack are both drained after the pinned objects are
+    /// shaded, the collector waits for the release of an object which is acquired exclusively before rescanning it.
+    /// <br><br>
+    /// <b>Sweeping</b>: The blocks are swept lazily per size class, an allocator sweeps the blocks of a size class on
+    /// demand when its own block of the class is exhausted, while the collector sweeps the remaining blocks in the
+    /// background and returns the empty blocks to the host.
+    /// <br><br>
+    /// <b>Compaction</b>: If \c MarkSweepParams::compact_percent is set, the collector evacuates the live objects of
+    /// the sparse blocks it sweeps into the denser blocks of the same size class, then returns the evacuated blocks to
+    /// the host. As the address of an object is only exposed between \c Allocator::acquire and \c Allocator::release,
+    /// an object is relocated while the collector holds its pointer, and only \c MarkSweepPointer::address is updated;
+    /// the objects which are acquired or reserved are pinned in place.
+    /// <br><br>
+    /// <b>Generations</b>: If \c MarkSweepParams::nursery_size is set, each allocator bumps the objects into its own
+    /// nursery chunk, the blocks of the size classes form the old space. A minor collection condemns all nursery chunks
+    /// filled so far, and marks only the condemned objects from the roots and the remembered set with the same barrier
+    /// as the full marking; the survivors are then promoted by copying them into the old space, while the pinned
+    /// survivors are promoted in place and keep their chunk. The remembered set is a card table over the heap, a card
+    /// is dirtied by the last release of an exclusive acquisition of an object starting within the card, thus a minor
+    /// collection only scans the old objects of the dirty cards besides the condemned objects.
+    class MarkSweepAlgorithm : public Algorithm {
+    public:
+        /// The maximum supported heap size, which is the size of the user space of a 48-bit virtual address space.
+        static const uint64 MAX_SUPPORTED_HEAP_SIZE = 1ULL << 46;
+
+        MarkSweepAlgorithm();
+
+        void initialize(AlgorithmInitRequest &request) override;
+
+        void terminate(Management &management, vm::Request &request) override;
+
+        uint64 max_supported_heap_size() override;
+
+        Allocator *create_allocator(Management &management, vm::Request &request) override;
+
+    private:
+        /// The routine of the collector thread.
+        class Collector;
+    };
+
+    /// The \c Allocator of \c MarkSweepAlgorithm, the instance must only be used by a single thread.
+    class MarkSweepAllocator : public TracingAllocator, public ArenaObject {
+    public:
+        /// The byte size of a size class block.
+        static const uint32 BLOCK_SIZE = 256 * 1024;
+        /// The byte granularity of the small size classes.
+        static const uint32 SIZE_CLASS_GRANULE = 16;
+        /// The number of small size classes, the capacity of each is a multiple of the granule.
+        static const uint32 SMALL_CLASS_COUNT = 16;
+        /// The number of all size classes, the capacity of the classes beyond the small classes doubles.
+        static const uint32 SIZE_CLASS_COUNT = SMALL_CLASS_COUNT + 6;
+        /// The capacity of the largest size class, larger objects are mapped as dedicated large objects.
+        static const uint32 MAX_CELL_SIZE = SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT << (SIZE_CLASS_COUNT -
+                                                                                      SMALL_CLASS_COUNT);
+        /// The number of pointers cached by an allocator.
+        static const uint32 POINTER_CACHE_CAPACITY = 64;
+        /// The alignment of the objects allocated in the nursery chunks.
+        static const uint32 NURSERY_ALIGNMENT = 16;
+
+        MarkSweepAllocator(Management &management, MarkSweepHeap &heap);
+
+        ~MarkSweepAllocator();
+
+        /// \attention The memory of the allocated object is zeroed, thus a \c ReferenceScanner must treat a zeroed
+        /// object as an object without references.
+        Pointer *allocate(AllocateRequest &request) override;
+
+        /// \attention The reserved pointer and its object are pinned until it is reused by an allocation of the same
+        /// size class of this allocator.
+        void reserve(PointerActionRequest &request) override;
+
+        /// \attention All acquisitions lock the pointer, as the collector must not scan an object concurrently
+        /// modified by the holder; while only an exclusive acquisition performs the snapshot scan of the barrier.
+        void acquire(PointerAcquireRequest &request) override;
+
+        void release(PointerActionRequest &request) override;
+
+        /// \attention The pointers are held by a single acquisition of the held list lock, and the snapshot scans of
+        /// the barrier are shaded within a single critical section of the marking.
+        void acquire_batch(PointerBatchAcquireRequest &request) override;
+
+        /// \attention The barrier scans of the written objects are shaded within a single critical section of the
+        /// marking.
+        void release_batch(PointerBatchReleaseRequest &request) override;
+
+        void add_root(PointerActionRequest &request) override;
+
+        void remove_root(PointerActionRequest &request) override;
+
+        void collect(vm::Request &request) override;
+
+        /// \attention The objects acquired by this allocator are scanned in place, as they are only accessed by the
+        /// calling thread.
+        void snapshot(HeapSnapshotRequest &request) override;
+
+        /// \return The size class of an object of \a size, or \c MarkSweepAllocator::SIZE_CLASS_COUNT if \a size is
+        ///         larger than \c MarkSweepAllocator::MAX_CELL_SIZE.
+        static uint32 size_class_of(uint64 size);
+
+        /// \return The cell size of the size class.
+        static uint32 cell_size_of(uint32 size_class);
+
+    private:
+        /// The heap wide structure of the root management.
+        MarkSweepHeap *heap;
+        /// The blocks owned by this allocator per size class.
+        MarkSweepBlock *blocks[SIZE_CLASS_COUNT];
+        /// The nursery chunk of this allocator, which might be seized by a minor collection.
+        MarkSweepChunk *nursery;
+        /// The spin lock guarding \c MarkSweepAllocator::nursery against the collector.
+        os::atomic_u32_t nursery_lock = os::atomic_u32_t(0);
+        /// The cached pointers for the allocations.
+        MarkSweepPointer *cached_pointers;
+        uint32 cached_count;
+        /// The reserved pointers stacked by their size classes, the last stack holds the large objects.
+        MarkSweepPointer *reserved[SIZE_CLASS_COUNT + 1];
+        /// The size allocated since the last flush to \c MarkSweepHeap, flushed in batches to reduce contention.
+        uint64 unflushed_size;
+        /// The client used to lock the pointers acquired from this allocator, the pointers allocated by this allocator
+        /// are biased towards it.
+        threading::ThinLockClient client;
+        /// The buffer of the references collected by the barrier before they are shaded.
+        PointerStack barrier_buffer;
+        /// The pointers currently acquired by this allocator, which are shaded by the collector when the marking
+        /// terminates.
+        PointerStack held;
+        /// The spin lock guarding \c MarkSweepAllocator::held and \c MarkSweepPointer::written of the held pointers
+        /// against the collector.
+        os::atomic_u32_t held_lock = os::atomic_u32_t(0);
+
+        /// \return A pointer from the cache, refilled from the heap if empty.
+        MarkSweepPointer *take_pointer();
+
+        /// Refill the block of the \a size_class of this allocator.
+        /// \return Whether a block with free cells is owned by this allocator.
+        bool refill(uint32 size_class, vm::Request &request);
+
+        /// Allocate a dedicated section for a large object.
+        uint8 *allocate_large(uint64 capacity, vm::Request &request);
+
+        /// Allocate an object in the nursery chunk of this allocator, the chunk is replaced if it is filled.
+        Pointer *allocate_young(uint32 size, vm::Request &request);
+
+        /// Account the \a size allocated, and wake the collector if the trigger is reached.
+        void account(uint64 size);
+
+        /// Scan the references of the acquired \a object into \c MarkSweepAllocator::barrier_buffer.
+        void scan_barrier(MarkSweepPointer *object);
+
+        /// Shade the references within \c MarkSweepAllocator::barrier_buffer if the marking is in progress, the
+        /// buffer is emptied.
+        /// \param blackened The acquired objects to be marked black along the shading.
+        /// \param count     The number of the objects within \a blackened.
+        void flush_barrier(Pointer *const *blackened, uint32 count);
+
+        friend class MarkSweepAlgorithm;
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_MARK_SWEEP_HPP
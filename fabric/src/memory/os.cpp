@@ -24,8 +24,16 @@
 #elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// The memory policy modes of the mbind syscall, defined in the kernel header linux/mempolicy.h which is not shipped
+// with every toolchain.
+static const int VEIL_MPOL_BIND = 2;
+static const int VEIL_MPOL_INTERLEAVE = 3;
 
 #endif
 
@@ -53,32 +61,255 @@ void veil::os::free(void *address) {
     ::free(address);
 }
 
-void *veil::os::mmap(void *address, uint64 size, bool readwrite, bool reserve, uint32 &error) {
+uint64 veil::os::get_huge_page_size() {
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    return static_cast<uint64>(GetLargePageMinimum());
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (!meminfo) return 0;
+    char line[128];
+    uint64 huge_page_size = 0;
+    while (fgets(line, sizeof(line), meminfo)) {
+        unsigned long long size_kib;
+        if (sscanf(line, "Hugepagesize: %llu kB", &size_kib) == 1) {
+            huge_page_size = static_cast<uint64>(size_kib) * 1024;
+            break;
+        }
+    }
+    fclose(meminfo);
+    return huge_page_size;
+#   endif
+}
+
+void *veil::os::mmap(void *address, uint64 size, bool readwrite, bool reserve, bool huge_pages, bool pre_fault,
+                     uint32 &error) {
     error = veil::ERR_NONE;
     uint8 *allocated_address = nullptr;
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    allocated_address = (uint8 *) VirtualAlloc((LPVOID) nullptr,
+    // Large pages must be reserved and committed at once, and they are always resident in physical memory, thus the
+    // pre-fault option is implied.
+    allocated_address = (uint8 *) VirtualAlloc((LPVOID) address,
                                                (SIZE_T) size,
-                                               (reserve ? MEM_RESERVE | MEM_COMMIT : 0),
-                                               (readwrite ? PAGE_READWRITE : 0));
+                                               MEM_RESERVE | (reserve || huge_pages ? MEM_COMMIT : 0) |
+                                               (huge_pages ? MEM_LARGE_PAGES : 0),
+                                               (readwrite ? PAGE_READWRITE : PAGE_NOACCESS));
     if (!allocated_address) {
         switch ((uint32) GetLastError()) {
         case ERROR_NOT_ENOUGH_MEMORY:
+        case ERROR_NO_SYSTEM_RESOURCES:
             error = ERR_NOMEM;
+            break;
+        case ERROR_PRIVILEGE_NOT_HELD:
+            error = ERR_NOT_SUPPORTED;
+            break;
+        default:
+            break;
         }
+        return nullptr;
     }
+    if (pre_fault && !huge_pages && readwrite) veil::os::pre_fault(allocated_address, size, error);
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
-    allocated_address = (uint8 *) ::mmap(nullptr,
+    allocated_address = (uint8 *) ::mmap(address,
                                          size,
-                                         (readwrite ? PROT_READ | PROT_WRITE : 0),
-                                         MAP_PRIVATE | (reserve ? 0 : MAP_NORESERVE),
+                                         (readwrite ? PROT_READ | PROT_WRITE : PROT_NONE),
+                                         MAP_PRIVATE | MAP_ANONYMOUS |
+                                         (reserve ? 0 : MAP_NORESERVE) |
+                                         (huge_pages ? MAP_HUGETLB : 0) |
+                                         (pre_fault ? MAP_POPULATE : 0),
                                          -1, 0);
     if (allocated_address == MAP_FAILED) {
         switch ((uint32) errno) {
-            case ENOMEM:
-                error = ERR_NOMEM;
+        case ENOMEM:
+            error = ERR_NOMEM;
+            break;
+        case EINVAL:
+        case EPERM:
+            // Explicit huge pages are rejected with these codes if the host does not support them.
+            error = ERR_NOT_SUPPORTED;
+            break;
+        default:
+            break;
         }
+        return nullptr;
     }
 #   endif
     return allocated_address;
 }
+
+void veil::os::munmap(void *address, uint64 size, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // The size must be zero when releasing the whole reservation.
+    if (!VirtualFree((LPVOID) address, 0, MEM_RELEASE))
+        error = ERR_NOT_SUPPORTED;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    if (::munmap(address, size))
+        error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#   endif
+}
+
+void veil::os::commit(void *address, uint64 size, bool huge_pages, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // Large pages cannot be committed within an existing reservation.
+    if (huge_pages) {
+        error = ERR_NOT_SUPPORTED;
+        return;
+    }
+    if (!VirtualAlloc((LPVOID) address, (SIZE_T) size, MEM_COMMIT, PAGE_READWRITE))
+        error = GetLastError() == ERROR_NOT_ENOUGH_MEMORY ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    if (huge_pages) {
+        // Huge pages are only provided by a hugetlb mapping, which replaces the reserved pages in place.
+        void *mapped = ::mmap(address, size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+        if (mapped == MAP_FAILED)
+            error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+        return;
+    }
+    if (::mprotect(address, size, PROT_READ | PROT_WRITE))
+        error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#   endif
+}
+
+void veil::os::decommit(void *address, uint64 size, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    if (!VirtualFree((LPVOID) address, (SIZE_T) size, MEM_DECOMMIT))
+        error = ERR_NOT_SUPPORTED;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    if (!::madvise(address, size, MADV_DONTNEED) && !::mprotect(address, size, PROT_NONE)) return;
+    // Hugetlb pages might refuse the advice on older hosts, replacing the pages with a fresh reservation releases them
+    // regardless of the page backing.
+    void *mapped = ::mmap(address, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED)
+        error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#   endif
+}
+
+void veil::os::pre_fault(void *address, uint64 size, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(__linux__) && defined(MADV_POPULATE_WRITE)
+    if (!::madvise(address, size, MADV_POPULATE_WRITE)) return;
+    // Hosts prior to Linux 5.14 reject the advice, fallback to fault the pages manually.
+#   endif
+    auto *pages = static_cast<volatile uint8 *>(address);
+    uint32 page_size = get_page_size();
+    // Write to every page of the section to fault them in, the pages of an anonymous mapping are zero filled.
+    for (uint64 offset = 0; offset < size; offset += page_size)
+        pages[offset] = 0;
+}
+
+void veil::os::advise_huge_pages(void *address, uint64 size, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // Windows does not provide transparent huge pages, large pages can only be requested on allocation.
+    error = ERR_NOT_SUPPORTED;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+#       if defined(MADV_HUGEPAGE)
+    if (::madvise(address, size, MADV_HUGEPAGE))
+        error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#       else
+    error = ERR_NOT_SUPPORTED;
+#       endif
+#   endif
+}
+
+void veil::os::numa_bind(void *address, uint64 size, uint64 node_mask, bool interleave, uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // The NUMA placement of Windows can only be specified on allocation with VirtualAllocExNuma.
+    error = ERR_NOT_SUPPORTED;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+#       if defined(SYS_mbind)
+    // The kernel ignores the last bit of the node mask, thus the maximum node count is one more than the mask width.
+    unsigned long mask = static_cast<unsigned long>(node_mask);
+    long result = syscall(SYS_mbind, address, size, interleave ? VEIL_MPOL_INTERLEAVE : VEIL_MPOL_BIND,
+                          &mask, sizeof(mask) * 8 + 1, 0);
+    if (result)
+        error = errno == ENOMEM ? ERR_NOMEM : ERR_NOT_SUPPORTED;
+#       else
+    error = ERR_NOT_SUPPORTED;
+#       endif
+#   endif
+}
+
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+
+/// The limits of the cgroup v1 memory controller at or above this value represent the absence of a limit, which is
+/// the maximum page aligned value of a signed 64-bit integer.
+static const uint64 CGROUP_V1_UNLIMITED = 1ULL << 62;
+
+/// Read the limit of the \a file within the cgroup of the \a path and all its ancestors under the \a mount.
+/// \return The smallest limit found, or 0 if no limit is found.
+static uint64 read_cgroup_limit(const char *mount, const char *path, const char *file) {
+    char directory[512];
+    snprintf(directory, sizeof(directory), "%s%s", mount, path);
+    uint64 limit = 0;
+    while (true) {
+        char limit_path[600];
+        snprintf(limit_path, sizeof(limit_path), "%s/%s", directory, file);
+        FILE *limit_file = fopen(limit_path, "r");
+        if (limit_file) {
+            // The value "max" of cgroup v2 does not parse, which represents the absence of a limit.
+            unsigned long long value;
+            if (fscanf(limit_file, "%llu", &value) == 1 && value && value < CGROUP_V1_UNLIMITED &&
+                (!limit || value < limit))
+                limit = value;
+            fclose(limit_file);
+        }
+        // Walk up to the parent cgroup until the mount point is reached.
+        char *separator = strrchr(directory, '/');
+        if (!separator || static_cast<size_t>(separator - directory) < strlen(mount)) break;
+        *separator = '\0';
+    }
+    return limit;
+}
+
+#endif
+
+uint64 veil::os::get_memory_limit(uint32 &error) {
+    error = veil::ERR_NONE;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION information;
+    if (!QueryInformationJobObject(nullptr, JobObjectExtendedLimitInformation, &information, sizeof(information),
+                                   nullptr))
+        return 0;
+    DWORD flags = information.BasicLimitInformation.LimitFlags;
+    if (flags & JOB_OBJECT_LIMIT_JOB_MEMORY) return static_cast<uint64>(information.JobMemoryLimit);
+    if (flags & JOB_OBJECT_LIMIT_PROCESS_MEMORY) return static_cast<uint64>(information.ProcessMemoryLimit);
+    return 0;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    FILE *cgroups = fopen("/proc/self/cgroup", "r");
+    if (!cgroups) return 0;
+    // Each line is formatted as "<id>:<controllers>:<path>", the unified hierarchy of cgroup v2 has the id 0 and no
+    // controllers, while the memory controller of cgroup v1 is listed by name.
+    char line[512];
+    uint64 limit = 0;
+    while (fgets(line, sizeof(line), cgroups)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *controllers = strchr(line, ':');
+        char *path = controllers ? strchr(controllers + 1, ':') : nullptr;
+        if (!path) continue;
+        *path++ = '\0';
+        controllers++;
+        // The path of the root cgroup is "/", which is trimmed to avoid a doubled separator.
+        if (!strcmp(path, "/")) path[0] = '\0';
+        uint64 found = 0;
+        if (!strcmp(line, "0") && !controllers[0]) {
+            found = read_cgroup_limit("/sys/fs/cgroup", path, "memory.max");
+        } else {
+            bool memory = false;
+            for (char *controller = strtok(controllers, ","); controller; controller = strtok(nullptr, ","))
+                memory |= !strcmp(controller, "memory");
+            if (memory) found = read_cgroup_limit("/sys/fs/cgroup/memory", path, "memory.limit_in_bytes");
+        }
+        if (found && (!limit || found < limit)) limit = found;
+    }
+    fclose(cgroups);
+    return limit;
+#   else
+    error = ERR_NOT_SUPPORTED;
+    return 0;
+#   endif
+}
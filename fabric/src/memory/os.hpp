@@ -26,7 +26,44 @@ namespace veil::os {
 
     uint32 get_page_size();
 
-    void *mmap(void *address, uint64 size, bool readwrite, bool reserve, uint32 &error);
+    /// \return The default size of the explicit huge pages of the host, or 0 if huge pages are not supported.
+    uint64 get_huge_page_size();
+
+    /// Map an anonymous memory section.
+    /// \param huge_pages Whether the section is backed by explicit huge pages, the \a size must be a multiple of the
+    ///                   size returned by \c os::get_huge_page_size.
+    /// \param pre_fault  Whether the pages of the section are faulted in before this method returns.
+    void *mmap(void *address, uint64 size, bool readwrite, bool reserve, bool huge_pages, bool pre_fault,
+               uint32 &error);
+
+    /// Unmap a memory section mapped by \c os::mmap, including all its committed pages.
+    void munmap(void *address, uint64 size, uint32 &error);
+
+    /// Commit a page aligned memory section within a section mapped without read & write permission, the committed
+    /// section is permitted to perform READ & WRITE operations.
+    /// \param huge_pages Whether the section is backed by explicit huge pages, the \a address and \a size must be
+    ///                   aligned to the size returned by \c os::get_huge_page_size.
+    void commit(void *address, uint64 size, bool huge_pages, uint32 &error);
+
+    /// Decommit a committed memory section, the physical pages are returned to the host and the section is no longer
+    /// permitted to perform any operation, while the address range remains reserved.
+    void decommit(void *address, uint64 size, uint32 &error);
+
+    /// Fault in all pages of the mapped memory section, the section must be mapped with read & write permission.
+    void pre_fault(void *address, uint64 size, uint32 &error);
+
+    /// Advise the host to back the mapped memory section with transparent huge pages.
+    void advise_huge_pages(void *address, uint64 size, uint32 &error);
+
+    /// Set the NUMA memory placement policy of the mapped memory section, the policy applies to the pages which are not
+    /// faulted in yet.
+    /// \param node_mask  The bit mask of the NUMA nodes the pages are placed on.
+    /// \param interleave Whether the pages are interleaved across the nodes, or bound to the nodes.
+    void numa_bind(void *address, uint64 size, uint64 node_mask, bool interleave, uint32 &error);
+
+    /// \return The memory limit imposed on the process by its container, which is the smallest limit of the cgroup
+    ///         hierarchy of the process on Linux or the limit of its job object on Windows; 0 if there is no limit.
+    uint64 get_memory_limit(uint32 &error);
 
 }
 
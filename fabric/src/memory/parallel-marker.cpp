@@ -0,0 +1,143 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "src/memory/parallel-marker.hpp"
+#include "src/memory/os.hpp"
+
+using namespace veil::memory;
+using namespace veil;
+
+/// The interval in milliseconds the parked workers poll for a new marking, as a notification might be missed.
+static const uint32 POLL_INTERVAL = 10;
+
+class ParallelMarker::Worker : public HeapObject, public threading::VMService {
+public:
+    Worker(ParallelMarker &marker, uint32 index) : VMService("Memory:ParallelMarker"), marker(marker), index(index) {}
+
+    void run() override {
+        ParallelMarker &target = this->marker;
+        threading::Scheduler *scheduler = this->vm::HasRoot<threading::Scheduler>::root();
+        uint32 observed = 0;
+        while (!target.stopping.load() && !scheduler->is_terminated()) {
+            uint32 phase = target.phase.load();
+            if (phase == observed) {
+                target.phase_cv.wait_for(POLL_INTERVAL);
+                continue;
+            }
+            observed = phase;
+            target.work(this->index);
+        }
+        (void) target.exited.fetch_add(1);
+    }
+
+private:
+    ParallelMarker &marker;
+    const uint32 index;
+};
+
+ParallelMarker::ParallelMarker(threading::Scheduler &scheduler, uint32 worker_count) :
+        scheduler(scheduler), worker_count(worker_count ? worker_count : 1), started(false) {
+    this->deques = static_cast<MarkDeque *>(os::malloc(this->worker_count * sizeof(MarkDeque)));
+    this->buffers = static_cast<PointerStack *>(os::malloc(this->worker_count * sizeof(PointerStack)));
+    this->workers = static_cast<Worker **>(os::malloc(this->worker_count * sizeof(Worker *)));
+    this->start_tasks = static_cast<threading::Scheduler::StartServiceTask *>(
+            os::malloc(this->worker_count * sizeof(threading::Scheduler::StartServiceTask)));
+    for (uint32 index = 0; index < this->worker_count; index++) {
+        // The classes forbid the allocation of arrays, thus the elements are constructed in place explicitly.
+        ::new(&this->deques[index]) MarkDeque();
+        ::new(&this->buffers[index]) PointerStack();
+        this->workers[index] = index ? new Worker(*this, index) : nullptr;
+    }
+}
+
+ParallelMarker::~ParallelMarker() {
+    this->stop();
+    for (uint32 index = 0; index < this->worker_count; index++) {
+        if (this->started && index) this->start_tasks[index].~StartServiceTask();
+        delete this->workers[index];
+        this->buffers[index].~PointerStack();
+        this->deques[index].~MarkDeque();
+    }
+    os::free(this->start_tasks);
+    os::free(this->workers);
+    os::free(this->buffers);
+    os::free(this->deques);
+}
+
+void ParallelMarker::start() {
+    if (this->started) return;
+    this->started = true;
+    for (uint32 index = 1; index < this->worker_count; index++) {
+        auto *task = ::new(&this->start_tasks[index]) threading::Scheduler::StartServiceTask(*this->workers[index]);
+        this->scheduler.add_task(*task);
+    }
+    this->scheduler.notify();
+}
+
+void ParallelMarker::stop() {
+    if (!this->started || this->stopping.exchange(true)) return;
+    this->phase_cv.notify_all();
+    while (this->exited.load() < this->worker_count - 1) this->phase_cv.wait_for(POLL_INTERVAL);
+}
+
+void ParallelMarker::mark(MarkTracer &target, PointerStack &gray) {
+    os::CriticalSection _(this->marking_m);
+    // The tracer is published before any pointer, as a worker might still be stealing since the last marking.
+    this->tracer.store(&target);
+    MarkDeque &own = this->deques[0];
+    while (!gray.is_empty()) own.push(gray.pop());
+    (void) this->phase.fetch_add(1);
+    this->phase_cv.notify_all();
+    this->work(0);
+}
+
+uint32 ParallelMarker::get_worker_count() const { return this->worker_count; }
+
+void ParallelMarker::work(uint32 worker) {
+    MarkDeque &own = this->deques[worker];
+    PointerStack &gray = this->buffers[worker];
+    (void) this->active.fetch_add(1);
+    while (true) {
+        Pointer *object = own.pop();
+        if (!object) object = this->steal(worker);
+        if (object) {
+            this->tracer.load()->scan(object, worker, gray);
+            while (!gray.is_empty()) own.push(gray.pop());
+            continue;
+        }
+
+        (void) this->active.fetch_sub(1);
+        // A worker publishes the pointers it shades before it turns inactive, while a thief turns active before it
+        // steals; thus the marking is terminated if no worker is active after all deques are observed empty.
+        while (this->is_exhausted()) {
+            if (!this->active.load()) return;
+            os::Thread::static_sleep(0);
+        }
+        (void) this->active.fetch_add(1);
+    }
+}
+
+Pointer *ParallelMarker::steal(uint32 worker) {
+    for (uint32 offset = 1; offset < this->worker_count; offset++) {
+        Pointer *pointer = this->deques[(worker + offset) % this->worker_count].steal();
+        if (pointer) return pointer;
+    }
+    return nullptr;
+}
+
+bool ParallelMarker::is_exhausted() const {
+    for (uint32 index = 0; index < this->worker_count; index++) if (!this->deques[index].is_empty()) return false;
+    return true;
+}
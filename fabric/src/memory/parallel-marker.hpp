@@ -0,0 +1,121 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_PARALLEL_MARKER_HPP
+#define VEIL_FABRIC_SRC_MEMORY_PARALLEL_MARKER_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/memory/tracing.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/threading/os.hpp"
+#include "src/threading/scheduler.hpp"
+#include "src/threading/work-stealing-deque.hpp"
+
+namespace veil::memory {
+
+    /// The tracing collector driving a \c ParallelMarker, which scans the gray objects on behalf of the workers.
+    class MarkTracer {
+    public:
+        /// Scan the gray \a object and push the pointers it shades onto the \a gray stack.
+        /// \attention This method is invoked concurrently by the workers, each with its own \a worker index within
+        /// [0, \c ParallelMarker::get_worker_count), the index 0 is the thread invoking \c ParallelMarker::mark.
+        virtual void scan(Pointer *object, uint32 worker, PointerStack &gray) = 0;
+
+    protected:
+        /// The tracer is never deleted through this interface, but only as its concrete type.
+        ~MarkTracer() = default;
+    };
+
+    /// A work-stealing deque of the gray pointers, the owner pushes and pops at the bottom while the other workers
+    /// steal from the top. The deque is growable, as the pointers shaded by a scan have nowhere else to overflow.
+    class MarkDeque : public threading::WorkStealingDeque<Pointer> {
+    public:
+        static const uint64 INITIAL_CAPACITY = 1024;
+
+        MarkDeque() : WorkStealingDeque(INITIAL_CAPACITY, true) {}
+    };
+
+    /// A parallel marking engine, the transitive closure of a gray stack is traced by the thread invoking
+    /// \c ParallelMarker::mark together with the worker services scheduled on a \c threading::Scheduler. Each worker
+    /// owns a \c MarkDeque which it pushes the pointers shaded by its own scans onto, and steals from the deques of the
+    /// other workers once its own deque is exhausted; the marking terminates once all deques are empty while no
+    /// worker is scanning.
+    /// <br><br>
+    /// The workers are scheduled once by \c ParallelMarker::start and stay parked between the markings, a marking is
+    /// still completed by the invoking thread alone if the workers are not (yet) running.
+    /// \attention The worker services are hosted by the threads of the scheduler, thus the marker must outlive the
+    /// scheduler task loop: \c ParallelMarker::stop is invoked before the scheduler is terminated, and the marker is
+    /// destructed after \c threading::Scheduler::start returns.
+    class ParallelMarker : public HeapObject {
+    public:
+        /// \param scheduler    The scheduler hosting the worker services.
+        /// \param worker_count The number of the workers including the thread invoking \c ParallelMarker::mark, thus
+        ///                     (\a worker_count - 1) services are scheduled.
+        ParallelMarker(threading::Scheduler &scheduler, uint32 worker_count);
+
+        ~ParallelMarker();
+
+        /// Schedule the worker services onto the scheduler.
+        void start();
+
+        /// Request the worker services to return and wait until they return.
+        void stop();
+
+        /// Trace the transitive closure of the \a gray stack with the \a tracer, the \a gray stack is drained.
+        /// \attention The markings are serialized, a concurrent invocation waits for the one in progress.
+        void mark(MarkTracer &tracer, PointerStack &gray);
+
+        [[nodiscard]] uint32 get_worker_count() const;
+
+    private:
+        class Worker;
+
+        threading::Scheduler &scheduler;
+        const uint32 worker_count;
+        /// The deque and the local gray stack of each worker.
+        MarkDeque *deques;
+        PointerStack *buffers;
+        /// The worker services and their start tasks, the worker of index 0 is the invoking thread thus absent.
+        Worker **workers;
+        threading::Scheduler::StartServiceTask *start_tasks;
+        /// Whether the worker services are scheduled.
+        bool started;
+
+        os::Mutex marking_m;
+        /// The tracer of the marking in progress.
+        os::atomic_pointer_t<MarkTracer> tracer = os::atomic_pointer_t<MarkTracer>(nullptr);
+        /// The number of the markings started, a worker joins a marking once it observes a new one.
+        os::atomic_u32_t phase = os::atomic_u32_t(0);
+        /// The number of the workers scanning or about to steal.
+        os::atomic_u32_t active = os::atomic_u32_t(0);
+        os::atomic_bool_t stopping = os::atomic_bool_t(false);
+        /// The number of the worker services returned.
+        os::atomic_u32_t exited = os::atomic_u32_t(0);
+        os::ConditionVariable phase_cv;
+
+        /// Trace with the deque of the \a worker until the marking in progress terminates.
+        void work(uint32 worker);
+
+        /// \return A pointer stolen from the deques of the workers other than the \a worker.
+        Pointer *steal(uint32 worker);
+
+        [[nodiscard]] bool is_exhausted() const;
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_PARALLEL_MARKER_HPP
@@ -0,0 +1,200 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdio>
+
+#include "src/memory/profiling.hpp"
+#include "src/memory/os.hpp"
+#include "src/threading/os.hpp"
+#include "src/util/hash.hpp"
+#include "src/vm/diagnostics.hpp"
+
+#if defined(VEIL_ENABLE_PROFILING)
+
+using namespace veil::memory;
+
+/// The samples of a distinct callstack, chained within a bucket of the \c SampleTable.
+/// \attention Allocated from the host heap directly, as allocating a \c HeapObject here will recurse.
+struct SampledCallstack {
+    SampledCallstack *next;
+    uint64 hash;
+    uint32 depth;
+    void *frames[AllocationSampler::MAX_SAMPLE_DEPTH];
+    /// The number of the samples of this callstack.
+    uint64 count;
+    /// The total byte size of the sampled allocations, which is not scaled by the sampling interval.
+    uint64 size;
+};
+
+/// The process wide table of the sampled callstacks protected by a spin lock.
+/// \attention The spin lock cannot be replaced by \c os::Mutex, as the construction of a mutex allocates a
+/// \c HeapObject which will recurse into the sampler.
+struct SampleTable {
+    static const uint32 BUCKET_COUNT = 1024;
+
+    veil::os::atomic_u32_t lock = veil::os::atomic_u32_t(0);
+    veil::os::atomic_u64_t interval = veil::os::atomic_u64_t(AllocationSampler::DEFAULT_SAMPLING_INTERVAL);
+    veil::os::atomic_u64_t sample_count = veil::os::atomic_u64_t(0);
+    SampledCallstack *buckets[BUCKET_COUNT] = {};
+
+    void acquire() { while (this->lock.exchange(1)) veil::os::Thread::static_sleep(0); }
+
+    void release() { this->lock.store(0); }
+};
+
+/// The table is constructed on its first use, as a HeapObject can be allocated by the static initializer of another
+/// translation unit before the static initializer of this translation unit.
+static SampleTable &sample_table() {
+    static SampleTable instance;
+    return instance;
+}
+
+thread_local int64 AllocationSampler::countdown = 0;
+
+/// The state of the random generator of the calling thread, which is \c 0 before the thread draws its first countdown.
+static thread_local uint64 random_state = 0;
+
+/// Draw a countdown from the exponential distribution with the mean of \a interval.
+static int64 draw_countdown(uint64 interval) {
+    static const int64 MAX_COUNTDOWN = INT64_MAX / 2;
+    if (interval == 0) return INT64_MAX;
+
+    // The xorshift64* generator seeded by the address of the thread local state, which differs between threads.
+    if (random_state == 0) random_state = veil::util::standard_u64_hash_function(&random_state) | 1;
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    uint64 random = random_state * 0x2545F4914F6CDD1DULL;
+    // A uniform value within (0, 1], the 53 bits fit the mantissa of a double exactly.
+    double uniform = static_cast<double>((random >> 11) + 1) / static_cast<double>(1ULL << 53);
+    double drawn = -std::log(uniform) * static_cast<double>(interval);
+    return drawn < static_cast<double>(MAX_COUNTDOWN) ? static_cast<int64>(drawn) + 1 : MAX_COUNTDOWN;
+}
+
+void AllocationSampler::record(uint64 size) {
+    SampleTable &table = sample_table();
+    // The first countdown of a thread starts from 0, which is drawn without recording a sample.
+    bool drawn = random_state != 0;
+    uint64 interval = table.interval.load();
+    countdown = draw_countdown(interval);
+    if (!drawn || interval == 0) return;
+
+    SampledCallstack sampled;
+    // Skip the frame of this function, the inlined AllocationSampler::sample belongs to the allocation function.
+    int32 depth = veil::capture_callstack(sampled.frames, MAX_SAMPLE_DEPTH, 1);
+    uint64 hash = 0;
+    for (int32 i = 0; i < depth; i++) hash = hash * 31 + veil::util::standard_u64_hash_function(sampled.frames[i]);
+
+    table.acquire();
+    SampledCallstack **bucket = &table.buckets[hash % SampleTable::BUCKET_COUNT];
+    SampledCallstack *current = *bucket;
+    while (current != nullptr) {
+        if (current->hash == hash && current->depth == static_cast<uint32>(depth)) {
+            bool same = true;
+            for (int32 i = 0; i < depth && same; i++) same = current->frames[i] == sampled.frames[i];
+            if (same) break;
+        }
+        current = current->next;
+    }
+    if (current == nullptr) {
+        current = static_cast<SampledCallstack *>(veil::os::malloc(sizeof(SampledCallstack)));
+        if (current == nullptr) {
+            // The sample is dropped rather than failing the allocation being sampled.
+            table.release();
+            return;
+        }
+        current->next = *bucket;
+        current->hash = hash;
+        current->depth = depth;
+        for (int32 i = 0; i < depth; i++) current->frames[i] = sampled.frames[i];
+        current->count = 0;
+        current->size = 0;
+        *bucket = current;
+    }
+    current->count++;
+    current->size += size;
+    table.release();
+    (void) table.sample_count.fetch_add(1);
+}
+
+void AllocationSampler::set_sampling_interval(uint64 interval) {
+    sample_table().interval.store(interval);
+    countdown = draw_countdown(interval);
+}
+
+uint64 AllocationSampler::get_sampling_interval() { return sample_table().interval.load(); }
+
+uint64 AllocationSampler::get_sample_count() { return sample_table().sample_count.load(); }
+
+bool AllocationSampler::dump(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) return false;
+
+    SampleTable &table = sample_table();
+    table.acquire();
+    unsigned long long total_count = 0, total_size = 0;
+    for (SampledCallstack *bucket: table.buckets) {
+        for (SampledCallstack *current = bucket; current != nullptr; current = current->next) {
+            total_count += current->count;
+            total_size += current->size;
+        }
+    }
+    // The heap_v2 header tells pprof to scale the samples by the Poisson sampling of the interval, the in-use values
+    // are left empty as the frees are not tracked.
+    fprintf(file, "heap profile: 0: 0 [%llu: %llu] @ heap_v2/%llu\n", total_count, total_size,
+            static_cast<unsigned long long>(table.interval.load()));
+    for (SampledCallstack *bucket: table.buckets) {
+        for (SampledCallstack *current = bucket; current != nullptr; current = current->next) {
+            fprintf(file, "0: 0 [%llu: %llu] @", static_cast<unsigned long long>(current->count),
+                    static_cast<unsigned long long>(current->size));
+            for (uint32 i = 0; i < current->depth; i++)
+                fprintf(file, " 0x%llx", reinterpret_cast<unsigned long long>(current->frames[i]));
+            fprintf(file, "\n");
+        }
+    }
+    table.release();
+
+    // The mappings of the process are required by pprof to symbolize the addresses.
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+#   if defined(__linux__) || defined(__linux) || defined(linux)
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps != nullptr) {
+        char buffer[4096];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), maps)) > 0) fwrite(buffer, 1, length, file);
+        fclose(maps);
+    }
+#   endif
+    return fclose(file) == 0;
+}
+
+void AllocationSampler::reset() {
+    SampleTable &table = sample_table();
+    table.acquire();
+    for (SampledCallstack *&bucket: table.buckets) {
+        SampledCallstack *current = bucket;
+        while (current != nullptr) {
+            SampledCallstack *next = current->next;
+            veil::os::free(current);
+            current = next;
+        }
+        bucket = nullptr;
+    }
+    table.sample_count.store(0);
+    table.release();
+}
+
+#endif
@@ -16,12 +16,65 @@
 #ifndef VEIL_FABRIC_SRC_MEMORY_PROFILING_HPP
 #define VEIL_FABRIC_SRC_MEMORY_PROFILING_HPP
 
-#include "src/threading/atomic.hpp"
+#include "src/typedefs.hpp"
 
 namespace veil::memory {
 #   if defined(VEIL_ENABLE_PROFILING)
 
-    static os::atomic_u64_t os_heap_allocated_size(0);
+    /// \return The byte size of the process heap allocated by \c HeapObject, the allocations accounted by the thread
+    ///         local counters of \c HeapCache are only included after they are merged.
+    uint64 os_heap_allocated_size();
+
+    /// A sampling allocation profiler which attributes the allocations of \c HeapObject, \c Arena and \c Allocator to
+    /// their callstacks. Each thread counts down the allocated bytes to its next sample, the intervals between the
+    /// samples are drawn from an exponential distribution with the mean of the sampling interval, thus the allocated
+    /// bytes are sampled as a Poisson process which is not biased by a periodic allocation pattern. The allocations in
+    /// between two samples only cost a decrement of a thread local counter.
+    /// <br><br>
+    /// The samples are aggregated by their callstacks into a process wide table, which is dumped in the legacy heap
+    /// profile format of pprof. The profile accounts the allocations only, as the frees are not tracked, thus it should
+    /// be read with the \c alloc_space or \c alloc_objects sample index of pprof.
+    /// \attention The sampler is invoked within the allocation paths of \c HeapObject, thus it must not allocate any
+    /// \c HeapObject itself.
+    class AllocationSampler {
+    public:
+        /// The default mean byte interval between two samples.
+        static const uint64 DEFAULT_SAMPLING_INTERVAL = 512 * 1024;
+        /// The maximum number of frames recorded of a sampled callstack.
+        static const uint32 MAX_SAMPLE_DEPTH = 32;
+
+        /// Account an allocation of \a size bytes to the sampler, which is sampled if the countdown of the calling
+        /// thread is exhausted.
+        static inline void sample(uint64 size);
+
+        /// Set the mean byte interval between two samples, or \c 0 to disable the sampling. The countdown of the
+        /// calling thread is reset immediately, while the other threads follow on their next sample.
+        static void set_sampling_interval(uint64 interval);
+
+        [[nodiscard]] static uint64 get_sampling_interval();
+
+        /// \return The number of samples recorded since the last reset.
+        [[nodiscard]] static uint64 get_sample_count();
+
+        /// Write the aggregated samples to the file at \a path in the legacy heap profile format of pprof.
+        /// \return Whether the profile is written successfully.
+        static bool dump(const char *path);
+
+        /// Discard all recorded samples.
+        static void reset();
+
+    private:
+        /// The bytes to be allocated by the calling thread before its next sample.
+        static thread_local int64 countdown;
+
+        /// Record a sample of the allocation of \a size bytes and draw the countdown to the next sample.
+        static void record(uint64 size);
+    };
+
+    inline void AllocationSampler::sample(uint64 size) {
+        countdown -= static_cast<int64>(size);
+        if (countdown < 0) record(size);
+    }
 
 #   endif
 }
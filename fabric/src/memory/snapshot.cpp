@@ -0,0 +1,474 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include "src/memory/snapshot.hpp"
+#include "src/memory/os.hpp"
+
+using namespace veil::memory;
+
+HeapSnapshotRequest::HeapSnapshotRequest(const char *path) : path(path) {}
+
+uint64 HeapSnapshotRequest::get_skipped_count() const { return this->skipped_count; }
+
+const char HeapSnapshotFormat::MAGIC[] = "VEILHEAP";
+
+HeapSnapshotWriter::HeapSnapshotWriter() :
+        file(nullptr), buffer(nullptr), buffered(0), failed(false), last_root(0), last_object(0), root_count(0),
+        object_count(0), reference_count(0) {}
+
+HeapSnapshotWriter::~HeapSnapshotWriter() {
+    if (this->file) (void) this->close();
+}
+
+bool HeapSnapshotWriter::open(const char *path) {
+    this->file = fopen(path, "wb");
+    if (!this->file) return false;
+    this->buffer = static_cast<uint8 *>(os::malloc(BUFFER_SIZE));
+    for (uint32 index = 0; index < HeapSnapshotFormat::MAGIC_SIZE; index++)
+        this->write_byte(HeapSnapshotFormat::MAGIC[index]);
+    this->write_varint(HeapSnapshotFormat::VERSION);
+    return true;
+}
+
+void HeapSnapshotWriter::write_root(const Pointer *pointer) {
+    this->write_byte(HeapSnapshotFormat::TAG_ROOT);
+    this->write_identity(pointer, this->last_root);
+    this->last_root = reinterpret_cast<uint64>(pointer);
+    this->root_count++;
+}
+
+void HeapSnapshotWriter::write_object(const Pointer *pointer, uint64 capacity) {
+    this->write_byte(HeapSnapshotFormat::TAG_OBJECT);
+    this->write_identity(pointer, this->last_object);
+    this->write_varint(pointer->size);
+    this->write_varint(capacity);
+    this->last_object = reinterpret_cast<uint64>(pointer);
+    this->object_count++;
+}
+
+void HeapSnapshotWriter::write_reference(const Pointer *pointer) {
+    this->write_byte(HeapSnapshotFormat::TAG_REFERENCE);
+    this->write_identity(pointer, this->last_object);
+    this->reference_count++;
+}
+
+bool HeapSnapshotWriter::close() {
+    this->write_byte(HeapSnapshotFormat::TAG_END);
+    this->write_varint(this->root_count);
+    this->write_varint(this->object_count);
+    this->write_varint(this->reference_count);
+    this->flush();
+    if (fclose(this->file) != 0) this->failed = true;
+    this->file = nullptr;
+    os::free(this->buffer);
+    this->buffer = nullptr;
+    return !this->failed;
+}
+
+void HeapSnapshotWriter::write_byte(uint8 value) {
+    if (this->buffered == BUFFER_SIZE) this->flush();
+    this->buffer[this->buffered++] = value;
+}
+
+void HeapSnapshotWriter::write_varint(uint64 value) {
+    while (value >= 0x80) {
+        this->write_byte(static_cast<uint8>(value) | 0x80);
+        value >>= 7;
+    }
+    this->write_byte(static_cast<uint8>(value));
+}
+
+void HeapSnapshotWriter::write_identity(const Pointer *pointer, uint64 base) {
+    auto difference = static_cast<int64>(reinterpret_cast<uint64>(pointer) - base);
+    this->write_varint((static_cast<uint64>(difference) << 1) ^ static_cast<uint64>(difference >> 63));
+}
+
+void HeapSnapshotWriter::flush() {
+    if (this->buffered && fwrite(this->buffer, 1, this->buffered, this->file) != this->buffered) this->failed = true;
+    this->buffered = 0;
+}
+
+/// Reads the records of a snapshot file through a fixed size buffer.
+class SnapshotReader : public ValueObject {
+public:
+    explicit SnapshotReader(FILE *file) : file(file), position(0), limit(0) {
+        this->buffer = static_cast<uint8 *>(veil::os::malloc(HeapSnapshotWriter::BUFFER_SIZE));
+    }
+
+    ~SnapshotReader() { veil::os::free(this->buffer); }
+
+    /// \return Whether a byte is read, otherwise the file is exhausted.
+    bool read_byte(uint8 &value) {
+        if (this->position == this->limit) {
+            this->limit = static_cast<uint32>(fread(this->buffer, 1, HeapSnapshotWriter::BUFFER_SIZE, this->file));
+            this->position = 0;
+            if (!this->limit) return false;
+        }
+        value = this->buffer[this->position++];
+        return true;
+    }
+
+    bool read_varint(uint64 &value) {
+        value = 0;
+        uint8 byte;
+        for (uint32 shift = 0; shift < 64; shift += 7) {
+            if (!this->read_byte(byte)) return false;
+            value |= static_cast<uint64>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    /// Read an identity encoded as the difference from the \a base identity.
+    bool read_identity(uint64 base, uint64 &identity) {
+        uint64 encoded;
+        if (!this->read_varint(encoded)) return false;
+        identity = base + ((encoded >> 1) ^ (~(encoded & 1) + 1));
+        return true;
+    }
+
+private:
+    FILE *file;
+    uint8 *buffer;
+    uint32 position;
+    uint32 limit;
+};
+
+
+/// The initial capacity of the growable arrays of a loading snapshot.
+static const uint64 INITIAL_CAPACITY = 1024;
+
+/// Reallocate the \a array holding \a count elements to the \a capacity.
+template<typename T>
+static T *reallocate(T *array, uint64 count, uint64 capacity) {
+    auto *reallocated = static_cast<T *>(veil::os::malloc(capacity * sizeof(T)));
+    if (array) {
+        memcpy(reallocated, array, count * sizeof(T));
+        veil::os::free(array);
+    }
+    return reallocated;
+}
+
+/// Append the \a value to the \a array of \a count elements, the \a capacity is doubled if the array is full.
+static void append(uint64 *&array, uint64 &count, uint64 &capacity, uint64 value) {
+    if (count == capacity) {
+        capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+        array = reallocate(array, count, capacity);
+    }
+    array[count++] = value;
+}
+
+HeapSnapshot::HeapSnapshot() :
+        object_count(0), identities(nullptr), sizes(nullptr), capacities(nullptr), reference_offsets(nullptr),
+        references(nullptr), dominators(nullptr), retained_sizes(nullptr) {}
+
+HeapSnapshot::~HeapSnapshot() { this->clear(); }
+
+void HeapSnapshot::clear() {
+    if (this->identities) os::free(this->identities);
+    if (this->sizes) os::free(this->sizes);
+    if (this->capacities) os::free(this->capacities);
+    if (this->reference_offsets) os::free(this->reference_offsets);
+    if (this->references) os::free(this->references);
+    if (this->dominators) os::free(this->dominators);
+    if (this->retained_sizes) os::free(this->retained_sizes);
+    this->object_count = 0;
+    this->identities = nullptr;
+    this->sizes = nullptr;
+    this->capacities = nullptr;
+    this->reference_offsets = nullptr;
+    this->references = nullptr;
+    this->dominators = nullptr;
+    this->retained_sizes = nullptr;
+}
+
+bool HeapSnapshot::load(const char *path) {
+    this->clear();
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    SnapshotReader reader(file);
+    bool valid = true;
+    for (uint32 index = 0; index < HeapSnapshotFormat::MAGIC_SIZE && valid; index++) {
+        uint8 byte;
+        valid = reader.read_byte(byte) && byte == static_cast<uint8>(HeapSnapshotFormat::MAGIC[index]);
+    }
+    uint64 version;
+    valid = valid && reader.read_varint(version) && version == HeapSnapshotFormat::VERSION;
+
+    // The object at the index 0 is the virtual root, the roots are collected separately as its references since the
+    // records of the roots are not required to precede the objects.
+    uint64 count = 1, capacity = INITIAL_CAPACITY;
+    this->identities = reallocate<uint64>(nullptr, 0, capacity);
+    this->sizes = reallocate<uint32>(nullptr, 0, capacity);
+    this->capacities = reallocate<uint64>(nullptr, 0, capacity);
+    // The offsets hold an extra element for the end of the references of the last object.
+    this->reference_offsets = reallocate<uint64>(nullptr, 0, capacity + 1);
+    this->identities[0] = 0;
+    this->sizes[0] = 0;
+    this->capacities[0] = 0;
+    this->reference_offsets[0] = 0;
+    uint64 *roots = nullptr, root_count = 0, root_capacity = 0;
+    uint64 *targets = nullptr, target_count = 0, target_capacity = 0;
+
+    uint64 last_root = 0, last_object = 0;
+    bool ended = false;
+    while (valid && !ended) {
+        uint8 tag;
+        uint64 identity, size, object_capacity;
+        valid = reader.read_byte(tag);
+        if (!valid) break;
+        switch (tag) {
+            case HeapSnapshotFormat::TAG_ROOT:
+                valid = reader.read_identity(last_root, identity);
+                last_root = identity;
+                append(roots, root_count, root_capacity, identity);
+                break;
+            case HeapSnapshotFormat::TAG_OBJECT:
+                valid = reader.read_identity(last_object, identity) && reader.read_varint(size) &&
+                        reader.read_varint(object_capacity) && size <= UINT32_MAX && count < NO_OBJECT;
+                if (!valid) break;
+                if (count == capacity) {
+                    this->identities = reallocate(this->identities, count, capacity * 2);
+                    this->sizes = reallocate(this->sizes, count, capacity * 2);
+                    this->capacities = reallocate(this->capacities, count, capacity * 2);
+                    this->reference_offsets = reallocate(this->reference_offsets, count, capacity * 2 + 1);
+                    capacity *= 2;
+                }
+                last_object = identity;
+                this->identities[count] = identity;
+                this->sizes[count] = static_cast<uint32>(size);
+                this->capacities[count] = object_capacity;
+                this->reference_offsets[count] = target_count;
+                count++;
+                break;
+            case HeapSnapshotFormat::TAG_REFERENCE:
+                // A reference must follow the object referencing it.
+                valid = count > 1 && reader.read_identity(last_object, identity);
+                append(targets, target_count, target_capacity, identity);
+                break;
+            case HeapSnapshotFormat::TAG_END:
+                ended = true;
+                break;
+            default:
+                valid = false;
+        }
+    }
+    fclose(file);
+
+    if (valid) {
+        // The references of the virtual root are placed before the references of the objects.
+        auto *merged = reallocate<uint64>(nullptr, 0, root_count + target_count + 1);
+        if (root_count) memcpy(merged, roots, root_count * sizeof(uint64));
+        if (target_count) memcpy(merged + root_count, targets, target_count * sizeof(uint64));
+        for (uint64 index = 1; index < count; index++) this->reference_offsets[index] += root_count;
+        this->reference_offsets[count] = root_count + target_count;
+        this->object_count = static_cast<uint32>(count);
+        this->resolve(merged, root_count + target_count);
+        os::free(merged);
+        this->compute_dominators();
+    } else {
+        this->clear();
+    }
+    if (roots) os::free(roots);
+    if (targets) os::free(targets);
+    return valid;
+}
+
+void HeapSnapshot::resolve(const uint64 *targets, uint64 reference_count) {
+    // The identities are indexed by an open addressing table with the identity 0 as the vacant slot, which is never
+    // the address of a pointer.
+    uint32 shift = 64;
+    uint64 slot_count = 1;
+    while (slot_count < static_cast<uint64>(this->object_count) * 2) {
+        slot_count <<= 1;
+        shift--;
+    }
+    auto *slots = reallocate<uint64>(nullptr, 0, slot_count);
+    auto *indices = reallocate<uint32>(nullptr, 0, slot_count);
+    memset(slots, 0, slot_count * sizeof(uint64));
+    for (uint32 index = 1; index < this->object_count; index++) {
+        uint64 identity = this->identities[index];
+        uint64 slot = shift < 64 ? (identity * 0x9E3779B97F4A7C15ULL) >> shift : 0;
+        while (slots[slot] && slots[slot] != identity) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = identity;
+        indices[slot] = index;
+    }
+
+    this->references = reallocate<uint32>(nullptr, 0, reference_count + 1);
+    for (uint64 reference = 0; reference < reference_count; reference++) {
+        uint64 identity = targets[reference];
+        uint64 slot = shift < 64 ? (identity * 0x9E3779B97F4A7C15ULL) >> shift : 0;
+        while (identity && slots[slot] && slots[slot] != identity) slot = (slot + 1) & (slot_count - 1);
+        this->references[reference] = identity && slots[slot] == identity ? indices[slot] : NO_OBJECT;
+    }
+    os::free(slots);
+    os::free(indices);
+}
+
+/// \return The object with the minimal semi-dominator on the path from the \a node to the root of its tree within the
+///         forest linked by the \a ancestors, the path is compressed along the evaluation.
+static uint32 evaluate(uint32 node, uint32 *ancestors, uint32 *labels, const uint32 *semis, uint32 *path) {
+    if (ancestors[node] == HeapSnapshot::NO_OBJECT) return node;
+    // The path is compressed from the object closest to the root, which is the order of the recursive compression.
+    uint32 path_length = 0, current = node;
+    while (ancestors[ancestors[current]] != HeapSnapshot::NO_OBJECT) {
+        path[path_length++] = current;
+        current = ancestors[current];
+    }
+    while (path_length) {
+        current = path[--path_length];
+        uint32 ancestor = ancestors[current];
+        if (semis[labels[ancestor]] < semis[labels[current]]) labels[current] = labels[ancestor];
+        ancestors[current] = ancestors[ancestor];
+    }
+    return labels[node];
+}
+
+void HeapSnapshot::compute_dominators() {
+    uint32 count = this->object_count;
+    uint64 reference_count = this->reference_offsets[count];
+
+    // The predecessors of each object, laid out in the same way as the references.
+    auto *predecessor_offsets = reallocate<uint64>(nullptr, 0, static_cast<uint64>(count) + 1);
+    memset(predecessor_offsets, 0, (static_cast<uint64>(count) + 1) * sizeof(uint64));
+    for (uint64 reference = 0; reference < reference_count; reference++) {
+        if (this->references[reference] != NO_OBJECT) predecessor_offsets[this->references[reference] + 1]++;
+    }
+    for (uint32 index = 0; index < count; index++) predecessor_offsets[index + 1] += predecessor_offsets[index];
+    auto *predecessors = reallocate<uint32>(nullptr, 0, predecessor_offsets[count] + 1);
+    auto *cursors = reallocate<uint64>(nullptr, 0, count);
+    memcpy(cursors, predecessor_offsets, count * sizeof(uint64));
+    for (uint32 index = 0; index < count; index++) {
+        for (uint64 reference = this->reference_offsets[index]; reference < this->reference_offsets[index + 1];
+             reference++) {
+            uint32 target = this->references[reference];
+            if (target != NO_OBJECT) predecessors[cursors[target]++] = index;
+        }
+    }
+
+    // Number the objects reachable from the virtual root in the depth first order.
+    auto *numbers = reallocate<uint32>(nullptr, 0, count);
+    auto *order = reallocate<uint32>(nullptr, 0, count);
+    auto *parents = reallocate<uint32>(nullptr, 0, count);
+    auto *stack = reallocate<uint32>(nullptr, 0, count);
+    memset(numbers, 0xFF, count * sizeof(uint32));
+    uint32 reached = 1, depth = 1;
+    numbers[0] = 0;
+    order[0] = 0;
+    parents[0] = NO_OBJECT;
+    stack[0] = 0;
+    cursors[0] = this->reference_offsets[0];
+    while (depth) {
+        uint32 current = stack[depth - 1];
+        if (cursors[current] == this->reference_offsets[current + 1]) {
+            depth--;
+            continue;
+        }
+        uint32 target = this->references[cursors[current]++];
+        if (target == NO_OBJECT || numbers[target] != NO_OBJECT) continue;
+        numbers[target] = reached;
+        order[reached++] = target;
+        parents[target] = current;
+        cursors[target] = this->reference_offsets[target];
+        stack[depth++] = target;
+    }
+
+    // The semi-dominators are computed in the reverse depth first order, with the forest of the processed objects
+    // linked by the ancestors and evaluated with the path compression. The semi-dominators are held as the numbers of
+    // the objects, which start from the numbers themselves thus the array of the numbers is reused.
+    uint32 *semis = numbers;
+    auto *labels = reallocate<uint32>(nullptr, 0, count);
+    auto *ancestors = reallocate<uint32>(nullptr, 0, count);
+    auto *bucket_heads = reallocate<uint32>(nullptr, 0, count);
+    auto *bucket_links = reallocate<uint32>(nullptr, 0, count);
+    this->dominators = reallocate<uint32>(nullptr, 0, count);
+    for (uint32 index = 0; index < count; index++) {
+        labels[index] = index;
+        ancestors[index] = NO_OBJECT;
+        bucket_heads[index] = NO_OBJECT;
+        this->dominators[index] = NO_OBJECT;
+    }
+    // The stack is reused as the path of the compression.
+    uint32 *path = stack;
+    for (uint32 number = reached - 1; number > 0; number--) {
+        uint32 current = order[number];
+        for (uint64 offset = predecessor_offsets[current]; offset < predecessor_offsets[current + 1]; offset++) {
+            uint32 predecessor = predecessors[offset];
+            if (numbers[predecessor] == NO_OBJECT) continue;
+            uint32 evaluated = evaluate(predecessor, ancestors, labels, semis, path);
+            if (semis[evaluated] < semis[current]) semis[current] = semis[evaluated];
+        }
+        uint32 semi_dominator = order[semis[current]];
+        bucket_links[current] = bucket_heads[semi_dominator];
+        bucket_heads[semi_dominator] = current;
+
+        uint32 parent = parents[current];
+        ancestors[current] = parent;
+        for (uint32 bucketed = bucket_heads[parent]; bucketed != NO_OBJECT; bucketed = bucket_links[bucketed]) {
+            uint32 evaluated = evaluate(bucketed, ancestors, labels, semis, path);
+            this->dominators[bucketed] = semis[evaluated] < semis[bucketed] ? evaluated : parent;
+        }
+        bucket_heads[parent] = NO_OBJECT;
+    }
+    for (uint32 number = 1; number < reached; number++) {
+        uint32 current = order[number];
+        if (this->dominators[current] != order[semis[current]])
+            this->dominators[current] = this->dominators[this->dominators[current]];
+    }
+
+    // The retained sizes are accumulated into the dominators in the reverse depth first order, as a dominator is
+    // always numbered before the objects it dominates.
+    this->retained_sizes = reallocate<uint64>(nullptr, 0, count);
+    memcpy(this->retained_sizes, this->capacities, count * sizeof(uint64));
+    for (uint32 number = reached - 1; number > 0; number--) {
+        uint32 current = order[number];
+        this->retained_sizes[this->dominators[current]] += this->retained_sizes[current];
+    }
+
+    os::free(predecessor_offsets);
+    os::free(predecessors);
+    os::free(cursors);
+    os::free(numbers);
+    os::free(order);
+    os::free(parents);
+    os::free(stack);
+    os::free(labels);
+    os::free(ancestors);
+    os::free(bucket_heads);
+    os::free(bucket_links);
+}
+
+uint32 HeapSnapshot::get_object_count() const { return this->object_count; }
+
+uint64 HeapSnapshot::get_identity(uint32 index) const { return this->identities[index]; }
+
+uint32 HeapSnapshot::get_size(uint32 index) const { return this->sizes[index]; }
+
+uint64 HeapSnapshot::get_capacity(uint32 index) const { return this->capacities[index]; }
+
+uint32 HeapSnapshot::get_dominator(uint32 index) const { return this->dominators[index]; }
+
+uint64 HeapSnapshot::get_retained_size(uint32 index) const { return this->retained_sizes[index]; }
+
+uint32 HeapSnapshot::get_reference_count(uint32 index) const {
+    return static_cast<uint32>(this->reference_offsets[index + 1] - this->reference_offsets[index]);
+}
+
+uint32 HeapSnapshot::get_reference(uint32 index, uint32 nth) const {
+    return this->references[this->reference_offsets[index] + nth];
+}
@@ -0,0 +1,185 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_SNAPSHOT_HPP
+#define VEIL_FABRIC_SRC_MEMORY_SNAPSHOT_HPP
+
+#include <cstdio>
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/vm/structures.hpp"
+
+namespace veil::memory {
+
+    /// The request as a parameter for writing a heap snapshot with \c TracingAllocator::snapshot.
+    class HeapSnapshotRequest : public vm::Request {
+    public:
+        /// The path of the snapshot file to be written.
+        const char *const path;
+
+        /// \param path The path of the snapshot file to be written.
+        explicit HeapSnapshotRequest(const char *path);
+
+        /// \return The number of the objects written without their references, as they are held by other allocators.
+        [[nodiscard]] uint64 get_skipped_count() const;
+
+    private:
+        /// The number of the skipped objects, a returned parameter of the request.
+        uint64 skipped_count = 0;
+
+        // Allow the tracing allocators to return the number of the skipped objects.
+        friend class TracingAllocator;
+    };
+
+    /// The binary format of a heap snapshot, the file starts with the 8 bytes of \c HeapSnapshotFormat::MAGIC followed
+    /// by the format version as a variable length integer, then a sequence of records each starting with its tag:
+    /// <ul>
+    ///     <li> \c TAG_ROOT: the identity of a root. </li>
+    ///     <li> \c TAG_OBJECT: the identity, the size and the capacity of an object. </li>
+    ///     <li> \c TAG_REFERENCE: the identity of an object referenced by the preceding object. </li>
+    ///     <li> \c TAG_END: the numbers of the roots, the objects and the references, which terminates the file. </li>
+    /// </ul>
+    /// The identity of an object is the address of its \c Pointer, which is stable for the lifetime of the object. The
+    /// integers are encoded as LEB128 variable length integers, while an identity is encoded as the zigzag encoded
+    /// difference from the identity of the preceding root, the preceding object, or the referencing object for a
+    /// reference; as the neighbouring pointers are often allocated closely, most identities take 1 to 3 bytes.
+    struct HeapSnapshotFormat {
+        static const uint32 VERSION = 1;
+        static const uint32 MAGIC_SIZE = 8;
+        static const char MAGIC[MAGIC_SIZE + 1];
+
+        static const uint8 TAG_END = 0;
+        static const uint8 TAG_ROOT = 1;
+        static const uint8 TAG_OBJECT = 2;
+        static const uint8 TAG_REFERENCE = 3;
+    };
+
+    /// Writes a heap snapshot as a stream of records through a fixed size buffer, thus the memory used by the writer is
+    /// independent of the size of the heap.
+    class HeapSnapshotWriter : public ValueObject {
+    public:
+        static const uint32 BUFFER_SIZE = 64 * 1024;
+
+        HeapSnapshotWriter();
+
+        /// The file is closed if it is still open.
+        ~HeapSnapshotWriter();
+
+        /// Create the snapshot file at \a path and write the header.
+        /// \return Whether the file is created.
+        bool open(const char *path);
+
+        void write_root(const Pointer *pointer);
+
+        /// Write an object, the subsequent references are the references of this object.
+        /// \param pointer  The pointer of the object.
+        /// \param capacity The byte size of the memory sector occupied by the object.
+        void write_object(const Pointer *pointer, uint64 capacity);
+
+        /// Write a reference of the last written object.
+        void write_reference(const Pointer *pointer);
+
+        /// Write the end record and close the file.
+        /// \return Whether all records are written successfully.
+        bool close();
+
+    private:
+        FILE *file;
+        uint8 *buffer;
+        uint32 buffered;
+        bool failed;
+        uint64 last_root;
+        uint64 last_object;
+        uint64 root_count;
+        uint64 object_count;
+        uint64 reference_count;
+
+        void write_byte(uint8 value);
+
+        void write_varint(uint64 value);
+
+        /// Write the identity of the \a pointer as the difference from the \a base identity.
+        void write_identity(const Pointer *pointer, uint64 base);
+
+        void flush();
+    };
+
+    /// A heap snapshot loaded for the offline analysis, the objects are indexed in the order they are written while
+    /// the index 0 is reserved for a virtual root which references all roots of the heap. The dominator tree is
+    /// computed with the Lengauer-Tarjan algorithm in O(E log V), and the retained size of an object is the total
+    /// capacity of the objects it dominates including itself, which is the size reclaimed if the object becomes
+    /// unreachable.
+    class HeapSnapshot : public ValueObject {
+    public:
+        /// The index of an absent object.
+        static const uint32 NO_OBJECT = UINT32_MAX;
+
+        HeapSnapshot();
+
+        ~HeapSnapshot();
+
+        /// Load the snapshot file at \a path and compute its dominator tree.
+        /// \return Whether the file is a valid snapshot.
+        bool load(const char *path);
+
+        /// \return The number of the objects including the virtual root.
+        [[nodiscard]] uint32 get_object_count() const;
+
+        /// \return The identity of the object at the \a index, 0 for the virtual root.
+        [[nodiscard]] uint64 get_identity(uint32 index) const;
+
+        [[nodiscard]] uint32 get_size(uint32 index) const;
+
+        [[nodiscard]] uint64 get_capacity(uint32 index) const;
+
+        /// \return The index of the immediate dominator of the object, \c HeapSnapshot::NO_OBJECT for the virtual root
+        ///         and the objects unreachable from the roots.
+        [[nodiscard]] uint32 get_dominator(uint32 index) const;
+
+        [[nodiscard]] uint64 get_retained_size(uint32 index) const;
+
+        /// \return The number of the references of the object at the \a index.
+        [[nodiscard]] uint32 get_reference_count(uint32 index) const;
+
+        /// \return The index of the \a nth reference of the object at the \a index.
+        [[nodiscard]] uint32 get_reference(uint32 index, uint32 nth) const;
+
+    private:
+        uint32 object_count;
+        uint64 *identities;
+        uint32 *sizes;
+        uint64 *capacities;
+        /// The references of the object at an index are within [reference_offsets[index], reference_offsets[index + 1])
+        /// of \c HeapSnapshot::references.
+        uint64 *reference_offsets;
+        uint32 *references;
+        uint32 *dominators;
+        uint64 *retained_sizes;
+
+        /// Release the arrays of the loaded snapshot.
+        void clear();
+
+        /// Resolve the identities of the \a targets of the references into the indices of the objects, a reference to
+        /// an object absent from the snapshot is resolved to \c HeapSnapshot::NO_OBJECT.
+        void resolve(const uint64 *targets, uint64 reference_count);
+
+        void compute_dominators();
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_SNAPSHOT_HPP
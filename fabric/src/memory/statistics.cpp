@@ -0,0 +1,104 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <new>
+
+#include "src/memory/statistics.hpp"
+#include "src/memory/os.hpp"
+
+using namespace veil::memory;
+
+AllocatorStatistics::AllocatorStatistics() :
+        allocated_size(0), allocation_count(0), freed_size(0), free_count(0), pending_allocated_size(0),
+        pending_freed_size(0), pending_allocation_count(0), pending_free_count(0), pending_class_counts(),
+        next(nullptr) {
+    this->class_counts = static_cast<os::atomic_u64_t *>(os::malloc(SIZE_CLASS_COUNT * sizeof(os::atomic_u64_t)));
+    for (uint32 index = 0; index < SIZE_CLASS_COUNT; index++) new(&this->class_counts[index]) os::atomic_u64_t(0);
+}
+
+AllocatorStatistics::~AllocatorStatistics() { os::free(this->class_counts); }
+
+void AllocatorStatistics::publish() {
+    (void) this->allocated_size.fetch_add(this->pending_allocated_size);
+    (void) this->allocation_count.fetch_add(this->pending_allocation_count);
+    (void) this->freed_size.fetch_add(this->pending_freed_size);
+    (void) this->free_count.fetch_add(this->pending_free_count);
+    for (uint32 index = 0; index < SIZE_CLASS_COUNT; index++) {
+        if (!this->pending_class_counts[index]) continue;
+        (void) this->class_counts[index].fetch_add(this->pending_class_counts[index]);
+        this->pending_class_counts[index] = 0;
+    }
+    this->pending_allocated_size = 0;
+    this->pending_allocation_count = 0;
+    this->pending_freed_size = 0;
+    this->pending_free_count = 0;
+}
+
+uint64 AllocatorStatistics::get_allocated_size() const { return this->allocated_size.load(); }
+
+uint64 AllocatorStatistics::get_allocation_count() const { return this->allocation_count.load(); }
+
+uint64 AllocatorStatistics::get_freed_size() const { return this->freed_size.load(); }
+
+uint64 AllocatorStatistics::get_free_count() const { return this->free_count.load(); }
+
+uint64 AllocatorStatistics::get_class_count(uint32 size_class) const {
+    return size_class < SIZE_CLASS_COUNT ? this->class_counts[size_class].load() : 0;
+}
+
+CollectionStatistics::CollectionStatistics() :
+        collection_count(0), collection_time(0), max_collection_time(0), collected_size(0), copied_size(0) {}
+
+void CollectionStatistics::record_collection(uint64 duration) {
+    (void) this->collection_count.fetch_add(1);
+    (void) this->collection_time.fetch_add(duration);
+    uint64 longest = this->max_collection_time.load();
+    while (longest < duration) {
+        uint64 witnessed = this->max_collection_time.compare_exchange(longest, duration);
+        if (witnessed == longest) break;
+        longest = witnessed;
+    }
+}
+
+void CollectionStatistics::record_collected(uint64 capacity) { (void) this->collected_size.fetch_add(capacity); }
+
+void CollectionStatistics::record_copy(uint64 capacity, uint64 copied_capacity) {
+    // The original memory sector of the copied object is reclaimed along the copy.
+    (void) this->collected_size.fetch_add(capacity);
+    (void) this->copied_size.fetch_add(copied_capacity);
+}
+
+uint64 CollectionStatistics::get_collection_count() const { return this->collection_count.load(); }
+
+uint64 CollectionStatistics::get_collection_time() const { return this->collection_time.load(); }
+
+uint64 CollectionStatistics::get_max_collection_time() const { return this->max_collection_time.load(); }
+
+uint64 CollectionStatistics::get_collected_size() const { return this->collected_size.load(); }
+
+uint64 CollectionStatistics::get_copied_size() const { return this->copied_size.load(); }
+
+uint64 HeapStatistics::get_live_size() const {
+    uint64 gained = this->allocated_size + this->copied_size + this->large_size;
+    uint64 lost = this->freed_size + this->collected_size;
+    // The pending records of the allocators might leave the reclamations ahead of the allocations.
+    return gained > lost ? gained - lost : 0;
+}
+
+double HeapStatistics::get_fragmentation() const {
+    if (!this->mapped_size) return 0;
+    uint64 live = this->get_live_size();
+    return live >= this->mapped_size ? 0 : 1 - static_cast<double>(live) / static_cast<double>(this->mapped_size);
+}
@@ -0,0 +1,185 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_STATISTICS_HPP
+#define VEIL_FABRIC_SRC_MEMORY_STATISTICS_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/util/bits.hpp"
+
+#if defined(VEIL_ENABLE_PROFILING)
+#include "src/memory/profiling.hpp"
+#endif
+
+namespace veil::memory {
+
+    /// The statistics of the memory sectors allocated and freed by an \c Allocator. The statistics are recorded by the
+    /// thread owning the allocator into plain counters, which are published to the atomic counters every
+    /// \c AllocatorStatistics::PUBLISH_INTERVAL records; thus the recording is cheap while another thread is able to
+    /// read the published counters at any time, which lag behind by less than the interval.
+    /// <br><br>
+    /// The sizes are accounted by the capacities of the memory sectors, and counted by the power of 2 size classes in
+    /// the histogram: the size class \c i accounts the capacities within (2^(i-1), 2^i].
+    class AllocatorStatistics : public ValueObject {
+    public:
+        /// The number of the size classes of the histogram, the largest class accounts the capacities up to 4GiB.
+        static const uint32 SIZE_CLASS_COUNT = 33;
+        /// The number of the records between the publications of the counters.
+        static const uint32 PUBLISH_INTERVAL = 64;
+
+        AllocatorStatistics();
+
+        ~AllocatorStatistics();
+
+        /// Record the allocation of a memory sector of the \a capacity, only invoked by the thread owning the
+        /// allocator.
+        inline void record_allocation(uint64 capacity);
+
+        /// Record the release of a memory sector of the \a capacity by the allocator, for example by
+        /// \c Allocator::reserve; only invoked by the thread owning the allocator.
+        inline void record_free(uint64 capacity);
+
+        /// Publish the pending records, only invoked by the thread owning the allocator.
+        void publish();
+
+        [[nodiscard]] uint64 get_allocated_size() const;
+
+        [[nodiscard]] uint64 get_allocation_count() const;
+
+        [[nodiscard]] uint64 get_freed_size() const;
+
+        [[nodiscard]] uint64 get_free_count() const;
+
+        /// \return The number of the allocations of the \a size_class.
+        [[nodiscard]] uint64 get_class_count(uint32 size_class) const;
+
+        /// \return The size class of the \a capacity.
+        static inline uint32 size_class_of(uint64 capacity);
+
+    private:
+        os::atomic_u64_t allocated_size;
+        os::atomic_u64_t allocation_count;
+        os::atomic_u64_t freed_size;
+        os::atomic_u64_t free_count;
+        /// The published allocation counts of the size classes.
+        os::atomic_u64_t *class_counts;
+
+        uint64 pending_allocated_size;
+        uint64 pending_freed_size;
+        uint32 pending_allocation_count;
+        uint32 pending_free_count;
+        uint32 pending_class_counts[SIZE_CLASS_COUNT];
+
+        /// The next statistics within the registry of the \c Management.
+        AllocatorStatistics *next;
+
+        friend class Allocator;
+
+        friend class Management;
+    };
+
+    inline uint32 AllocatorStatistics::size_class_of(uint64 capacity) {
+        if (capacity <= 1) return 0;
+        uint32 size_class = 64 - util::count_leading_zeros(capacity - 1);
+        return size_class < SIZE_CLASS_COUNT ? size_class : SIZE_CLASS_COUNT - 1;
+    }
+
+    inline void AllocatorStatistics::record_allocation(uint64 capacity) {
+#       if defined(VEIL_ENABLE_PROFILING)
+        // The allocations of all allocators are recorded here, thus they are sampled at this single point.
+        AllocationSampler::sample(capacity);
+#       endif
+        this->pending_allocated_size += capacity;
+        this->pending_class_counts[size_class_of(capacity)]++;
+        if (++this->pending_allocation_count + this->pending_free_count >= PUBLISH_INTERVAL) this->publish();
+    }
+
+    inline void AllocatorStatistics::record_free(uint64 capacity) {
+        this->pending_freed_size += capacity;
+        if (this->pending_allocation_count + ++this->pending_free_count >= PUBLISH_INTERVAL) this->publish();
+    }
+
+    /// The statistics of the collections performed by a garbage collecting \c Algorithm, recorded by the collector
+    /// and the allocators sweeping on demand.
+    class CollectionStatistics : public ValueObject {
+    public:
+        CollectionStatistics();
+
+        /// Record a collection which took the \a duration in nanoseconds.
+        void record_collection(uint64 duration);
+
+        /// Record the reclamation of the dead objects of the total \a capacity.
+        void record_collected(uint64 capacity);
+
+        /// Record the copy of a surviving object of the \a capacity into a memory sector of the \a copied_capacity,
+        /// which is allocated by the collector itself.
+        void record_copy(uint64 capacity, uint64 copied_capacity);
+
+        [[nodiscard]] uint64 get_collection_count() const;
+
+        /// \return The total nanoseconds of the collections.
+        [[nodiscard]] uint64 get_collection_time() const;
+
+        /// \return The nanoseconds of the longest collection.
+        [[nodiscard]] uint64 get_max_collection_time() const;
+
+        [[nodiscard]] uint64 get_collected_size() const;
+
+        [[nodiscard]] uint64 get_copied_size() const;
+
+    private:
+        os::atomic_u64_t collection_count;
+        os::atomic_u64_t collection_time;
+        os::atomic_u64_t max_collection_time;
+        os::atomic_u64_t collected_size;
+        os::atomic_u64_t copied_size;
+    };
+
+    /// A snapshot of the heap usage of a \c Management taken by \c Management::get_statistics, which reads the
+    /// published counters without stopping the world; thus the counters are individually consistent while the snapshot
+    /// as a whole is not.
+    struct HeapStatistics {
+        /// The byte size of the heap memory sections mapped from the host, including the large-object space.
+        uint64 mapped_size = 0;
+        /// The byte size of the objects within the large-object space.
+        uint64 large_size = 0;
+        /// The total byte size allocated by all allocators.
+        uint64 allocated_size = 0;
+        uint64 allocation_count = 0;
+        /// The total byte size freed explicitly through all allocators.
+        uint64 freed_size = 0;
+        /// The allocation counts of the size classes of \c AllocatorStatistics.
+        uint64 class_counts[AllocatorStatistics::SIZE_CLASS_COUNT] = {};
+        /// The total byte size of the dead objects reclaimed by the collections.
+        uint64 collected_size = 0;
+        /// The total byte size allocated by the collections for the copies of the surviving objects.
+        uint64 copied_size = 0;
+        uint64 collection_count = 0;
+        /// The total and the longest nanoseconds of the collections.
+        uint64 collection_time = 0;
+        uint64 max_collection_time = 0;
+
+        /// \return The byte size of the objects which are neither freed nor collected.
+        [[nodiscard]] uint64 get_live_size() const;
+
+        /// \return The fraction of the mapped heap not occupied by the live objects, within [0, 1].
+        [[nodiscard]] double get_fragmentation() const;
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_STATISTICS_HPP
@@ -0,0 +1,551 @@
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "src/core/runtime.hpp"
+#include "src/memory/management.hpp"
+#include "src/memory/mark-sweep.hpp"
+#include "src/memory/parallel-marker.hpp"
+#include "src/memory/snapshot.hpp"
+#include "src/threading/scheduler.hpp"
+
+using namespace veil::memory;
+
+/// The test objects are nodes of linked lists, laid out as [Pointer *next][uint64 value].
+struct Node {
+    Pointer *next;
+    uint64 value;
+};
+
+class NodeScanner : public ReferenceScanner {
+public:
+    void scan(Pointer &pointer, uint8 *address, veil::vm::Consumer<Pointer *> &visitor) override {
+        visitor.execute(reinterpret_cast<Node *>(address)->next);
+    }
+};
+
+Node *acquire(TracingAllocator &allocator, Pointer *pointer, bool exclusive) {
+    PointerAcquireRequest request(pointer, exclusive);
+    allocator.acquire(request);
+    return reinterpret_cast<Node *>(request.get_address());
+}
+
+void release(TracingAllocator &allocator, Pointer *pointer) {
+    PointerActionRequest request(pointer);
+    allocator.release(request);
+}
+
+/// Allocate a node and link it after the \a head, which is acquired exclusively by the caller.
+Pointer *push(TracingAllocator &allocator, Node *head, uint64 value) {
+    AllocateRequest request(sizeof(Node));
+    Pointer *pointer = allocator.allocate(request);
+    Node *node = acquire(allocator, pointer, true);
+    node->next = head->next;
+    node->value = value;
+    release(allocator, pointer);
+    head->next = pointer;
+    return pointer;
+}
+
+/// \return The number of nodes after the \a head whose values are not consecutively decreasing down to 1.
+uint32 verify(TracingAllocator &allocator, Pointer *head) {
+    uint32 corrupted = 0;
+    Node *node = acquire(allocator, head, false);
+    Pointer *current = node->next;
+    release(allocator, head);
+    uint64 expected = 0;
+    while (current) {
+        node = acquire(allocator, current, false);
+        if (expected && node->value != expected - 1) corrupted++;
+        expected = node->value;
+        Pointer *next = node->next;
+        release(allocator, current);
+        current = next;
+    }
+    if (expected != 1) corrupted++;
+    return corrupted;
+}
+
+Pointer *new_root(TracingAllocator &allocator) {
+    AllocateRequest request(sizeof(Node));
+    Pointer *root = allocator.allocate(request);
+    PointerActionRequest root_request(root);
+    allocator.add_root(root_request);
+    Node *node = acquire(allocator, root, true);
+    node->next = nullptr;
+    node->value = 0;
+    release(allocator, root);
+    return root;
+}
+
+const uint32 ITERATION_COUNT = 20000;
+const uint32 LIST_LENGTH = 256;
+
+void mutate(TracingAllocator *allocator, uint32 *corrupted) {
+    Pointer *root = new_root(*allocator);
+    for (uint32 i = 0; i < ITERATION_COUNT; i++) {
+        Node *head = acquire(*allocator, root, true);
+        // The list is dropped periodically to produce garbage.
+        if (head->value == LIST_LENGTH) {
+            head->next = nullptr;
+            head->value = 0;
+        }
+        push(*allocator, head, ++head->value);
+        release(*allocator, root);
+    }
+    *corrupted = verify(*allocator, root);
+}
+
+const uint32 ROTATION_COUNT = 1 << 20;
+const uint32 ROTATION_PERIOD = 4096;
+
+/// Rotate the reference to a young target node through a fresh holder node per iteration, the previous holder is
+/// dropped once the fresh one is linked; thus a condemned target is soon only referenced by a holder allocated after
+/// its condemnation. A new target is linked before the previous one periodically, as the previous one is no longer
+/// condemned once promoted; the root, the holder and the targets form a list verifiable by \c verify.
+/// \return The root of the list.
+Pointer *rotate(TracingAllocator *allocator) {
+    Pointer *root = new_root(*allocator);
+    Pointer *target = nullptr;
+    for (uint32 i = 0; i < ROTATION_COUNT; i++) {
+        uint64 target_value = i / ROTATION_PERIOD + 1;
+        if (i % ROTATION_PERIOD == 0) {
+            AllocateRequest target_request(sizeof(Node));
+            Pointer *previous = target;
+            target = allocator->allocate(target_request);
+            Node *node = acquire(*allocator, target, true);
+            node->next = previous;
+            node->value = target_value;
+            release(*allocator, target);
+        }
+        AllocateRequest holder_request(sizeof(Node));
+        Pointer *holder = allocator->allocate(holder_request);
+        Node *node = acquire(*allocator, holder, true);
+        node->next = target;
+        node->value = target_value + 1;
+        release(*allocator, holder);
+        Node *head = acquire(*allocator, root, true);
+        head->next = holder;
+        release(*allocator, root);
+    }
+    return root;
+}
+
+const uint32 GROUP_SIZE = 8;
+
+/// Increment the values of the \a counters acquired in a batch, each thread lists the group in a different order.
+void increment_batch(TracingAllocator *allocator, Pointer **counters, uint32 offset, uint32 iteration_count) {
+    Pointer *group[GROUP_SIZE];
+    uint8 *addresses[GROUP_SIZE];
+    for (uint32 i = 0; i < iteration_count; i++) {
+        for (uint32 j = 0; j < GROUP_SIZE; j++) group[j] = counters[(j + offset) % GROUP_SIZE];
+        PointerBatchAcquireRequest acquire_request(group, GROUP_SIZE, addresses, true);
+        allocator->acquire_batch(acquire_request);
+        for (uint32 j = 0; j < GROUP_SIZE; j++) reinterpret_cast<Node *>(acquire_request.get_address(j))->value++;
+        PointerBatchReleaseRequest release_request(group, GROUP_SIZE);
+        allocator->release_batch(release_request);
+        // The garbage keeps the collector marking while the counters are acquired.
+        AllocateRequest garbage_request(sizeof(Node));
+        allocator->allocate(garbage_request);
+    }
+}
+
+/// \return The index of the object of the \a pointer within the \a snapshot, or \c HeapSnapshot::NO_OBJECT.
+uint32 index_of(HeapSnapshot &snapshot, const Pointer *pointer) {
+    for (uint32 index = 1; index < snapshot.get_object_count(); index++)
+        if (snapshot.get_identity(index) == reinterpret_cast<uint64>(pointer)) return index;
+    return HeapSnapshot::NO_OBJECT;
+}
+
+int main() {
+    veil::Runtime runtime;
+    MarkSweepAlgorithm algorithm;
+    NodeScanner scanner;
+    MarkSweepParams params(&scanner, 100, 1024 * 1024);
+    MemoryInitRequest init_request(64 * 1024 * 1024, &algorithm, &params);
+    Management *management = Management::new_instance(runtime, init_request);
+
+    veil::vm::Request allocator_request;
+    auto *allocator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+
+    std::cout << "Begin test on rooted list across collections, expects: corrupted = 0" << std::endl;
+    Pointer *root = new_root(*allocator);
+    {
+        Node *head = acquire(*allocator, root, true);
+        for (uint32 i = 1; i <= 4096; i++) {
+            push(*allocator, head, i);
+            AllocateRequest garbage_request(sizeof(Node) + i % 512);
+            allocator->allocate(garbage_request);
+        }
+        release(*allocator, root);
+    }
+    veil::vm::Request collect_request;
+    allocator->collect(collect_request);
+    allocator->collect(collect_request);
+    std::cout << "Test result: corrupted = " << verify(*allocator, root) << std::endl;
+
+    std::cout << "Begin test on bias after collection, expects: biased = 4097" << std::endl;
+    {
+        // The collector scanned every node of the list, while the biases towards the allocator are restored.
+        uint32 biased = 0;
+        Pointer *current = root;
+        while (current) {
+            if (static_cast<MarkSweepPointer *>(current)->is_biased()) biased++;
+            Node *node = acquire(*allocator, current, false);
+            Pointer *next = node->next;
+            release(*allocator, current);
+            current = next;
+        }
+        std::cout << "Test result: biased = " << biased << std::endl;
+    }
+
+    std::cout << "Begin test on garbage reclamation, expects: error = 0" << std::endl;
+    uint32 error = 0;
+    for (uint32 i = 0; i < 1024 * 1024 && !error; i++) {
+        // Allocate 1.25GiB in total, which is only possible if the garbage is reclaimed within the 64MiB heap.
+        AllocateRequest garbage_request(i % 64 ? 256 : 64 * 1024);
+        allocator->allocate(garbage_request);
+        error = garbage_request.get_error();
+        if (i % 16384 == 0) allocator->collect(collect_request);
+    }
+    std::cout << "Test result: error = " << error << std::endl;
+
+    std::cout << "Begin test on collection statistics, expects: collected = 1, timed = 1, live = 1" << std::endl;
+    {
+        HeapStatistics statistics;
+        management->get_statistics(statistics);
+        std::cout << "Test result: collected = " << (statistics.collected_size > 0) << ", timed = "
+                  << (statistics.collection_count > 0 && statistics.max_collection_time > 0 &&
+                      statistics.collection_time >= statistics.max_collection_time) << ", live = "
+                  << (statistics.get_live_size() <= statistics.mapped_size) << std::endl;
+    }
+
+    const uint32 THREAD_COUNT = 4;
+    std::cout << "Begin test on concurrent mutation, expects: corrupted = 0" << std::endl;
+    {
+        std::vector<std::thread> threads;
+        uint32 corrupted[THREAD_COUNT];
+        for (uint32 i = 0; i < THREAD_COUNT; i++) {
+            auto *mutator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+            threads.emplace_back(mutate, mutator, &corrupted[i]);
+        }
+        std::atomic<bool> running(true);
+        std::thread requester([&]() {
+            auto *requester_allocator = static_cast<TracingAllocator *>(
+                    management->create_allocator(allocator_request));
+            veil::vm::Request request;
+            while (running.load()) requester_allocator->collect(request);
+        });
+        for (std::thread &thread: threads) thread.join();
+        running.store(false);
+        requester.join();
+
+        uint32 total = verify(*allocator, root);
+        for (uint32 count: corrupted) total += count;
+        std::cout << "Test result: corrupted = " << total << std::endl;
+    }
+
+    std::cout << "Begin test on batch acquisition, expects: count = " << GROUP_SIZE * ITERATION_COUNT * THREAD_COUNT
+              << std::endl;
+    {
+        Pointer *counters[GROUP_SIZE];
+        for (Pointer *&counter: counters) counter = new_root(*allocator);
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++) {
+            auto *mutator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+            threads.emplace_back(increment_batch, mutator, counters, i * 3, ITERATION_COUNT);
+        }
+        std::atomic<bool> running(true);
+        std::thread requester([&]() {
+            auto *requester_allocator = static_cast<TracingAllocator *>(
+                    management->create_allocator(allocator_request));
+            veil::vm::Request request;
+            while (running.load()) requester_allocator->collect(request);
+        });
+        for (std::thread &thread: threads) thread.join();
+        running.store(false);
+        requester.join();
+
+        uint64 count = 0;
+        for (Pointer *counter: counters) {
+            count += acquire(*allocator, counter, false)->value;
+            release(*allocator, counter);
+        }
+        std::cout << "Test result: count = " << count << std::endl;
+    }
+
+    std::cout << "Begin test on heap snapshot, expects: error = 0, loaded = 1, retained = 101, dominated = 1"
+              << std::endl;
+    {
+        Pointer *root = new_root(*allocator);
+        Node *head = acquire(*allocator, root, true);
+        for (uint32 i = 1; i <= 100; i++) push(*allocator, head, i);
+        Pointer *first = head->next;
+        release(*allocator, root);
+
+        HeapSnapshotRequest snapshot_request("mark_sweep_test.heap");
+        allocator->snapshot(snapshot_request);
+        HeapSnapshot snapshot;
+        bool loaded = snapshot.load("mark_sweep_test.heap");
+        std::remove("mark_sweep_test.heap");
+        uint32 root_index = loaded ? index_of(snapshot, root) : HeapSnapshot::NO_OBJECT;
+        uint32 first_index = loaded ? index_of(snapshot, first) : HeapSnapshot::NO_OBJECT;
+        bool found = root_index != HeapSnapshot::NO_OBJECT && first_index != HeapSnapshot::NO_OBJECT;
+        std::cout << "Test result: error = " << snapshot_request.get_error() << ", loaded = " << found
+                  << ", retained = "
+                  << (found ? snapshot.get_retained_size(root_index) / snapshot.get_capacity(root_index) : 0)
+                  << ", dominated = " << (found && snapshot.get_dominator(first_index) == root_index) << std::endl;
+    }
+
+    std::cout << "Begin test on heap snapshot with foreign holders, expects: error = 0, skipped = 1" << std::endl;
+    {
+        // The holder does not release the pointer until the snapshot returns, thus the snapshot must not wait for it.
+        auto *holder = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+        Pointer *root = new_root(*allocator);
+        acquire(*holder, root, true);
+        HeapSnapshotRequest snapshot_request("mark_sweep_test.heap");
+        allocator->snapshot(snapshot_request);
+        std::remove("mark_sweep_test.heap");
+        release(*holder, root);
+        std::cout << "Test result: error = " << snapshot_request.get_error() << ", skipped = "
+                  << snapshot_request.get_skipped_count() << std::endl;
+    }
+
+    // The objects a, b, c, d form a diamond a -> (b, c) -> d, while e is referenced by d and the root f.
+    std::cout << "Begin test on dominator tree, expects: d = a, e = root, retained = 64, unreachable = 1" << std::endl;
+    {
+        Pointer a(16), b(16), c(16), d(16), e(16), f(16), g(16);
+        HeapSnapshotWriter writer;
+        writer.open("dominator_test.heap");
+        writer.write_root(&a);
+        writer.write_root(&f);
+        writer.write_object(&a, 16);
+        writer.write_reference(&b);
+        writer.write_reference(&c);
+        writer.write_object(&b, 16);
+        writer.write_reference(&d);
+        writer.write_object(&c, 16);
+        writer.write_reference(&d);
+        writer.write_object(&d, 16);
+        writer.write_reference(&e);
+        writer.write_object(&e, 16);
+        writer.write_object(&f, 16);
+        writer.write_reference(&e);
+        writer.write_object(&g, 16);
+        writer.write_reference(&a);
+        writer.close();
+        HeapSnapshot snapshot;
+        snapshot.load("dominator_test.heap");
+        std::remove("dominator_test.heap");
+        uint32 d_dominator = snapshot.get_dominator(index_of(snapshot, &d));
+        uint32 e_dominator = snapshot.get_dominator(index_of(snapshot, &e));
+        std::cout << "Test result: d = " << (d_dominator == index_of(snapshot, &a) ? "a" : "?") << ", e = "
+                  << (e_dominator == 0 ? "root" : "?") << ", retained = "
+                  << snapshot.get_retained_size(index_of(snapshot, &a)) << ", unreachable = "
+                  << (snapshot.get_dominator(index_of(snapshot, &g)) == HeapSnapshot::NO_OBJECT) << std::endl;
+    }
+
+    veil::vm::Request terminate_request;
+    Management::terminate(management, terminate_request);
+
+    // The nodes of 64 bytes fill 4096 cells per block, the allocator keeps 1 in 16 nodes of 8 blocks, thus the live
+    // nodes of the 7 retired blocks are evacuated into a single block, while the block owned by the allocator is not.
+    const uint32 SPARSE_COUNT = 8 * 4096;
+    const uint32 RELOCATED_COUNT = 7 * 4096 / 16;
+    std::cout << "Begin test on compaction, expects: corrupted = 0, relocated = " << RELOCATED_COUNT << std::endl;
+    {
+        MarkSweepParams compact_params(&scanner, 100, 1024 * 1024 * 1024, 25);
+        MemoryInitRequest compact_request(64 * 1024 * 1024, &algorithm, &compact_params);
+        management = Management::new_instance(runtime, compact_request);
+        allocator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+
+        root = new_root(*allocator);
+        std::unordered_map<Pointer *, uint8 *> addresses;
+        Node *head = acquire(*allocator, root, true);
+        for (uint32 i = 0; i < SPARSE_COUNT; i++) {
+            AllocateRequest node_request(64);
+            Pointer *pointer = allocator->allocate(node_request);
+            if (i % 16) continue;
+            Node *node = acquire(*allocator, pointer, true);
+            node->next = head->next;
+            node->value = i / 16 + 1;
+            addresses[pointer] = reinterpret_cast<uint8 *>(node);
+            release(*allocator, pointer);
+            head->next = pointer;
+        }
+        release(*allocator, root);
+
+        allocator->collect(collect_request);
+        uint32 relocated = 0;
+        for (auto &entry: addresses) {
+            PointerAcquireRequest acquire_request(entry.first);
+            allocator->acquire(acquire_request);
+            if (acquire_request.get_address() != entry.second) relocated++;
+            release(*allocator, entry.first);
+        }
+        std::cout << "Test result: corrupted = " << verify(*allocator, root) << ", relocated = " << relocated
+                  << std::endl;
+        Management::terminate(management, terminate_request);
+    }
+
+    std::cout << "Begin test on promotion, expects: corrupted = 0, promoted = 4096" << std::endl;
+    {
+        // The full collections are only triggered by the requests, while the minor collections are triggered by the
+        // nursery chunks of 256KiB filled up to 1MiB.
+        MarkSweepParams young_params(&scanner, 100, 1024 * 1024 * 1024, 0, 256 * 1024, 1024 * 1024);
+        MemoryInitRequest young_request(64 * 1024 * 1024, &algorithm, &young_params);
+        management = Management::new_instance(runtime, young_request);
+        allocator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+
+        root = new_root(*allocator);
+        std::unordered_map<Pointer *, uint8 *> addresses;
+        Node *head = acquire(*allocator, root, true);
+        for (uint32 i = 1; i <= 4096; i++) {
+            Pointer *pointer = push(*allocator, head, i);
+            addresses[pointer] = static_cast<MarkSweepPointer *>(pointer)->address;
+            AllocateRequest garbage_request(sizeof(Node) + i % 512);
+            allocator->allocate(garbage_request);
+        }
+        release(*allocator, root);
+
+        allocator->collect(collect_request);
+        uint32 promoted = 0;
+        for (auto &entry: addresses) {
+            PointerAcquireRequest acquire_request(entry.first);
+            allocator->acquire(acquire_request);
+            if (acquire_request.get_address() != entry.second) promoted++;
+            release(*allocator, entry.first);
+        }
+        std::cout << "Test result: corrupted = " << verify(*allocator, root) << ", promoted = " << promoted
+                  << std::endl;
+
+        std::cout << "Begin test on nursery reclamation, expects: error = 0" << std::endl;
+        error = 0;
+        for (uint32 i = 0; i < 1024 * 1024 && !error; i++) {
+            // The garbage of 256MiB is only reclaimed by the minor collections, as no full collection is triggered.
+            AllocateRequest garbage_request(256);
+            allocator->allocate(garbage_request);
+            error = garbage_request.get_error();
+        }
+        std::cout << "Test result: error = " << error << std::endl;
+
+        std::cout << "Begin test on concurrent mutation with nursery, expects: corrupted = 0" << std::endl;
+        std::vector<std::thread> threads;
+        uint32 corrupted[THREAD_COUNT];
+        for (uint32 i = 0; i < THREAD_COUNT; i++) {
+            auto *mutator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+            threads.emplace_back(mutate, mutator, &corrupted[i]);
+        }
+        for (std::thread &thread: threads) thread.join();
+        uint32 total = verify(*allocator, root);
+        for (uint32 count: corrupted) total += count;
+        std::cout << "Test result: corrupted = " << total << std::endl;
+
+        std::cout << "Begin test on references moved into fresh young objects, expects: corrupted = 0" << std::endl;
+        {
+            // The garbage keeps the minor collections running, and reuses the memory reclaimed by them.
+            auto *garbage_allocator = static_cast<TracingAllocator *>(
+                    management->create_allocator(allocator_request));
+            std::atomic<bool> rotating(true);
+            std::thread garbage_thread([&]() {
+                while (rotating.load()) {
+                    AllocateRequest garbage_request(sizeof(Node));
+                    garbage_allocator->allocate(garbage_request);
+                }
+            });
+            auto *rotator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+            Pointer *rotated = rotate(rotator);
+            rotating.store(false);
+            garbage_thread.join();
+            std::cout << "Test result: corrupted = " << verify(*rotator, rotated) << std::endl;
+        }
+        Management::terminate(management, terminate_request);
+    }
+
+    const uint32 DEQUE_COUNT = 1 << 16;
+    std::cout << "Begin test on work-stealing deque, expects: taken = " << DEQUE_COUNT << ", duplicated = 0"
+              << std::endl;
+    {
+        // The owner pushes and pops the indices of a table while the thieves steal, every index is taken once.
+        std::vector<Pointer> pointers(DEQUE_COUNT, Pointer(0));
+        std::vector<std::atomic<uint32>> taken(DEQUE_COUNT);
+        MarkDeque deque;
+        std::atomic<bool> running(true);
+        auto take = [&](Pointer *pointer) { taken[pointer - pointers.data()].fetch_add(1); };
+        std::vector<std::thread> thieves;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            thieves.emplace_back([&]() {
+                while (running.load() || !deque.is_empty()) {
+                    Pointer *pointer = deque.steal();
+                    if (pointer) take(pointer);
+                }
+            });
+        for (uint32 i = 0; i < DEQUE_COUNT; i++) {
+            deque.push(&pointers[i]);
+            if (i % 3 == 0) {
+                Pointer *pointer = deque.pop();
+                if (pointer) take(pointer);
+            }
+        }
+        while (Pointer *pointer = deque.pop()) take(pointer);
+        running.store(false);
+        for (std::thread &thief: thieves) thief.join();
+        uint32 total = 0, duplicated = 0;
+        for (std::atomic<uint32> &count: taken) {
+            total += count.load() ? 1 : 0;
+            duplicated += count.load() > 1 ? 1 : 0;
+        }
+        std::cout << "Test result: taken = " << total << ", duplicated = " << duplicated << std::endl;
+    }
+
+    std::cout << "Begin test on parallel marking, expects: corrupted = 0, error = 0" << std::endl;
+    {
+        veil::threading::Scheduler scheduler;
+        std::thread scheduler_thread([&scheduler]() { scheduler.start(); });
+        ParallelMarker marker(scheduler, THREAD_COUNT);
+        marker.start();
+
+        MarkSweepParams parallel_params(&scanner, 100, 1024 * 1024, 25, 0, 0, &marker);
+        MemoryInitRequest parallel_request(64 * 1024 * 1024, &algorithm, &parallel_params);
+        management = Management::new_instance(runtime, parallel_request);
+        allocator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+
+        root = new_root(*allocator);
+        Node *head = acquire(*allocator, root, true);
+        for (uint32 i = 1; i <= 65536; i++) {
+            push(*allocator, head, i);
+            AllocateRequest garbage_request(sizeof(Node) + i % 512);
+            allocator->allocate(garbage_request);
+        }
+        release(*allocator, root);
+        allocator->collect(collect_request);
+        uint32 corrupted_count = verify(*allocator, root);
+
+        std::vector<std::thread> threads;
+        uint32 corrupted[THREAD_COUNT];
+        for (uint32 i = 0; i < THREAD_COUNT; i++) {
+            auto *mutator = static_cast<TracingAllocator *>(management->create_allocator(allocator_request));
+            threads.emplace_back(mutate, mutator, &corrupted[i]);
+        }
+        error = 0;
+        for (uint32 i = 0; i < 256 * 1024 && !error; i++) {
+            AllocateRequest garbage_request(i % 64 ? 256 : 64 * 1024);
+            allocator->allocate(garbage_request);
+            error = garbage_request.get_error();
+            if (i % 16384 == 0) allocator->collect(collect_request);
+        }
+        for (std::thread &thread: threads) thread.join();
+        corrupted_count += verify(*allocator, root);
+        for (uint32 count: corrupted) corrupted_count += count;
+        std::cout << "Test result: corrupted = " << corrupted_count << ", error = " << error << std::endl;
+
+        Management::terminate(management, terminate_request);
+        marker.stop();
+        scheduler.terminate();
+        scheduler_thread.join();
+    }
+    return 0;
+}
@@ -1,6 +1,14 @@
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
 #include "src/memory/global.hpp"
+#include "src/memory/profiling.hpp"
+#include "src/threading/os.hpp"
 
 using namespace veil::memory;
 
@@ -10,6 +18,65 @@ struct CustomObject {
     explicit CustomObject(int index) : index(index) {}
 };
 
+struct alignas(CACHE_LINE_SIZE) AlignedObject {
+    int index;
+
+    explicit AlignedObject(int index) : index(index) {}
+};
+
+struct SampledObject : public HeapObject {
+    uint8 payload[64];
+};
+
+const uint32 CACHED_COUNT = 4096;
+
+/// A HeapObject served by a cached size class, filled with its index to detect the blocks handed out twice.
+struct CachedObject : public HeapObject {
+    uint32 index;
+    uint8 payload[44];
+
+    explicit CachedObject(uint32 index) : index(index) { memset(payload, static_cast<uint8>(index), sizeof(payload)); }
+
+    [[nodiscard]] bool is_intact(uint32 expected) const {
+        if (index != expected) return false;
+        for (uint8 byte: payload) if (byte != static_cast<uint8>(expected)) return false;
+        return true;
+    }
+};
+
+/// Allocate the objects on a thread which exits afterwards, thus its magazines are flushed to the depot.
+class CachedAllocateFunction : public veil::vm::Executable {
+public:
+    explicit CachedAllocateFunction(CachedObject **objects) : objects(objects) {}
+
+    void execute() override { for (uint32 i = 0; i < CACHED_COUNT; i++) objects[i] = new CachedObject(i); }
+
+private:
+    CachedObject **objects;
+};
+
+/// Free the objects allocated by another thread, the blocks overflow the magazines of this thread into the depot.
+class CachedFreeFunction : public veil::vm::Executable {
+public:
+    explicit CachedFreeFunction(CachedObject **objects) : corrupted(0), objects(objects) {}
+
+    void execute() override {
+        for (uint32 i = 0; i < CACHED_COUNT; i++) {
+            if (!objects[i]->is_intact(i)) corrupted++;
+            delete objects[i];
+        }
+    }
+
+    uint32 corrupted;
+
+private:
+    CachedObject **objects;
+};
+
+void allocate_sampled_objects(int count) {
+    for (int i = 0; i < count; i++) delete new SampledObject();
+}
+
 int main() {
     const int OBJ_COUNT = 256;
 
@@ -26,7 +93,142 @@ int main() {
         std::cout << obj->index << std::endl;
     }
 
+    std::cout << "Begin test on arena deallocation, expects: live = " << OBJ_COUNT / 2 << ", reused = "
+              << OBJ_COUNT / 2 << std::endl;
+    CustomObject *dead_slots[OBJ_COUNT / 2];
+    int dead_count = 0;
+    TArenaIterator<CustomObject> deallocate_iterator(arena);
+    for (CustomObject *obj = deallocate_iterator.next(); obj != nullptr; obj = deallocate_iterator.next()) {
+        if (obj->index % 2 == 0) continue;
+        obj->~CustomObject();
+        arena.deallocate(obj);
+        dead_slots[dead_count++] = obj;
+    }
+    // Every object yielded is counted, thus a dead slot not skipped by the iterator is accounted as live.
+    int live = 0;
+    TArenaIterator<CustomObject> live_iterator(arena);
+    for (CustomObject *obj = live_iterator.next(); obj != nullptr; obj = live_iterator.next()) live++;
+    int reused = 0;
+    for (int i = 0; i < OBJ_COUNT / 2; i++) {
+        CustomObject *obj = arena.allocate();
+        for (int j = 0; j < dead_count; j++) if (dead_slots[j] == obj) reused++;
+        new(obj) CustomObject(i * 2);
+    }
+    std::cout << "Test result: live = " << live << ", reused = " << reused << std::endl;
+
     arena.free();
 
+    TArena<AlignedObject> aligned_arena;
+    std::cout << "Begin test on aligned arena, expects: aligned = " << OBJ_COUNT << std::endl;
+    for (int i = 0; i < OBJ_COUNT; i++) new(aligned_arena.allocate()) AlignedObject(i);
+    int aligned = 0;
+    TArenaIterator<AlignedObject> aligned_iterator(aligned_arena);
+    for (AlignedObject *obj = aligned_iterator.next(); obj != nullptr; obj = aligned_iterator.next())
+        if (reinterpret_cast<uint64>(obj) % CACHE_LINE_SIZE == 0) aligned++;
+    std::cout << "Test result: aligned = " << aligned << std::endl;
+
+    aligned_arena.free();
+
+    Arena large_arena;
+    std::cout << "Begin test on arena large allocation, expects: allocated = 1" << std::endl;
+    auto *large = static_cast<uint8 *>(large_arena.allocate(Arena::DEFAULT_POOL_SIZE * 4));
+    if (large != nullptr) large[Arena::DEFAULT_POOL_SIZE * 4 - 1] = 0;
+    std::cout << "Test result: allocated = " << (large != nullptr) << std::endl;
+
+    large_arena.free();
+
+    // The regions are 1, 1, 2, 4 and 8 chunks large, the chunks of a region are contiguous while the regions are not.
+    const uint32 CHUNK_SIZE = 1024;
+    Arena growing_arena(CHUNK_SIZE);
+    std::cout << "Begin test on arena region growth, expects: runs = 1 1 2 4 8" << std::endl;
+    std::string runs;
+    uint8 *previous = nullptr;
+    int run = 0;
+    for (int i = 0; i < 16; i++) {
+        auto *chunk = static_cast<uint8 *>(growing_arena.allocate(CHUNK_SIZE));
+        if (previous != nullptr && chunk != previous + CHUNK_SIZE) {
+            runs += " " + std::to_string(run);
+            run = 0;
+        }
+        run++;
+        previous = chunk;
+    }
+    runs += " " + std::to_string(run);
+    std::cout << "Test result: runs =" << runs << std::endl;
+
+    growing_arena.free();
+
+    SegregatedArena segregated_arena;
+    std::cout << "Begin test on segregated arena slot reuse, expects: reused = " << OBJ_COUNT << std::endl;
+    void *slots[OBJ_COUNT];
+    for (auto &slot: slots) slot = segregated_arena.allocate(sizeof(CustomObject));
+    for (auto &slot: slots) segregated_arena.deallocate(slot, sizeof(CustomObject));
+    reused = 0;
+    for (int i = 0; i < OBJ_COUNT; i++) {
+        void *slot = segregated_arena.allocate(sizeof(CustomObject));
+        for (auto &previous: slots) if (previous == slot) reused++;
+    }
+    std::cout << "Test result: reused = " << reused << std::endl;
+
+    // The size is within a granule of 4GiB, thus its rounded size overflows 32 bits.
+    const uint32 NEAR_4GIB_SIZE = UINT32_MAX - 3;
+    std::cout << "Begin test on segregated arena near 4GiB slot, expects: reused = 1" << std::endl;
+    void *near_4gib_slot = segregated_arena.allocate(NEAR_4GIB_SIZE);
+    segregated_arena.deallocate(near_4gib_slot, NEAR_4GIB_SIZE);
+    std::cout << "Test result: reused = " << (segregated_arena.allocate(NEAR_4GIB_SIZE) == near_4gib_slot)
+              << std::endl;
+
+    segregated_arena.free();
+
+    std::cout << "Begin test on cross thread heap cache, expects: corrupted = 0, recycled = 1, duplicated = 0"
+              << std::endl;
+    {
+        auto **objects = static_cast<CachedObject **>(malloc(CACHED_COUNT * sizeof(CachedObject *)));
+        CachedAllocateFunction allocate_function(objects);
+        CachedFreeFunction free_function(objects);
+        veil::os::Thread allocate_thread;
+        allocate_thread.start(allocate_function);
+        allocate_thread.join();
+        std::vector<void *> freed(objects, objects + CACHED_COUNT);
+        veil::os::Thread free_thread;
+        free_thread.start(free_function);
+        free_thread.join();
+        // The blocks freed by the exited thread are loaded from the depot by this thread.
+        std::sort(freed.begin(), freed.end());
+        std::vector<void *> allocated;
+        uint32 corrupted = free_function.corrupted, recycled = 0;
+        for (uint32 i = 0; i < CACHED_COUNT; i++) {
+            objects[i] = new CachedObject(i);
+            allocated.push_back(objects[i]);
+            if (std::binary_search(freed.begin(), freed.end(), objects[i])) recycled++;
+        }
+        for (uint32 i = 0; i < CACHED_COUNT; i++) if (!objects[i]->is_intact(i)) corrupted++;
+        std::sort(allocated.begin(), allocated.end());
+        auto duplicated = allocated.end() - std::unique(allocated.begin(), allocated.end());
+        for (uint32 i = 0; i < CACHED_COUNT; i++) delete objects[i];
+        free(objects);
+        std::cout << "Test result: corrupted = " << corrupted << ", recycled = " << (recycled > 0)
+                  << ", duplicated = " << duplicated << std::endl;
+    }
+
+    // 4096 allocations of 64 bytes are expected to be sampled 64 times with the interval of 4096 bytes.
+    std::cout << "Begin test on allocation sampling, expects: sampled = 1, header = 1, callstacks = 1" << std::endl;
+    AllocationSampler::reset();
+    AllocationSampler::set_sampling_interval(4096);
+    allocate_sampled_objects(4096);
+    uint64 sample_count = AllocationSampler::get_sample_count();
+    bool dumped = AllocationSampler::dump("allocation_profile.heap");
+    AllocationSampler::set_sampling_interval(AllocationSampler::DEFAULT_SAMPLING_INTERVAL);
+    std::ifstream profile("allocation_profile.heap");
+    std::string line;
+    std::getline(profile, line);
+    bool header = dumped && line.rfind("heap profile:", 0) == 0 && line.find("@ heap_v2/4096") != std::string::npos;
+    int callstacks = 0;
+    while (std::getline(profile, line) && !line.empty()) callstacks++;
+    profile.close();
+    std::remove("allocation_profile.heap");
+    std::cout << "Test result: sampled = " << (sample_count >= 16 && sample_count <= 256) << ", header = " << header
+              << ", callstacks = " << (callstacks > 0) << std::endl;
+
     return 0;
 }
@@ -0,0 +1,459 @@
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "src/core/runtime.hpp"
+#include "src/memory/allocator-front-end.hpp"
+#include "src/memory/management.hpp"
+#include "src/memory/os.hpp"
+#include "src/memory/tlab.hpp"
+#include "src/vm/errors.hpp"
+
+using namespace veil::memory;
+
+const uint32 POINTER_COUNT = 16384;
+
+/// The size of the i-th pointer, which spans the small and the doubling size classes.
+uint32 size_of(uint32 index) { return 8 + index * 37 % 3000; }
+
+/// A cache of large objects which counts the pressure notifications, and evicts all the objects under critical
+/// pressure.
+class CacheEvictor : public PressureListener {
+public:
+    std::vector<LargeObject *> objects;
+    uint32 soft_count = 0;
+    uint32 critical_count = 0;
+
+    void relieve(Management &management, MemoryPressure pressure) override {
+        if (pressure == MemoryPressure::SOFT) {
+            soft_count++;
+            return;
+        }
+        critical_count++;
+        for (LargeObject *object: objects) {
+            veil::vm::Request free_request;
+            management.free_large(object, free_request);
+        }
+        objects.clear();
+    }
+};
+
+/// Exposes the heap mapping delegates of the algorithm, such that the heap sections are mapped by the test directly.
+class MappingAlgorithm : public TLABAlgorithm {
+public:
+    static void map(Management &management, HeapMapRequest &request) { heap_map(management, request); }
+
+    static void unmap(Management &management, HeapUnmapRequest &request) { heap_unmap(management, request); }
+};
+
+void fill(Allocator &allocator, Pointer *pointer, uint8 pattern) {
+    PointerAcquireRequest acquire_request(pointer, true);
+    allocator.acquire(acquire_request);
+    uint8 *address = acquire_request.get_address();
+    for (uint32 i = 0; i < pointer->size; i++) address[i] = pattern;
+    PointerActionRequest release_request(pointer);
+    allocator.release(release_request);
+}
+
+bool verify(Allocator &allocator, Pointer *pointer, uint8 pattern) {
+    PointerAcquireRequest acquire_request(pointer);
+    allocator.acquire(acquire_request);
+    uint8 *address = acquire_request.get_address();
+    bool intact = true;
+    for (uint32 i = 0; i < pointer->size; i++) intact &= address[i] == pattern;
+    PointerActionRequest release_request(pointer);
+    allocator.release(release_request);
+    return intact;
+}
+
+void allocate_and_fill(Allocator *allocator, std::vector<Pointer *> *pointers, uint8 pattern) {
+    for (uint32 i = 0; i < POINTER_COUNT; i++) {
+        AllocateRequest request(size_of(i));
+        Pointer *pointer = allocator->allocate(request);
+        fill(*allocator, pointer, pattern);
+        pointers->push_back(pointer);
+    }
+}
+
+void increment(Allocator *allocator, Pointer *counter, uint32 iteration_count) {
+    for (uint32 i = 0; i < iteration_count; i++) {
+        PointerAcquireRequest acquire_request(counter, true);
+        allocator->acquire(acquire_request);
+        (*reinterpret_cast<uint64 *>(acquire_request.get_address()))++;
+        PointerActionRequest release_request(counter);
+        allocator->release(release_request);
+    }
+}
+
+const uint32 GROUP_SIZE = 8;
+
+/// Increment the \a counters acquired in a batch, each thread lists the group in a different order.
+void increment_batch(Allocator *allocator, Pointer **counters, uint32 offset, uint32 iteration_count) {
+    Pointer *group[GROUP_SIZE];
+    uint8 *addresses[GROUP_SIZE];
+    for (uint32 i = 0; i < iteration_count; i++) {
+        for (uint32 j = 0; j < GROUP_SIZE; j++) group[j] = counters[(j + offset) % GROUP_SIZE];
+        PointerBatchAcquireRequest acquire_request(group, GROUP_SIZE, addresses, true);
+        allocator->acquire_batch(acquire_request);
+        for (uint32 j = 0; j < GROUP_SIZE; j++) (*reinterpret_cast<uint64 *>(acquire_request.get_address(j)))++;
+        PointerBatchReleaseRequest release_request(group, GROUP_SIZE);
+        allocator->release_batch(release_request);
+    }
+}
+
+int main() {
+    veil::Runtime runtime;
+    TLABAlgorithm algorithm;
+    TLABParams params(1024 * 1024, 32 * 1024);
+    MemoryInitRequest init_request(256 * 1024 * 1024, &algorithm, &params);
+    Management *management = Management::new_instance(runtime, init_request);
+
+    veil::vm::Request allocator_request;
+    Allocator *allocator = management->create_allocator(allocator_request);
+
+    std::cout << "Begin test on single thread allocation, expects: corrupted = 0" << std::endl;
+    std::vector<Pointer *> pointers;
+    allocate_and_fill(allocator, &pointers, 0x5a);
+    uint32 corrupted = 0;
+    for (Pointer *pointer: pointers) if (!verify(*allocator, pointer, 0x5a)) corrupted++;
+    std::cout << "Test result: corrupted = " << corrupted << std::endl;
+
+    std::cout << "Begin test on pointer reservation, expects: reused = " << POINTER_COUNT << std::endl;
+    std::unordered_set<uint8 *> addresses;
+    for (Pointer *pointer: pointers) {
+        addresses.insert(static_cast<TLABPointer *>(pointer)->address);
+        PointerActionRequest reserve_request(pointer);
+        allocator->reserve(reserve_request);
+    }
+    uint32 reused = 0;
+    for (uint32 i = 0; i < POINTER_COUNT; i++) {
+        AllocateRequest request(size_of(i));
+        auto *pointer = static_cast<TLABPointer *>(allocator->allocate(request));
+        if (addresses.count(pointer->address)) reused++;
+    }
+    std::cout << "Test result: reused = " << reused << std::endl;
+
+    std::cout << "Begin test on large allocation, expects: allocated = 1, error = 0" << std::endl;
+    AllocateRequest large_request(3 * 1024 * 1024);
+    Pointer *large = allocator->allocate(large_request);
+    fill(*allocator, large, 0x11);
+    std::cout << "Test result: allocated = " << verify(*allocator, large, 0x11) << ", error = "
+              << large_request.get_error() << std::endl;
+
+    std::cout << "Begin test on front end allocation, expects: corrupted = 0, error = 0" << std::endl;
+    {
+        AllocatorFrontEnd<TLABAllocator> front_end(*management->create_allocator(allocator_request));
+        std::vector<Pointer *> front_pointers;
+        for (uint32 i = 0; i < POINTER_COUNT; i++) {
+            Pointer *pointer = front_end.allocate(size_of(i));
+            uint8 *address = front_end.acquire(pointer, true);
+            for (uint32 j = 0; j < pointer->size; j++) address[j] = 0x3c;
+            front_end.release(pointer);
+            front_pointers.push_back(pointer);
+            // The reserved pointers are reused by the slow path.
+            if (i % 7 == 0) {
+                PointerActionRequest reserve_request(pointer);
+                front_end.get_allocator().reserve(reserve_request);
+                front_pointers.pop_back();
+            }
+        }
+        corrupted = 0;
+        for (Pointer *pointer: front_pointers) {
+            // The pointers biased towards the front end are acquired by the slow path of another allocator.
+            if (!verify(*allocator, pointer, 0x3c)) corrupted++;
+            uint8 *address = front_end.acquire(pointer);
+            for (uint32 j = 0; j < pointer->size; j++) if (address[j] != 0x3c) corrupted++;
+            front_end.release(pointer);
+        }
+        std::cout << "Test result: corrupted = " << corrupted << ", error = " << front_end.get_error() << std::endl;
+    }
+
+    std::cout << "Begin test on allocator statistics, expects: allocated = 1000, freed = 500, class count = 1000, "
+                 "live = 1" << std::endl;
+    {
+        Allocator *counted = management->create_allocator(allocator_request);
+        std::vector<Pointer *> counted_pointers;
+        for (uint32 i = 0; i < 1000; i++) {
+            AllocateRequest request(100);
+            counted_pointers.push_back(counted->allocate(request));
+        }
+        for (uint32 i = 0; i < 500; i++) {
+            PointerActionRequest reserve_request(counted_pointers[i]);
+            counted->reserve(reserve_request);
+        }
+        // The records are published in batches, the last frees are still pending.
+        uint64 pending = 1500 % AllocatorStatistics::PUBLISH_INTERVAL;
+        const AllocatorStatistics &statistics = counted->get_statistics();
+        uint64 capacity = TLABAllocator::capacity_of(100);
+        HeapStatistics heap_statistics;
+        management->get_statistics(heap_statistics);
+        std::cout << "Test result: allocated = " << statistics.get_allocated_size() / capacity << ", freed = "
+                  << (statistics.get_freed_size() + pending * capacity) / capacity << ", class count = "
+                  << statistics.get_class_count(AllocatorStatistics::size_class_of(capacity)) << ", live = "
+                  << (heap_statistics.get_live_size() <= heap_statistics.mapped_size) << std::endl;
+    }
+
+    const uint32 THREAD_COUNT = 4;
+    std::cout << "Begin test on multiple thread allocation, expects: corrupted = 0" << std::endl;
+    {
+        Allocator *allocators[THREAD_COUNT];
+        std::vector<Pointer *> thread_pointers[THREAD_COUNT];
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++) {
+            allocators[i] = management->create_allocator(allocator_request);
+            threads.emplace_back(allocate_and_fill, allocators[i], &thread_pointers[i], static_cast<uint8>(i + 1));
+        }
+        for (std::thread &thread: threads) thread.join();
+        corrupted = 0;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            for (Pointer *pointer: thread_pointers[i])
+                if (!verify(*allocators[i], pointer, static_cast<uint8>(i + 1))) corrupted++;
+    }
+    std::cout << "Test result: corrupted = " << corrupted << std::endl;
+
+    const uint32 ITERATION_COUNT = 4096;
+    std::cout << "Begin test on exclusive acquisition, expects: count = " << ITERATION_COUNT * THREAD_COUNT
+              << std::endl;
+    {
+        AllocateRequest counter_request(sizeof(uint64));
+        Pointer *counter = allocator->allocate(counter_request);
+        PointerAcquireRequest acquire_request(counter, true);
+        allocator->acquire(acquire_request);
+        *reinterpret_cast<uint64 *>(acquire_request.get_address()) = 0;
+        PointerActionRequest release_request(counter);
+        allocator->release(release_request);
+
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            threads.emplace_back(increment, management->create_allocator(allocator_request), counter,
+                                 ITERATION_COUNT);
+        for (std::thread &thread: threads) thread.join();
+
+        allocator->acquire(acquire_request);
+        std::cout << "Test result: count = " << *reinterpret_cast<uint64 *>(acquire_request.get_address())
+                  << std::endl;
+        allocator->release(release_request);
+    }
+
+    std::cout << "Begin test on batch acquisition, expects: count = " << GROUP_SIZE * ITERATION_COUNT * THREAD_COUNT
+              << std::endl;
+    {
+        Pointer *counters[GROUP_SIZE];
+        for (Pointer *&counter: counters) {
+            AllocateRequest counter_request(sizeof(uint64));
+            counter = allocator->allocate(counter_request);
+            fill(*allocator, counter, 0);
+        }
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            threads.emplace_back(increment_batch, management->create_allocator(allocator_request), counters, i * 3,
+                                 ITERATION_COUNT);
+        for (std::thread &thread: threads) thread.join();
+
+        uint8 *addresses[GROUP_SIZE];
+        PointerBatchAcquireRequest acquire_request(counters, GROUP_SIZE, addresses);
+        allocator->acquire_batch(acquire_request);
+        uint64 count = 0;
+        for (uint32 i = 0; i < GROUP_SIZE; i++) count += *reinterpret_cast<uint64 *>(acquire_request.get_address(i));
+        PointerBatchReleaseRequest release_request(counters, GROUP_SIZE);
+        allocator->release_batch(release_request);
+        std::cout << "Test result: count = " << count << std::endl;
+    }
+
+    veil::vm::Request terminate_request;
+    Management::terminate(management, terminate_request);
+
+    const uint64 LARGE_SIZE = (4ULL << 30) + (64 << 20);
+    std::cout << "Begin test on large-object space, expects: intact = 1, overflowed = 1, large size = 0" << std::endl;
+    {
+        MemoryInitRequest large_init_request(6ULL << 30, &algorithm, &params);
+        // The heap is reserved beyond any container limit, as only the probed pages are committed.
+        large_init_request.container_heap_percent = 0;
+        management = Management::new_instance(runtime, large_init_request);
+
+        // The object beyond the heap fails, and its mapped segments are returned to the heap.
+        LargeAllocateRequest overflow_request(8ULL << 30, 256 << 20);
+        bool overflowed = !management->allocate_large(overflow_request) && !overflow_request.is_ok();
+
+        LargeAllocateRequest large_request(LARGE_SIZE, 256 << 20);
+        LargeObject *object = management->allocate_large(large_request);
+        bool intact = object && object->segment_count == 17 && management->get_large_size() == LARGE_SIZE;
+        if (object) {
+            // Only the pages of the probed offsets are faulted in.
+            const uint64 offsets[] = {0, (4ULL << 30) - 1, 4ULL << 30, LARGE_SIZE - 1};
+            for (uint64 offset: offsets) *object->address_of(offset) = static_cast<uint8>(offset % 251 + 1);
+            for (uint64 offset: offsets) intact &= *object->address_of(offset) == offset % 251 + 1;
+            veil::vm::Request free_request;
+            management->free_large(object, free_request);
+            intact &= free_request.is_ok();
+        }
+        std::cout << "Test result: intact = " << intact << ", overflowed = " << overflowed << ", large size = "
+                  << management->get_large_size() << std::endl;
+        Management::terminate(management, terminate_request);
+    }
+
+    std::cout << "Begin test on memory pressure, expects: soft = 1, critical = 1, allocated = 1, error = 0"
+              << std::endl;
+    {
+        MemoryInitRequest pressure_init_request(64 << 20, &algorithm, &params);
+        pressure_init_request.soft_heap_percent = 50;
+        pressure_init_request.container_heap_percent = 0;
+        management = Management::new_instance(runtime, pressure_init_request);
+        CacheEvictor evictor;
+        management->add_pressure_listener(evictor);
+
+        // The cache crosses the soft limit once, then the larger object only fits after the cache is evicted.
+        for (uint32 index = 0; index < 6; index++) {
+            LargeAllocateRequest cache_request(8 << 20);
+            evictor.objects.push_back(management->allocate_large(cache_request));
+        }
+        LargeAllocateRequest large_request(24 << 20);
+        LargeObject *object = management->allocate_large(large_request);
+        std::cout << "Test result: soft = " << evictor.soft_count << ", critical = " << evictor.critical_count
+                  << ", allocated = " << (object != nullptr) << ", error = " << large_request.get_error() << std::endl;
+        veil::vm::Request free_request;
+        if (object) management->free_large(object, free_request);
+        management->remove_pressure_listener(evictor);
+        Management::terminate(management, terminate_request);
+    }
+
+    const uint64 SECTION_SIZE = 4 << 20;
+    std::cout << "Begin test on heap map options, expects: handled = 6, rejected = 1" << std::endl;
+    {
+        HeapMapOptions options[6];
+        options[1].page_mode = HeapMapOptions::PageMode::TRANSPARENT_HUGE;
+        options[2].page_mode = HeapMapOptions::PageMode::EXPLICIT_HUGE;
+        options[3].pre_fault = true;
+        options[4].numa_policy = HeapMapOptions::NumaPolicy::BIND;
+        options[4].numa_node_mask = 1;
+        options[5].page_mode = HeapMapOptions::PageMode::EXPLICIT_HUGE;
+        options[5].pre_fault = true;
+        options[5].numa_policy = HeapMapOptions::NumaPolicy::INTERLEAVE;
+        options[5].numa_node_mask = 1;
+
+        uint32 handled = 0;
+        for (const HeapMapOptions &option: options) {
+            MemoryInitRequest options_init_request(64 << 20, &algorithm, &params, option);
+            options_init_request.container_heap_percent = 0;
+            management = Management::new_instance(runtime, options_init_request);
+            if (!management) continue;
+            // The explicit huge pages fall back to regular pages and the advisory options are tolerated, thus the
+            // mapping only fails if the host is out of memory.
+            HeapMapRequest map_request(SECTION_SIZE);
+            MappingAlgorithm::map(*management, map_request);
+            uint8 *address = map_request.get_address();
+            if (map_request.is_ok() && address) {
+                address[0] = 1;
+                address[SECTION_SIZE - 1] = 2;
+                bool intact = address[0] == 1 && address[SECTION_SIZE - 1] == 2;
+                HeapUnmapRequest unmap_request(address, SECTION_SIZE);
+                MappingAlgorithm::unmap(*management, unmap_request);
+                handled += intact && unmap_request.is_ok();
+            } else {
+                handled += map_request.get_error() == ERR_HOST_NOMEM;
+            }
+            Management::terminate(management, terminate_request);
+        }
+
+        // A NUMA policy without any node is rejected before the heap is reserved.
+        HeapMapOptions empty_options;
+        empty_options.numa_policy = HeapMapOptions::NumaPolicy::BIND;
+        MemoryInitRequest empty_init_request(64 << 20, &algorithm, &params, empty_options);
+        bool rejected = !Management::new_instance(runtime, empty_init_request) &&
+                        empty_init_request.get_error() == ERR_INV_MAP_OPTION;
+        std::cout << "Test result: handled = " << handled << ", rejected = " << rejected << std::endl;
+    }
+
+    std::cout << "Begin test on host page options, expects: huge = 1, advised = 1, bound = 1, unsupported = 1"
+              << std::endl;
+    {
+        uint64 huge_page_size = veil::os::get_huge_page_size();
+        uint64 size = huge_page_size ? huge_page_size : 2 << 20;
+        uint32 error;
+        // The explicit huge pages are only provided if the host has reserved them, the mapping is rejected otherwise.
+        void *huge_section = veil::os::mmap(nullptr, size, true, true, true, false, error);
+        bool huge = huge_section ? error == veil::ERR_NONE :
+                    error == veil::os::ERR_NOMEM || error == veil::os::ERR_NOT_SUPPORTED;
+        if (huge_section) veil::os::munmap(huge_section, size, error);
+
+        bool advised = false, bound = false, unsupported = false;
+        void *section = veil::os::mmap(nullptr, size, true, false, false, false, error);
+        if (section) {
+            veil::os::advise_huge_pages(section, size, error);
+            advised = error == veil::ERR_NONE || error == veil::os::ERR_NOT_SUPPORTED;
+            veil::os::numa_bind(section, size, 1, false, error);
+            bound = error == veil::ERR_NONE || error == veil::os::ERR_NOT_SUPPORTED;
+            // The host rejects the policy without any node, or does not support the policy at all.
+            veil::os::numa_bind(section, size, 0, true, error);
+            unsupported = error == veil::os::ERR_NOT_SUPPORTED;
+            veil::os::munmap(section, size, error);
+        }
+        std::cout << "Test result: huge = " << huge << ", advised = " << advised << ", bound = " << bound
+                  << ", unsupported = " << unsupported << std::endl;
+    }
+
+    std::cout << "Begin test on heap section reuse, expects: merged = 1, reused = 1, overflowed = 1, recovered = 1"
+              << std::endl;
+    {
+        MemoryInitRequest sections_init_request(64 << 20, &algorithm, &params);
+        sections_init_request.container_heap_percent = 0;
+        management = Management::new_instance(runtime, sections_init_request);
+
+        uint8 *sections[4];
+        for (uint8 *&section: sections) {
+            HeapMapRequest map_request(SECTION_SIZE);
+            MappingAlgorithm::map(*management, map_request);
+            section = map_request.get_address();
+        }
+        bool merged = true;
+        for (uint32 index = 1; index < 4; index++) merged &= sections[index] == sections[0] + index * SECTION_SIZE;
+        // The sections below the topmost one are unmapped out of order, which leaves a single merged free section.
+        const uint32 order[] = {2, 0, 1};
+        for (uint32 index: order) {
+            HeapUnmapRequest unmap_request(sections[index], SECTION_SIZE);
+            MappingAlgorithm::unmap(*management, unmap_request);
+            merged &= unmap_request.is_ok();
+        }
+        HeapMapRequest merged_request(3 * SECTION_SIZE);
+        MappingAlgorithm::map(*management, merged_request);
+        merged &= merged_request.is_ok() && merged_request.get_address() == sections[0];
+        if (merged) merged_request.get_address()[3 * SECTION_SIZE - 1] = 1;
+
+        // The lowest free section is reused, even after the topmost section lowers the heap top.
+        HeapUnmapRequest merged_unmap_request(merged_request.get_address(), 3 * SECTION_SIZE);
+        MappingAlgorithm::unmap(*management, merged_unmap_request);
+        HeapUnmapRequest top_unmap_request(sections[3], SECTION_SIZE);
+        MappingAlgorithm::unmap(*management, top_unmap_request);
+        HeapMapRequest reuse_request(SECTION_SIZE);
+        MappingAlgorithm::map(*management, reuse_request);
+        bool reused = reuse_request.is_ok() && reuse_request.get_address() == sections[0];
+
+        // The reserved range is exhausted by the mappings, and the unmapped section is available again.
+        std::vector<uint8 *> mapped;
+        if (reuse_request.is_ok()) mapped.push_back(reuse_request.get_address());
+        bool overflowed = false;
+        while (mapped.size() <= (64 << 20) / SECTION_SIZE) {
+            HeapMapRequest map_request(SECTION_SIZE);
+            MappingAlgorithm::map(*management, map_request);
+            if (!map_request.is_ok()) {
+                overflowed = map_request.get_error() == ERR_HEAP_OVERFLOW;
+                break;
+            }
+            mapped.push_back(map_request.get_address());
+        }
+        bool recovered = false;
+        if (mapped.size() > 1) {
+            uint8 *address = mapped[mapped.size() / 2];
+            HeapUnmapRequest unmap_request(address, SECTION_SIZE);
+            MappingAlgorithm::unmap(*management, unmap_request);
+            HeapMapRequest map_request(SECTION_SIZE);
+            MappingAlgorithm::map(*management, map_request);
+            recovered = map_request.is_ok() && map_request.get_address() == address;
+        }
+        std::cout << "Test result: merged = " << merged << ", reused = " << reused << ", overflowed = " << overflowed
+                  << ", recovered = " << recovered << std::endl;
+        Management::terminate(management, terminate_request);
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <new>
+#include <string>
+
+#include "src/memory/tlab.hpp"
+#include "src/threading/os.hpp"
+#include "src/vm/errors.hpp"
+
+using namespace veil::memory;
+
+/// A heap memory section mapped from the \c Management, the buffers are carved by bumping \c TLABChunk::bump.
+struct TLABChunk : public HeapObject {
+    uint8 *const base;
+    const uint64 size;
+    /// The offset of the next carving, which might overshoot \c TLABChunk::size when the chunk is exhausted.
+    veil::os::atomic_u64_t bump;
+    TLABChunk *next;
+
+    TLABChunk(uint8 *base, uint64 size, uint64 bump, TLABChunk *next) :
+            base(base), size(size), bump(bump), next(next) {}
+};
+
+class veil::memory::TLABHeap : public HeapObject {
+public:
+    const uint64 chunk_size;
+    const uint32 tlab_size;
+    /// The chunk which the buffers are currently carved from.
+    os::atomic_pointer_t<TLABChunk> current_chunk;
+    /// The mutex guarding the mapping of chunks and the creation of allocators.
+    os::Mutex structure_m;
+    /// All mapped chunks, including the dedicated ones.
+    TLABChunk *chunks;
+    /// The storage of the allocators created from this heap.
+    TArena<TLABAllocator> allocators;
+
+    explicit TLABHeap(TLABParams &params) : chunk_size(params.chunk_size), tlab_size(params.tlab_size),
+                                            current_chunk(nullptr), chunks(nullptr) {}
+};
+
+TLABParams::TLABParams(uint64 chunk_size, uint32 tlab_size) : chunk_size(chunk_size), tlab_size(tlab_size) {}
+
+TLABPointer::TLABPointer(uint32 size, uint8 *address, uint32 capacity) :
+        Pointer(size), address(address), capacity(capacity), next_reserved(nullptr) {}
+
+static std::string tlab_algorithm_name = "tlab";
+
+TLABAlgorithm::TLABAlgorithm() : Algorithm(tlab_algorithm_name) {}
+
+void TLABAlgorithm::initialize(AlgorithmInitRequest &request) {
+    TLABParams default_params;
+    auto *params = request.algorithm_params ? static_cast<TLABParams *>(request.algorithm_params) : &default_params;
+    // The buffers must keep the carved sections aligned, and must fit into a chunk.
+    if (params->tlab_size == 0 || params->tlab_size % TLABAllocator::ALIGNMENT != 0 ||
+        params->tlab_size > params->chunk_size) {
+        vm::RequestExecutor::set_error(request, memory::ERR_ALGO_INIT);
+        return;
+    }
+    set_structure(*request.management, new TLABHeap(*params));
+}
+
+void TLABAlgorithm::terminate(Management &management, vm::Request &request) {
+    auto *heap = static_cast<TLABHeap *>(get_structure(management));
+    if (!heap) return;
+
+    heap->allocators.destruct_objects();
+    heap->allocators.free();
+    while (heap->chunks) {
+        TLABChunk *chunk = heap->chunks;
+        heap->chunks = chunk->next;
+        HeapUnmapRequest unmap_request(chunk->base, chunk->size);
+        heap_unmap(management, unmap_request);
+        delete chunk;
+    }
+    delete heap;
+    set_structure(management, nullptr);
+}
+
+uint64 TLABAlgorithm::max_supported_heap_size() { return MAX_SUPPORTED_HEAP_SIZE; }
+
+Allocator *TLABAlgorithm::create_allocator(Management &management, vm::Request &request) {
+    auto *heap = static_cast<TLABHeap *>(get_structure(management));
+    os::CriticalSection _(heap->structure_m);
+    // The class specific operator new of Allocator is deleted, thus the global placement new is used explicitly.
+    return ::new(heap->allocators.allocate()) TLABAllocator(management, *heap);
+}
+
+TLABAllocator::TLABAllocator(Management &management, TLABHeap &heap) :
+        Allocator(management), heap(&heap), tlab_top(nullptr), tlab_end(nullptr), reserved() {}
+
+TLABAllocator::~TLABAllocator() {
+    this->pointers.free();
+}
+
+uint32 TLABAllocator::size_class_of(uint64 size) {
+    if (size <= SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT) return size ? (size - 1) / SIZE_CLASS_GRANULE : 0;
+    if (size > MAX_CLASS_CAPACITY) return SIZE_CLASS_COUNT;
+
+    uint32 size_class = SMALL_CLASS_COUNT;
+    uint64 capacity = SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT * 2;
+    while (capacity < size) {
+        capacity <<= 1;
+        size_class++;
+    }
+    return size_class;
+}
+
+uint64 TLABAllocator::capacity_of(uint64 size) {
+    uint32 size_class = size_class_of(size);
+    if (size_class < SMALL_CLASS_COUNT) return (size_class + 1) * SIZE_CLASS_GRANULE;
+    if (size_class < SIZE_CLASS_COUNT)
+        return static_cast<uint64>(SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT) << (size_class - SMALL_CLASS_COUNT + 1);
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+uint8 *TLABAllocator::carve(uint64 size, vm::Request &request) {
+    TLABHeap *target = this->heap;
+    while (true) {
+        TLABChunk *chunk = target->current_chunk.load();
+        if (chunk) {
+            // The atomic fetch operations return the resulting value, thus the carved section ends at the offset.
+            uint64 offset = chunk->bump.fetch_add(size) - size;
+            if (offset + size <= chunk->size) return chunk->base + offset;
+        }
+
+        os::CriticalSection _(target->structure_m);
+        // Another thread might have installed a new chunk while the current thread is waiting for the lock.
+        if (target->current_chunk.load() != chunk) continue;
+
+        HeapMapRequest map_request(target->chunk_size);
+        this->heap_map(map_request);
+        if (!map_request.is_ok()) {
+            vm::RequestExecutor::set_error(request, map_request.get_error());
+            return nullptr;
+        }
+        // The section of the current thread is carved before the chunk is published.
+        auto *mapped = new TLABChunk(map_request.get_address(), target->chunk_size, size, target->chunks);
+        target->chunks = mapped;
+        target->current_chunk.store(mapped);
+        return mapped->base;
+    }
+}
+
+uint8 *TLABAllocator::map_dedicated(uint64 size, vm::Request &request) {
+    HeapMapRequest map_request(size);
+    this->heap_map(map_request);
+    if (!map_request.is_ok()) {
+        vm::RequestExecutor::set_error(request, map_request.get_error());
+        return nullptr;
+    }
+
+    os::CriticalSection _(this->heap->structure_m);
+    // The dedicated chunk is recorded as exhausted, it is never installed as the current chunk.
+    this->heap->chunks = new TLABChunk(map_request.get_address(), size, size, this->heap->chunks);
+    return map_request.get_address();
+}
+
+Pointer *TLABAllocator::allocate(AllocateRequest &request) {
+    uint64 capacity = capacity_of(request.size);
+    // The maximum memory size associated with a pointer is 4GiB.
+    if (capacity > UINT32_MAX) {
+        vm::RequestExecutor::set_error(request, memory::ERR_INV_POINTER_SIZE);
+        return nullptr;
+    }
+
+    uint32 size_class = size_class_of(request.size);
+    TLABPointer *recycled = nullptr;
+    TLABPointer **link = &this->reserved[size_class];
+    // The pointers of a size class are interchangeable, while an oversize pointer is reused by the first one fits.
+    while (*link) {
+        if ((*link)->capacity >= request.size) {
+            recycled = *link;
+            *link = recycled->next_reserved;
+            break;
+        }
+        link = &(*link)->next_reserved;
+    }
+    if (recycled) {
+        uint8 *address = recycled->address;
+        uint32 recycled_capacity = recycled->capacity;
+        recycled->~TLABPointer();
+        auto *pointer = new(recycled) TLABPointer(request.size, address, recycled_capacity);
+        pointer->bias(this->client);
+        this->statistics.record_allocation(recycled_capacity);
+        return pointer;
+    }
+
+    uint8 *address;
+    if (capacity <= static_cast<uint64>(this->tlab_end - this->tlab_top)) {
+        address = this->tlab_top;
+        this->tlab_top += capacity;
+    } else if (capacity > this->heap->tlab_size / 4) {
+        // Large sectors bypass the buffer, so that the remaining space of the buffer is not abandoned.
+        address = capacity > this->heap->chunk_size ? this->map_dedicated(capacity, request) :
+                  this->carve(capacity, request);
+    } else {
+        // The current buffer is retired and its remaining space is abandoned.
+        address = this->carve(this->heap->tlab_size, request);
+        if (address) {
+            this->tlab_top = address + capacity;
+            this->tlab_end = address + this->heap->tlab_size;
+        }
+    }
+    if (!address) return nullptr;
+
+    auto *pointer = new(this->pointers.allocate()) TLABPointer(request.size, address, static_cast<uint32>(capacity));
+    pointer->bias(this->client);
+    this->statistics.record_allocation(capacity);
+    return pointer;
+}
+
+void TLABAllocator::reserve(PointerActionRequest &request) {
+    auto *pointer = static_cast<TLABPointer *>(request.pointer);
+    TLABPointer **stack = &this->reserved[size_class_of(pointer->capacity)];
+    pointer->next_reserved = *stack;
+    *stack = pointer;
+    this->statistics.record_free(pointer->capacity);
+}
+
+void TLABAllocator::acquire(PointerAcquireRequest &request) {
+    // The pointer is constant to the caller, while the lock embedded within the pointer is mutable.
+    auto *pointer = static_cast<TLABPointer *>(const_cast<Pointer *>(request.pointer));
+    this->client.wait(*pointer);
+    set_address(request, pointer->address);
+}
+
+void TLABAllocator::release(PointerActionRequest &request) {
+    this->client.exit(*static_cast<TLABPointer *>(request.pointer));
+}
+
+void TLABAllocator::acquire_batch(PointerBatchAcquireRequest &request) {
+    for (uint32 index = 0; index < request.count; index++) {
+        auto *pointer = static_cast<TLABPointer *>(request.pointers[index]);
+        this->client.wait(*pointer);
+        set_address(request, index, pointer->address);
+    }
+}
+
+void TLABAllocator::release_batch(PointerBatchReleaseRequest &request) {
+    for (uint32 index = request.count; index > 0; index--)
+        this->client.exit(*static_cast<TLABPointer *>(request.pointers[index - 1]));
+}
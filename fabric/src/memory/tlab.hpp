@@ -0,0 +1,185 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_TLAB_HPP
+#define VEIL_FABRIC_SRC_MEMORY_TLAB_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/threading/thin-lock.hpp"
+
+namespace veil::memory {
+
+    /// The parameters of \c TLABAlgorithm, passed with \c MemoryInitRequest::algorithm_params.
+    struct TLABParams {
+        /// The byte size of each heap memory section mapped from the \c Management, the thread local allocation
+        /// buffers are carved from the current chunk.
+        uint64 chunk_size;
+        /// The byte size of each thread local allocation buffer.
+        uint32 tlab_size;
+
+        /// \param chunk_size The byte size of each heap memory section mapped from the \c Management.
+        /// \param tlab_size  The byte size of each thread local allocation buffer.
+        explicit TLABParams(uint64 chunk_size = 4 * 1024 * 1024, uint32 tlab_size = 64 * 1024);
+    };
+
+    /// The \c Pointer of \c TLABAlgorithm, the pointer is a stable handle to its memory sector allocated from the
+    /// thread local allocation buffer; the pointer itself extends \c threading::ThinLock biased towards the allocator
+    /// allocating it, such that the acquisitions by the allocating thread are free of read-modify-write operations.
+    struct TLABPointer : public Pointer, public threading::ThinLock, public ArenaObject {
+        /// The address of the memory sector.
+        uint8 *address;
+        /// The byte size of the memory sector which is padded to the size class of \c Pointer::size, the memory sector
+        /// is reused by the subsequent allocations with the same size class once the pointer is reserved.
+        const uint32 capacity;
+        /// The next pointer within the reserved stack of the same size class.
+        TLABPointer *next_reserved;
+
+        TLABPointer(uint32 size, uint8 *address, uint32 capacity);
+    };
+
+    /// The heap wide structure of \c TLABAlgorithm stored within \c Management::structure.
+    class TLABHeap;
+
+    /// A bump pointer memory management algorithm without garbage collection, each \c TLABAllocator carves a thread
+    /// local allocation buffer (TLAB) from the current heap chunk, which is a heap memory section mapped from the
+    /// \c Management, then serves the allocations by bumping within the buffer without any synchronization.
+    /// <br><br>
+    /// The buffers are carved by atomically bumping the offset of the current chunk, thus the refill of a buffer is
+    /// lock-free; only the thread which exhausts the current chunk will enter the lock to map a new chunk. Allocations
+    /// too large for a buffer are carved from the current chunk directly, or are mapped as a dedicated chunk if they
+    /// are larger than the chunk itself.
+    /// <br><br>
+    /// As the algorithm does not collect garbage, the memory sectors are recycled only by \c Allocator::reserve, which
+    /// pushes the pointer onto the reserved stack of its size class within the allocator.
+    class TLABAlgorithm : public Algorithm {
+    public:
+        /// The maximum supported heap size, which is the size of the user space of a 48-bit virtual address space.
+        static const uint64 MAX_SUPPORTED_HEAP_SIZE = 1ULL << 46;
+
+        TLABAlgorithm();
+
+        void initialize(AlgorithmInitRequest &request) override;
+
+        void terminate(Management &management, vm::Request &request) override;
+
+        uint64 max_supported_heap_size() override;
+
+        Allocator *create_allocator(Management &management, vm::Request &request) override;
+    };
+
+    /// The \c Allocator of \c TLABAlgorithm, the instance must only be used by a single thread.
+    class TLABAllocator : public Allocator, public ArenaObject {
+    public:
+        /// The byte alignment of all memory sectors.
+        static const uint32 ALIGNMENT = 16;
+        /// The byte granularity of the small size classes.
+        static const uint32 SIZE_CLASS_GRANULE = 16;
+        /// The number of small size classes with the capacity of a multiple of \c TLABAllocator::SIZE_CLASS_GRANULE.
+        static const uint32 SMALL_CLASS_COUNT = 16;
+        /// The number of all size classes, the capacity of the classes beyond the small classes doubles.
+        static const uint32 SIZE_CLASS_COUNT = SMALL_CLASS_COUNT + 12;
+        /// The capacity of the largest size class, larger memory sectors are reserved in a single oversize stack.
+        static const uint32 MAX_CLASS_CAPACITY = SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT << (SIZE_CLASS_COUNT -
+                                                                                           SMALL_CLASS_COUNT);
+
+        TLABAllocator(Management &management, TLABHeap &heap);
+
+        ~TLABAllocator();
+
+        Pointer *allocate(AllocateRequest &request) override;
+
+        void reserve(PointerActionRequest &request) override;
+
+        /// \attention Without a collector there is no cheaper mode for a non-exclusive acquisition, thus all
+        /// acquisitions are exclusive, the thread owning this allocator is allowed to acquire the same pointer
+        /// reentrantly.
+        void acquire(PointerAcquireRequest &request) override;
+
+        void release(PointerActionRequest &request) override;
+
+        void acquire_batch(PointerBatchAcquireRequest &request) override;
+
+        void release_batch(PointerBatchReleaseRequest &request) override;
+
+        /// Bump a small memory sector within the current buffer, unless a reserved pointer of its size class is
+        /// available for reuse.
+        inline Pointer *try_allocate(uint64 size);
+
+        /// Acquire a pointer biased towards this allocator which is not held.
+        inline uint8 *try_acquire(Pointer *pointer, bool exclusive);
+
+        /// Release a pointer biased towards this allocator which is held without reentrance.
+        inline bool try_release(Pointer *pointer);
+
+        /// \return The size class of a memory sector of \a size, or \c TLABAllocator::SIZE_CLASS_COUNT if \a size is
+        ///         larger than \c TLABAllocator::MAX_CLASS_CAPACITY.
+        static uint32 size_class_of(uint64 size);
+
+        /// \return The capacity of the memory sector of \a size padded to its size class.
+        static uint64 capacity_of(uint64 size);
+
+    private:
+        /// The heap wide structure of the root management.
+        TLABHeap *heap;
+        /// The bump address of the current buffer.
+        uint8 *tlab_top;
+        /// The end address of the current buffer.
+        uint8 *tlab_end;
+        /// The storage of the pointers allocated by this allocator.
+        TArena<TLABPointer> pointers;
+        /// The reserved pointers stacked by their size classes, the last stack holds the oversize pointers.
+        TLABPointer *reserved[SIZE_CLASS_COUNT + 1];
+        /// The client used to lock the pointers acquired from this allocator.
+        threading::ThinLockClient client;
+
+        /// Carve a memory section of \a size from the current heap chunk, a new chunk is mapped if the current one is
+        /// exhausted.
+        /// \return The address of the section, or \c nullptr with the error set to the \a request.
+        uint8 *carve(uint64 size, vm::Request &request);
+
+        /// Map a dedicated heap chunk for a memory sector larger than the chunk size.
+        /// \return The address of the chunk, or \c nullptr with the error set to the \a request.
+        uint8 *map_dedicated(uint64 size, vm::Request &request);
+    };
+
+    inline Pointer *TLABAllocator::try_allocate(uint64 size) {
+        if (size > SIZE_CLASS_GRANULE * SMALL_CLASS_COUNT) return nullptr;
+        uint32 size_class = size ? static_cast<uint32>(size - 1) / SIZE_CLASS_GRANULE : 0;
+        uint32 capacity = (size_class + 1) * SIZE_CLASS_GRANULE;
+        if (this->reserved[size_class] || capacity > static_cast<uint64>(this->tlab_end - this->tlab_top))
+            return nullptr;
+        uint8 *address = this->tlab_top;
+        this->tlab_top += capacity;
+        auto *pointer = new(this->pointers.allocate()) TLABPointer(static_cast<uint32>(size), address, capacity);
+        pointer->bias(this->client);
+        this->statistics.record_allocation(capacity);
+        return pointer;
+    }
+
+    inline uint8 *TLABAllocator::try_acquire(Pointer *pointer, bool) {
+        auto *target = static_cast<TLABPointer *>(pointer);
+        return this->client.try_wait(*target) ? target->address : nullptr;
+    }
+
+    inline bool TLABAllocator::try_release(Pointer *pointer) {
+        return this->client.try_exit(*static_cast<TLABPointer *>(pointer));
+    }
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_TLAB_HPP
@@ -0,0 +1,72 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "src/memory/snapshot.hpp"
+
+using namespace veil::memory;
+
+/// The offline analyzer of the heap snapshots written by TracingAllocator::snapshot, which prints the objects retaining
+/// the most memory together with their chains of dominators.
+/// Usage: memory_heap_analyzer <snapshot> [count]
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <snapshot> [count]" << std::endl;
+        return 2;
+    }
+    uint32 count = argc > 2 ? static_cast<uint32>(std::strtoul(argv[2], nullptr, 10)) : 20;
+
+    HeapSnapshot snapshot;
+    if (!snapshot.load(argv[1])) {
+        std::cerr << "Failed to load the heap snapshot: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    uint64 total_size = 0;
+    uint32 unreachable_count = 0;
+    std::vector<uint32> objects;
+    for (uint32 index = 1; index < snapshot.get_object_count(); index++) {
+        total_size += snapshot.get_capacity(index);
+        if (snapshot.get_dominator(index) == HeapSnapshot::NO_OBJECT) unreachable_count++;
+        objects.push_back(index);
+    }
+    std::cout << "Objects: " << snapshot.get_object_count() - 1 << ", total size: " << total_size
+              << ", reachable size: " << snapshot.get_retained_size(0) << ", unreachable objects: "
+              << unreachable_count << std::endl;
+
+    count = std::min(count, static_cast<uint32>(objects.size()));
+    std::partial_sort(objects.begin(), objects.begin() + count, objects.end(), [&](uint32 left, uint32 right) {
+        return snapshot.get_retained_size(left) > snapshot.get_retained_size(right);
+    });
+    std::cout << std::setw(20) << "retained" << std::setw(12) << "capacity" << std::setw(12) << "references"
+              << "  object <- dominators" << std::endl;
+    for (uint32 rank = 0; rank < count; rank++) {
+        uint32 index = objects[rank];
+        std::cout << std::setw(20) << snapshot.get_retained_size(index) << std::setw(12)
+                  << snapshot.get_capacity(index) << std::setw(12) << snapshot.get_reference_count(index) << "  0x"
+                  << std::hex << snapshot.get_identity(index);
+        // The chain of the dominators up to a root, which is the path keeping the object alive.
+        for (uint32 dominator = snapshot.get_dominator(index); dominator != HeapSnapshot::NO_OBJECT && dominator != 0;
+             dominator = snapshot.get_dominator(dominator))
+            std::cout << " <- 0x" << snapshot.get_identity(dominator);
+        std::cout << std::dec << std::endl;
+    }
+    return 0;
+}
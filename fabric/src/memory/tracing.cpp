@@ -0,0 +1,118 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include "src/memory/tracing.hpp"
+#include "src/memory/os.hpp"
+
+using namespace veil::memory;
+
+PointerStack::PointerStack(uint32 capacity) : count(0), capacity(capacity ? capacity : DEFAULT_CAPACITY) {
+    this->elements = static_cast<Pointer **>(os::malloc(this->capacity * sizeof(Pointer *)));
+}
+
+PointerStack::~PointerStack() {
+    os::free(this->elements);
+}
+
+void PointerStack::push(Pointer *pointer) {
+    if (this->count == this->capacity) {
+        auto **inflated = static_cast<Pointer **>(os::malloc(this->capacity * 2 * sizeof(Pointer *)));
+        memcpy(inflated, this->elements, this->count * sizeof(Pointer *));
+        os::free(this->elements);
+        this->elements = inflated;
+        this->capacity *= 2;
+    }
+    this->elements[this->count++] = pointer;
+}
+
+Pointer *PointerStack::pop() {
+    return this->count ? this->elements[--this->count] : nullptr;
+}
+
+bool PointerStack::remove(Pointer *pointer) {
+    for (uint32 index = 0; index < this->count; index++) {
+        if (this->elements[index] != pointer) continue;
+        this->elements[index] = this->elements[--this->count];
+        return true;
+    }
+    return false;
+}
+
+void PointerStack::transfer(PointerStack &target) {
+    for (uint32 index = 0; index < this->count; index++) target.push(this->elements[index]);
+    this->count = 0;
+}
+
+uint32 PointerStack::size() const { return this->count; }
+
+bool PointerStack::is_empty() const { return this->count == 0; }
+
+Pointer *PointerStack::at(uint32 index) const { return this->elements[index]; }
+
+bool PointerStack::contains(const Pointer *pointer) const {
+    for (uint32 index = 0; index < this->count; index++) {
+        if (this->elements[index] == pointer) return true;
+    }
+    return false;
+}
+
+PointerSet::PointerSet() : count(0), capacity(DEFAULT_CAPACITY) {
+    this->slots = static_cast<const Pointer **>(os::malloc(this->capacity * sizeof(Pointer *)));
+    memset(static_cast<void *>(this->slots), 0, this->capacity * sizeof(Pointer *));
+}
+
+PointerSet::~PointerSet() {
+    os::free(static_cast<void *>(this->slots));
+}
+
+uint64 PointerSet::slot_of(const Pointer *pointer) const {
+    // The pointers are aligned, thus the address is mixed before being masked by the power of 2 capacity.
+    uint64 slot = (reinterpret_cast<uint64>(pointer) * 0x9E3779B97F4A7C15ULL >> 32) & (this->capacity - 1);
+    while (this->slots[slot] != nullptr && this->slots[slot] != pointer) slot = (slot + 1) & (this->capacity - 1);
+    return slot;
+}
+
+bool PointerSet::insert(const Pointer *pointer) {
+    uint64 slot = this->slot_of(pointer);
+    if (this->slots[slot] == pointer) return false;
+
+    if ((this->count + 1) * 2 > this->capacity) {
+        const Pointer **previous = this->slots;
+        uint64 previous_capacity = this->capacity;
+        this->capacity *= 2;
+        this->slots = static_cast<const Pointer **>(os::malloc(this->capacity * sizeof(Pointer *)));
+        memset(static_cast<void *>(this->slots), 0, this->capacity * sizeof(Pointer *));
+        for (uint64 index = 0; index < previous_capacity; index++) {
+            if (previous[index] != nullptr) this->slots[this->slot_of(previous[index])] = previous[index];
+        }
+        os::free(static_cast<void *>(previous));
+        slot = this->slot_of(pointer);
+    }
+    this->slots[slot] = pointer;
+    this->count++;
+    return true;
+}
+
+bool PointerSet::contains(const Pointer *pointer) const {
+    return pointer != nullptr && this->slots[this->slot_of(pointer)] == pointer;
+}
+
+uint64 PointerSet::size() const { return this->count; }
+
+TracingAllocator::TracingAllocator(Management &management) : Allocator(management) {}
+
+void TracingAllocator::set_skipped_count(HeapSnapshotRequest &request, uint64 count) { request.skipped_count = count; }
@@ -0,0 +1,141 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_MEMORY_TRACING_HPP
+#define VEIL_FABRIC_SRC_MEMORY_TRACING_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/management.hpp"
+#include "src/memory/snapshot.hpp"
+#include "src/vm/structures.hpp"
+
+namespace veil::memory {
+
+    /// The memory management is agnostic of the layout of the VM objects, thus a tracing collector relies on the VM to
+    /// enumerate the pointers referenced by an object.
+    class ReferenceScanner {
+    public:
+        /// Enumerate the pointers referenced by the object of \a pointer to the \a visitor.
+        /// \attention The object is acquired by the caller during the scan, the scanner must not acquire any pointer
+        /// or allocate from the memory management by itself.
+        /// \param pointer The pointer of the object to be scanned.
+        /// \param address The current address of the object.
+        /// \param visitor The visitor of the referenced pointers, \c nullptr references are not required to be visited.
+        virtual void scan(Pointer &pointer, uint8 *address, vm::Consumer<Pointer *> &visitor) = 0;
+    };
+
+    /// A growable stack of pointers backed by the host heap, used as the mark stack of the tracing collectors.
+    class PointerStack : public ValueObject {
+    public:
+        static const uint32 DEFAULT_CAPACITY = 256;
+
+        explicit PointerStack(uint32 capacity = DEFAULT_CAPACITY);
+
+        ~PointerStack();
+
+        void push(Pointer *pointer);
+
+        /// \return The last pushed pointer, or \c nullptr if the stack is empty.
+        Pointer *pop();
+
+        /// Remove the first occurrence of the \a pointer, the order of the remaining pointers is not preserved.
+        /// \return Whether the \a pointer is found.
+        bool remove(Pointer *pointer);
+
+        /// Move all pointers of this stack onto the \a target.
+        void transfer(PointerStack &target);
+
+        [[nodiscard]] uint32 size() const;
+
+        [[nodiscard]] bool is_empty() const;
+
+        /// \return The pointer at the \a index from the bottom of the stack.
+        Pointer *at(uint32 index) const;
+
+        /// \return Whether the \a pointer is within the stack.
+        [[nodiscard]] bool contains(const Pointer *pointer) const;
+
+    private:
+        Pointer **elements;
+        uint32 count;
+        uint32 capacity;
+    };
+
+    /// A growable set of pointers backed by the host heap, used to track the objects visited by a traversal of the heap
+    /// which does not mark the objects. The pointers are stored in an open addressing table which is doubled once it
+    /// is half full.
+    class PointerSet : public ValueObject {
+    public:
+        static const uint32 DEFAULT_CAPACITY = 1024;
+
+        PointerSet();
+
+        ~PointerSet();
+
+        /// Insert the \a pointer into the set.
+        /// \return Whether the \a pointer is inserted, otherwise it is already within the set.
+        bool insert(const Pointer *pointer);
+
+        [[nodiscard]] bool contains(const Pointer *pointer) const;
+
+        [[nodiscard]] uint64 size() const;
+
+    private:
+        /// The slots of the table, \c nullptr for a vacant slot.
+        const Pointer **slots;
+        uint64 count;
+        uint64 capacity;
+
+        /// \return The slot holding the \a pointer, or the vacant slot where the \a pointer should be inserted.
+        [[nodiscard]] uint64 slot_of(const Pointer *pointer) const;
+    };
+
+    /// The \c Allocator of a tracing memory management algorithm. A pointer survives a collection only if it is
+    /// reachable from a registered root, or it is acquired when the marking of the collection terminates; thus a VM
+    /// thread holding a pointer which is not reachable from the heap must either register it as a root or keep it
+    /// acquired.
+    class TracingAllocator : public Allocator {
+    public:
+        explicit TracingAllocator(Management &management);
+
+        /// Register the pointer of the \a request as a root of the heap, a pointer can be registered more than once
+        /// and is a root until all registrations are removed.
+        virtual void add_root(PointerActionRequest &request) = 0;
+
+        /// Remove a registration of the pointer of the \a request as a root of the heap.
+        virtual void remove_root(PointerActionRequest &request) = 0;
+
+        /// Request a full collection of the heap and wait until it is completed.
+        virtual void collect(vm::Request &request) = 0;
+
+        /// Write a snapshot of the objects reachable from the roots and the acquired pointers with
+        /// \c HeapSnapshotWriter to the file of \c HeapSnapshotRequest::path, \c memory::ERR_SNAPSHOT_IO is set to the
+        /// \a request if the file cannot be written. The collections are held off while the snapshot is written, while
+        /// the VM threads keep running, thus the references stored during the snapshot might not be captured.
+        /// \attention The pointers held by other allocators when the snapshot starts are written without their
+        /// references and counted by \c HeapSnapshotRequest::get_skipped_count, as their holders might be waiting for
+        /// a collection held off by the snapshot. The other pointers are acquired before scanned, thus a VM thread
+        /// must not wait for a collection while holding a pointer it acquired after a snapshot has started.
+        virtual void snapshot(HeapSnapshotRequest &request) = 0;
+
+    protected:
+        /// Return the number of the objects skipped by the snapshot to the \a request.
+        static void set_skipped_count(HeapSnapshotRequest &request, uint64 count);
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_MEMORY_TRACING_HPP
@@ -104,14 +104,14 @@ uint32 atomic_u32_t::fetch_add(uint32 value) {
 
 uint32 atomic_u32_t::fetch_sub(uint32 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedExchangeSubtract((volatile uint32 *) &this->embedded, static_cast<uint32>(value));
+    return InterlockedAdd((volatile LONG *) &this->embedded, -static_cast<int32>(value));
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
     // https://gcc.gnu.org/onlinedocs/gcc-4.7.2/gcc/_005f_005fatomic-Builtins.html#g_t_005f_005fatomic-Builtins
 
     // Using __ATOMIC_SEQ_CST makes atomic operation an optimization barrier, and ensures consistency across threads.
-    return __atomic_add_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
+    return __atomic_sub_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
 #   else
 #   error "Atomic operations not supported in the current build environment."
 #   endif
@@ -120,14 +120,15 @@ uint32 atomic_u32_t::fetch_sub(uint32 value) {
 
 uint32 atomic_u32_t::fetch_or(uint32 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedOr((volatile LONG *) &this->embedded, static_cast<int32>(value));
+    // The Interlocked bitwise operations return the initial value, which is combined with the operand.
+    return InterlockedOr((volatile LONG *) &this->embedded, static_cast<int32>(value)) | value;
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
     // https://gcc.gnu.org/onlinedocs/gcc-4.7.2/gcc/_005f_005fatomic-Builtins.html#g_t_005f_005fatomic-Builtins
 
     // Using __ATOMIC_SEQ_CST makes atomic operation an optimization barrier, and ensures consistency across threads.
-    return __atomic_add_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
+    return __atomic_or_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
 #   else
 #   error "Atomic operations not supported in the current build environment."
 #   endif
@@ -136,14 +137,14 @@ uint32 atomic_u32_t::fetch_or(uint32 value) {
 
 uint32 atomic_u32_t::fetch_xor(uint32 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedXor((volatile LONG *) &this->embedded, static_cast<int32>(value));
+    return InterlockedXor((volatile LONG *) &this->embedded, static_cast<int32>(value)) ^ value;
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
     // https://gcc.gnu.org/onlinedocs/gcc-4.7.2/gcc/_005f_005fatomic-Builtins.html#g_t_005f_005fatomic-Builtins
 
     // Using __ATOMIC_SEQ_CST makes atomic operation an optimization barrier, and ensures consistency across threads.
-    return __atomic_add_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
+    return __atomic_xor_fetch((volatile uint32 *) &this->embedded, value, __ATOMIC_SEQ_CST);
 #   else
 #   error "Atomic operations not supported in the current build environment."
 #   endif
@@ -229,7 +230,7 @@ uint64 atomic_u64_t::fetch_add(uint64 value) {
 
 uint64 atomic_u64_t::fetch_sub(uint64 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedExchangeSubtract((volatile unsigned long long *) &this->embedded, static_cast<int64>(value));
+    return InterlockedAdd64((volatile LONG64 *) &this->embedded, -static_cast<int64>(value));
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
@@ -245,7 +246,8 @@ uint64 atomic_u64_t::fetch_sub(uint64 value) {
 
 uint64 atomic_u64_t::fetch_or(uint64 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedOr64((volatile LONGLONG *) &this->embedded, static_cast<int64>(value));
+    // The Interlocked bitwise operations return the initial value, which is combined with the operand.
+    return InterlockedOr64((volatile LONGLONG *) &this->embedded, static_cast<int64>(value)) | value;
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
@@ -261,7 +263,7 @@ uint64 atomic_u64_t::fetch_or(uint64 value) {
 
 uint64 atomic_u64_t::fetch_xor(uint64 value) {
 #   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-    return InterlockedXor64((volatile LONG64 *) &this->embedded, static_cast<int64>(value));
+    return InterlockedXor64((volatile LONG64 *) &this->embedded, static_cast<int64>(value)) ^ value;
 #   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 #   if defined(__GNUC__) || defined(__GNUG__)
     // Using the GNU implementation available with the GCC compiler:
@@ -20,6 +20,8 @@
 
 namespace veil::os {
 
+    /// The atomic operations are sequentially consistent, the <code>fetch_*</code> operations return the value
+    /// resulting from the operation on all platforms, while <code>compare_exchange</code> returns the value witnessed.
     struct atomic_u32_t {
     public:
         explicit atomic_u32_t(uint32 initial);
@@ -42,6 +44,11 @@ namespace veil::os {
 
     private:
         uint32 embedded;
+
+        // The futex operations wait on the address of the embedded value.
+        friend void futex_wait(const atomic_u32_t &word, uint32 expected);
+
+        friend void futex_wake(atomic_u32_t &word, uint32 count);
     };
 
     struct atomic_u64_t {
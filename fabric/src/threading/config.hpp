@@ -33,6 +33,14 @@ namespace veil::threading::config {
     /// considered to be in a deadlock state, thus the abort is justified.
     static uint32 pause_request_wait_milliseconds = 60000; // 1 minute by default.
 
+    /// The default number of the threads started by the scheduler ahead of any service, which are kept warm in the
+    /// idle state to host the services without spawning OS threads.
+    static uint32 thread_pool_min_size = 4;
+
+    /// The default maximum number of the threads of the scheduler, which bounds the spawning of the OS threads; the
+    /// services started beyond are deferred until a thread returns.
+    static uint32 thread_pool_max_size = 256;
+
 }
 
 #endif //VEIL_FABRIC_SRC_THREADING_CONFIG_HPP
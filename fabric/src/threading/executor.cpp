@@ -0,0 +1,209 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+
+#include "src/threading/executor.hpp"
+#include "src/threading/work-stealing-deque.hpp"
+#include "src/memory/os.hpp"
+#include "src/vm/diagnostics.hpp"
+
+using namespace veil::threading;
+
+/// The executor and the index of the worker hosted by the calling thread, which are set by the worker throughout its
+/// loop; thus a job submitted by a worker is pushed to its own deque.
+static thread_local Executor *current_executor = nullptr;
+static thread_local uint32 current_worker_index = 0;
+
+class Executor::Worker : public VMService {
+public:
+    Worker(Executor &executor, uint32 index) :
+            VMService("Runtime:ExecutorWorker-" + std::to_string(index)), executor(&executor), index(index),
+            deque(DEQUE_CAPACITY), woken(false), start_task(*this) {
+        // The task is inactive until the executor is started, thus the worker can be destructed if never started.
+        start_task.inactivate();
+    }
+
+    void run() override;
+
+    void on_wake() override {
+        // The parked worker is woken to respond to the scheduler, the flag is set before the notification thus the
+        // worker preparing to park will not miss it.
+        woken.store(true);
+        executor->work_event.notify_all();
+    }
+
+    Executor *executor;
+    const uint32 index;
+    WorkStealingDeque<vm::Executable> deque;
+    /// Whether the worker is woken by the scheduler since it last parked.
+    os::atomic_bool_t woken;
+    Scheduler::StartServiceTask start_task;
+};
+
+void Executor::Worker::run() {
+    current_executor = this->executor;
+    current_worker_index = this->index;
+    while (true) {
+        // The jobs are short, thus the worker responds to the scheduler between the jobs.
+        pause_if_requested();
+        if (is_interrupted() || executor->shutdown_requested.load()) break;
+
+        vm::Executable *job = executor->find_job(this);
+        if (job != nullptr) {
+            job->execute();
+            continue;
+        }
+
+        // NOTE: The wait is prepared before the jobs and the requests are checked again, while the submitters push the
+        // job before notifying the work_event; thus either the worker observes the job or the notification wakes it.
+        uint32 key = executor->work_event.prepare_wait();
+        if (woken.exchange(false) || is_interrupted() || executor->shutdown_requested.load() ||
+            executor->has_pending_job())
+            executor->work_event.cancel_wait();
+        else executor->work_event.wait(key);
+    }
+    current_executor = nullptr;
+}
+
+Executor::Executor(uint32 worker_count) :
+        worker_count(worker_count ? worker_count : 1), shutdown_requested(false), injected_jobs(nullptr),
+        injection_capacity(0), injection_head(0), injected_count(0) {
+    this->workers = static_cast<Worker *>(os::malloc(this->worker_count * sizeof(Worker)));
+    // The class forbids the allocation of arrays, thus the elements are constructed in place explicitly.
+    for (uint32 index = 0; index < this->worker_count; index++) ::new(&this->workers[index]) Worker(*this, index);
+}
+
+Executor::~Executor() {
+    for (uint32 index = 0; index < this->worker_count; index++) this->workers[index].~Worker();
+    os::free(this->workers);
+    if (this->injected_jobs != nullptr) os::free(this->injected_jobs);
+}
+
+uint32 Executor::get_worker_count() const { return this->worker_count; }
+
+void Executor::start(Scheduler &scheduler) {
+    for (uint32 index = 0; index < this->worker_count; index++) {
+        Worker &worker = this->workers[index];
+        worker.start_task.reset_state_for_reuse();
+        scheduler.add_task(worker.start_task);
+    }
+    scheduler.notify();
+}
+
+void Executor::shutdown() {
+    shutdown_requested.store(true);
+    work_event.notify_all();
+}
+
+void Executor::submit(vm::Executable &job) {
+    Worker *worker = current_worker();
+    // The jobs submitted by the other threads, or overflown from the deque of the worker, are shared by all workers.
+    if (worker == nullptr || !worker->deque.push(&job)) inject(job);
+    // A single job is taken by a single thread, thus waking all parked workers would mostly park them again.
+    work_event.notify_one();
+}
+
+Executor::Worker *Executor::current_worker() {
+    return current_executor == this ? &this->workers[current_worker_index] : nullptr;
+}
+
+void Executor::inject(vm::Executable &job) {
+    os::CriticalSection _(injection_m);
+
+    uint32 count = injected_count.load();
+    if (count == this->injection_capacity) {
+        // The ring is full, the jobs are moved to a ring of the double capacity in the order of the queue.
+        uint32 capacity = this->injection_capacity ? this->injection_capacity * 2 : 64;
+        auto jobs = static_cast<vm::Executable **>(os::malloc(capacity * sizeof(vm::Executable *)));
+        for (uint32 index = 0; index < count; index++)
+            jobs[index] = this->injected_jobs[(this->injection_head + index) % this->injection_capacity];
+        if (this->injected_jobs != nullptr) os::free(this->injected_jobs);
+        this->injected_jobs = jobs;
+        this->injection_capacity = capacity;
+        this->injection_head = 0;
+    }
+    this->injected_jobs[(this->injection_head + count) % this->injection_capacity] = &job;
+    (void) injected_count.fetch_add(1);
+}
+
+veil::vm::Executable *Executor::take_injected() {
+    // The mutex is not acquired for the empty queue, which is the common case.
+    if (injected_count.load() == 0) return nullptr;
+    os::CriticalSection _(injection_m);
+
+    if (injected_count.load() == 0) return nullptr;
+    vm::Executable *job = this->injected_jobs[this->injection_head];
+    this->injection_head = (this->injection_head + 1) % this->injection_capacity;
+    (void) injected_count.fetch_sub(1);
+    return job;
+}
+
+veil::vm::Executable *Executor::find_job(Worker *worker) {
+    vm::Executable *job;
+    if (worker != nullptr && (job = worker->deque.pop()) != nullptr) return job;
+    if ((job = take_injected()) != nullptr) return job;
+    // The victims are visited from the next worker onwards, thus the thieves are spread across the workers.
+    uint32 first = worker != nullptr ? worker->index + 1 : 0;
+    for (uint32 offset = 0; offset < this->worker_count; offset++) {
+        Worker &victim = this->workers[(first + offset) % this->worker_count];
+        if (&victim == worker) continue;
+        if ((job = victim.deque.steal()) != nullptr) return job;
+    }
+    return nullptr;
+}
+
+bool Executor::has_pending_job() const {
+    if (injected_count.load() != 0) return true;
+    for (uint32 index = 0; index < this->worker_count; index++)
+        if (!this->workers[index].deque.is_empty()) return true;
+    return false;
+}
+
+Executor::Job::Job(vm::Executable &target) : target(&target), group(nullptr) {}
+
+void Executor::Job::execute() {
+    // The group might go out of scope as soon as its last job is completed, thus it is not accessed afterwards.
+    Group *owner = this->group;
+    Executor *executor = owner->executor;
+    target->execute();
+    if (owner->pending.fetch_sub(1) == 0) executor->work_event.notify_all();
+}
+
+Executor::Group::Group(Executor &executor) : executor(&executor), pending(0) {}
+
+Executor::Group::~Group() { VeilAssert(pending.load() == 0, "Invalid going out of scope."); }
+
+void Executor::Group::fork(Job &job) {
+    job.group = this;
+    (void) pending.fetch_add(1);
+    executor->submit(job);
+}
+
+void Executor::Group::join() {
+    Worker *worker = executor->current_worker();
+    while (pending.load() != 0) {
+        // The joining thread helps to execute the pending jobs, which are likely the jobs of this group.
+        vm::Executable *job = executor->find_job(worker);
+        if (job != nullptr) {
+            job->execute();
+            continue;
+        }
+        // The remaining jobs are being executed by the other workers, which notify the work_event upon completion.
+        uint32 key = executor->work_event.prepare_wait();
+        if (pending.load() == 0 || executor->has_pending_job()) executor->work_event.cancel_wait();
+        else executor->work_event.wait(key);
+    }
+}
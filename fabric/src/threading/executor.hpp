@@ -0,0 +1,144 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_THREADING_EXECUTOR_HPP
+#define VEIL_FABRIC_SRC_THREADING_EXECUTOR_HPP
+
+#include "src/memory/global.hpp"
+#include "src/threading/os.hpp"
+#include "src/threading/scheduler.hpp"
+#include "src/vm/structures.hpp"
+
+namespace veil::threading {
+
+    /// A fixed-size pool of workers executing short jobs, for the fine-grained work which is too heavy to be hosted by
+    /// a <code>VMService</code> of its own, for example the parallel marking of the garbage collector.<br><br>
+    /// Each worker is a <code>VMService</code> hosted by a <code>VMThread</code> of the <code>Scheduler</code>, which
+    /// owns a <code>WorkStealingDeque</code> of jobs: the jobs submitted by a worker are pushed to its own deque and
+    /// popped in the last-in-first-out order, while an idle worker steals the oldest jobs from the other workers; the
+    /// jobs submitted by any other thread are queued to a shared injection queue. The workers without any job are
+    /// parked until a job is submitted.<br><br>
+    /// The workers respond to the pause requests of the scheduler between the jobs, and leave their loops upon the
+    /// termination of the scheduler or <code>Executor::shutdown()</code>.
+    /// \attention As any other <code>VMService</code>, the executor must outlive the task loop of the scheduler, which
+    /// is until <code>Scheduler::start()</code> returns. Each worker occupies a thread of the scheduler until it
+    /// leaves, thus the maximum pool size of the scheduler must leave room for the other services.
+    class Executor : public memory::ValueObject {
+    public:
+        class Job;
+        class Group;
+
+    private:
+        class Worker;
+
+    public:
+        /// The maximum number of the jobs in the deque of a worker, the jobs submitted beyond are queued to the shared
+        /// injection queue.
+        static const uint32 DEQUE_CAPACITY = 1024;
+
+        /// \param worker_count The number of the workers, the value <code>0</code> is treated as <code>1</code>.
+        explicit Executor(uint32 worker_count);
+
+        ~Executor();
+
+        /// Start the workers by adding their services to the <code>scheduler</code>, which might be invoked before
+        /// <code>Scheduler::start()</code>.
+        void start(Scheduler &scheduler);
+
+        /// Request the workers to leave their loops, the jobs yet to be executed are abandoned.
+        void shutdown();
+
+        /// Submit the <code>job</code> without waiting for its completion, which is executed by any of the workers.
+        /// \attention The <code>job</code> must outlive its execution, use <code>Executor::Group</code> to wait for
+        /// the completion of the jobs.
+        void submit(vm::Executable &job);
+
+        [[nodiscard]] uint32 get_worker_count() const;
+
+    private:
+        const uint32 worker_count;
+        Worker *workers;
+        os::atomic_bool_t shutdown_requested;
+        /// Notified on the submission of a job and the completion of a group, on which both the idle workers and the
+        /// threads joining a group are parked.
+        os::EventCount work_event;
+
+        /// The shared injection queue of the jobs submitted by the threads other than the workers, or overflown from
+        /// the deque of a worker; the jobs are kept in a ring growing on demand.
+        os::Mutex injection_m;
+        vm::Executable **injected_jobs;
+        uint32 injection_capacity;
+        uint32 injection_head;
+        /// The number of the jobs in the injection queue, which is read without the mutex to skip the empty queue.
+        os::atomic_u32_t injected_count;
+
+        void inject(vm::Executable &job);
+
+        vm::Executable *take_injected();
+
+        /// Find a job to execute for the <code>worker</code>, which is <code>nullptr</code> if the calling thread is
+        /// not a worker of this executor: the deque of the worker is popped first, then the injection queue, then the
+        /// deques of the other workers are stolen in turn.
+        vm::Executable *find_job(Worker *worker);
+
+        /// \return Whether any job is submitted and yet to be taken.
+        [[nodiscard]] bool has_pending_job() const;
+
+        /// \return The worker of this executor hosted by the calling thread, or <code>nullptr</code>.
+        Worker *current_worker();
+    };
+
+    /// A job forked within an <code>Executor::Group</code>, which executes the target and accounts its completion to
+    /// the group. The job is owned by the forking thread and can be reused after the group is joined.
+    class Executor::Job : public memory::ValueObject, public vm::Executable {
+    public:
+        explicit Job(vm::Executable &target);
+
+        void execute() override;
+
+    private:
+        vm::Executable *target;
+        Group *group;
+
+        friend class Group;
+    };
+
+    /// The scope of a fork-join computation, the jobs forked are executed by the executor concurrently and joined
+    /// altogether. A job might fork and join its own group, thus the computation can be divided recursively.
+    /// \attention The group must be joined before it goes out of scope.
+    class Executor::Group : public memory::ValueObject {
+    public:
+        explicit Group(Executor &executor);
+
+        ~Group();
+
+        /// Submit the <code>job</code> to the executor within this group.
+        void fork(Job &job);
+
+        /// Wait until all the jobs forked are completed, the calling thread executes the pending jobs of the executor
+        /// while waiting; thus a worker joining a group never starves the jobs it is waiting for.
+        void join();
+
+    private:
+        Executor *executor;
+        /// The number of the jobs forked and yet to be completed.
+        os::atomic_u32_t pending;
+
+        friend class Job;
+    };
+
+}
+
+#endif //VEIL_FABRIC_SRC_THREADING_EXECUTOR_HPP
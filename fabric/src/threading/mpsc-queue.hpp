@@ -0,0 +1,86 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_THREADING_MPSC_QUEUE_HPP
+#define VEIL_FABRIC_SRC_THREADING_MPSC_QUEUE_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/threading/atomic.hpp"
+
+namespace veil::threading {
+
+    /// An intrusive lock-free queue of multiple producers and a single consumer, the elements are linked by their
+    /// member <code>NEXT</code>, thus the queue never allocates. The producers push onto an atomic stack with a
+    /// compare-exchange, while the consumer takes the whole stack at once with an exchange and reverses it into the
+    /// pushing order; thus the consumer drains the elements in batches without any synchronization per element.
+    /// \attention An element must not be pushed again until it is drained, as its link is owned by the queue until
+    /// then.
+    template<typename T, T *T::*NEXT>
+    class MPSCQueue : public memory::ValueObject {
+    public:
+        MPSCQueue();
+
+        /// Push the <code>element</code>, which is safe to be invoked by any number of threads concurrently.
+        /// \return Whether the queue was empty before the push.
+        bool push(T &element);
+
+        /// Take all the elements pushed so far, only invoked by the consumer.
+        /// \return The first element in the pushing order, the rest are linked by <code>NEXT</code> until
+        ///         <code>nullptr</code>; or <code>nullptr</code> if the queue is empty.
+        T *drain();
+
+        [[nodiscard]] bool is_empty() const;
+
+    private:
+        /// The element pushed last, which links to the elements pushed before it.
+        os::atomic_pointer_t<T> head;
+    };
+
+    template<typename T, T *T::*NEXT>
+    MPSCQueue<T, NEXT>::MPSCQueue() : head(nullptr) {}
+
+    template<typename T, T *T::*NEXT>
+    bool MPSCQueue<T, NEXT>::push(T &element) {
+        T *observed = head.load();
+        while (true) {
+            element.*NEXT = observed;
+            // The link is published along the element by the exchange, the elements below the head are never taken
+            // individually thus the exchange is free from the ABA problem.
+            T *witnessed = head.compare_exchange(observed, &element);
+            if (witnessed == observed) return observed == nullptr;
+            observed = witnessed;
+        }
+    }
+
+    template<typename T, T *T::*NEXT>
+    T *MPSCQueue<T, NEXT>::drain() {
+        T *current = head.exchange(nullptr);
+        T *reversed = nullptr;
+        while (current != nullptr) {
+            T *next = current->*NEXT;
+            current->*NEXT = reversed;
+            reversed = current;
+            current = next;
+        }
+        return reversed;
+    }
+
+    template<typename T, T *T::*NEXT>
+    bool MPSCQueue<T, NEXT>::is_empty() const { return head.load() == nullptr; }
+
+}
+
+#endif //VEIL_FABRIC_SRC_THREADING_MPSC_QUEUE_HPP
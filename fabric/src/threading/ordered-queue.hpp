@@ -43,7 +43,9 @@ namespace veil::threading {
         friend class OrderedQueuee;
     };
 
-    class OrderedQueuee : memory::ArenaObject {
+    /// Each queuee is aligned to a cache line, as the flags of a queuee are spun on by the thread queued behind,
+    /// sharing a cache line with a neighbouring queuee in the <code>TArena</code> will stall the unrelated threads.
+    class alignas(memory::CACHE_LINE_SIZE) OrderedQueuee : memory::ArenaObject {
     public:
         /// The idle value for <code>OrderedQueuee::status</code> flag.
         static const uint8 STAT_IDLE = 0;
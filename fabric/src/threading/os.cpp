@@ -17,13 +17,23 @@
 
 #include <windows.h>
 
+// The library of WaitOnAddress and WakeByAddress.
+#pragma comment(lib, "Synchronization.lib")
+
 #elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <cerrno>
+#include <climits>
 #include <sys/time.h>
 
+#if !defined(__CYGWIN__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #endif
 
 #include "src/threading/os.hpp"
@@ -574,3 +584,68 @@ void ConditionVariable::notify_all() {
 CriticalSection::CriticalSection(Mutex &mutex) : mutex(&mutex) { mutex.lock(); }
 
 CriticalSection::~CriticalSection() { mutex->unlock(); }
+
+void veil::os::futex_wait(const atomic_u32_t &word, uint32 expected) {
+    auto *address = const_cast<uint32 *>(&word.embedded);
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // Implementation of the following have taken reference from:
+    // https://learn.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-waitonaddress
+    WaitOnAddress(address, &expected, sizeof(uint32), INFINITE);
+#   elif defined(__CYGWIN__)
+    // Cygwin does not provide futex, the wait degrades into yielding which is permitted as a spurious return.
+    (void) address;
+    (void) expected;
+    sched_yield();
+#   elif defined(__linux__) || defined(__linux) || defined(linux)
+    // Implementation of the following have taken reference from:
+    // https://man7.org/linux/man-pages/man2/futex.2.html
+    // The syscall returns immediately with EAGAIN if the value is no longer expected, and EINTR is a spurious return;
+    // both are handled by the caller checking the value again.
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#   endif
+}
+
+void veil::os::futex_wake(atomic_u32_t &word, uint32 count) {
+    uint32 *address = &word.embedded;
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    // Implementation of the following have taken reference from:
+    // https://learn.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-wakebyaddressall
+    if (count == 1) WakeByAddressSingle(address);
+    else WakeByAddressAll(address);
+#   elif defined(__CYGWIN__)
+    (void) address;
+    (void) count;
+#   elif defined(__linux__) || defined(__linux) || defined(linux)
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count > INT_MAX ? INT_MAX : static_cast<int>(count), nullptr,
+            nullptr, 0);
+#   endif
+}
+
+EventCount::EventCount() : epoch(0), waiter_count(0) {}
+
+uint32 EventCount::prepare_wait() {
+    // The announcement precedes the load of the epoch, while a notifier advances the epoch only after it observes the
+    // announcement; as both are sequentially consistent, a notification is either observed by the waiting thread
+    // through its check of the condition, or it advances the epoch beyond the key.
+    (void) this->waiter_count.fetch_add(1);
+    return this->epoch.load();
+}
+
+void EventCount::cancel_wait() { (void) this->waiter_count.fetch_sub(1); }
+
+void EventCount::wait(uint32 key) {
+    while (this->epoch.load() == key) futex_wait(this->epoch, key);
+    (void) this->waiter_count.fetch_sub(1);
+}
+
+void EventCount::notify_one() {
+    if (!this->waiter_count.load()) return;
+    (void) this->epoch.fetch_add(1);
+    futex_wake(this->epoch, 1);
+}
+
+void EventCount::notify_all() {
+    if (!this->waiter_count.load()) return;
+    (void) this->epoch.fetch_add(1);
+    futex_wake(this->epoch, UINT32_MAX);
+}
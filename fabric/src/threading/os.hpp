@@ -91,6 +91,56 @@ namespace veil::os {
         void *os_cv;
     };
 
+    /// Block the calling thread while the <code>word</code> holds the <code>expected</code> value, until it is woken by
+    /// <code>os::futex_wake()</code>; the wait might return spuriously, thus the caller must check the value again.
+    /// <ul>
+    ///     <li> For Win32 we uses <code>WaitOnAddress</code> as the backend. </li>
+    ///     <li> For Linux we uses the <code>futex</code> syscall as the backend. </li>
+    /// </ul>
+    void futex_wait(const atomic_u32_t &word, uint32 expected);
+
+    /// Wake up to <code>count</code> threads blocked by <code>os::futex_wait()</code> on the <code>word</code>.
+    void futex_wake(atomic_u32_t &word, uint32 count);
+
+    /// An event count which allows a thread to wait for a condition without a mutex and without missing a notification
+    /// issued between its check of the condition and its wait, the protocol of the waiting thread is:
+    /// <pre>
+    /// uint32 key = event.prepare_wait();
+    /// if (condition) event.cancel_wait(); else event.wait(key);
+    /// </pre>
+    /// While the notifying thread satisfies the condition before invoking <code>EventCount::notify_all()</code>, a
+    /// single notification is enough to wake the waiting threads, and the notification costs a single load if no
+    /// thread is waiting.
+    class EventCount : public memory::ValueObject {
+    public:
+        EventCount();
+
+        /// Announce the calling thread as a waiting thread, which must be followed by either <code>
+        /// EventCount::wait()</code> or <code>EventCount::cancel_wait()</code>.
+        /// \return The key of the current epoch to be passed to <code>EventCount::wait()</code>.
+        [[nodiscard]] uint32 prepare_wait();
+
+        /// Withdraw the announcement of <code>EventCount::prepare_wait()</code> if the condition is satisfied.
+        void cancel_wait();
+
+        /// Block until a notification is issued after the <code>key</code> is taken, which returns immediately if the
+        /// notification is already issued.
+        void wait(uint32 key);
+
+        /// Wake a single thread waiting on this event count, which suits a notification satisfying the condition of
+        /// only one waiting thread; the other waiting threads which are yet to block return from their wait anyway.
+        void notify_one();
+
+        /// Wake all the threads waiting on this event count.
+        void notify_all();
+
+    private:
+        /// Advanced by each notification with waiting threads, the waiting threads are blocked on this value.
+        atomic_u32_t epoch;
+        /// The number of the threads between <code>EventCount::prepare_wait()</code> and the end of their wait.
+        atomic_u32_t waiter_count;
+    };
+
     class Thread : public memory::ValueObject {
     public:
         static void static_sleep(uint32 milliseconds);
@@ -15,6 +15,8 @@
 
 #include "src/threading/config.hpp"
 #include "src/threading/scheduler.hpp"
+#include "src/threading/mpsc-queue.hpp"
+#include "src/memory/os.hpp"
 #include "src/vm/os.hpp"
 #include "src/util/hash.hpp"
 
@@ -28,63 +30,102 @@ static const uint64 NULL_SERVICE_IDENTIFIER = ~0ULL;
 /// upon their instantiation using fetch-add operation. Starting from <code>0</code>, <code>VMService</code> that spawn
 /// earlier will take smaller value.
 static veil::os::atomic_u64_t global_vm_service_identifier_distribution(0);
+/// The event count notified on the completion of every task, a single event count is shared by all the tasks as the
+/// waiting for a task is rare, and it must outlive the tasks which might be destructed as soon as they complete.
+static veil::os::EventCount task_completion_event;
 
-ScheduledTask::ScheduledTask() : request_thread_waiting(false), prev(this), next(this), signal_completed(false),
-                                 task_active(true) {}
+ScheduledTask::ScheduledTask() : next(nullptr), signal_completed(false), task_active(true) {}
 
 ScheduledTask::~ScheduledTask() {
     // As the ScheduledTask will typically being registered into the task loop of the Scheduler, it cannot be destructed
-    // before being processed and the awakening of the request thread waiting for the task completion.
-    VeilAssert(!task_active.load() || signal_completed && !request_thread_waiting, "Invalid going out of scope.");
+    // before being processed.
+    VeilAssert(!task_active.load() || signal_completed.load(), "Invalid going out of scope.");
 }
 
 void ScheduledTask::wait_for_completion() {
-    this->request_thread_waiting = true;
-    // Wait until the task is being completed by the scheduler.
-    while (this->signal_completed) this->request_thread_cv.wait();
-    // Since the scheduler will wait until the waiting thread signals its wake, we have to set this flag to true.
-    this->request_thread_waiting = false;
+    // Wait until the task is being completed by the scheduler, the completion is checked again after the wait is
+    // prepared, thus the notification issued in between is not missed.
+    while (!this->signal_completed.load()) {
+        uint32 key = task_completion_event.prepare_wait();
+        if (this->signal_completed.load()) task_completion_event.cancel_wait();
+        else task_completion_event.wait(key);
+    }
 }
 
 void ScheduledTask::reset_state_for_reuse() {
     task_active.store(true);
-    request_thread_waiting = false;
-    signal_completed = false;
+    signal_completed.store(false);
 }
 
 void ScheduledTask::inactivate() { this->task_active.store(false); }
 
-void ScheduledTask::connect_last(ScheduledTask &task) {
-    // Connect the previous task to the new task.
-    this->prev->next = &task;
-    task.prev = this->prev;
+uint64 ScheduledTask::get_shard_key() const { return reinterpret_cast<uint64>(this); }
 
-    // Connect this task to the new task.
-    this->prev = &task;
-    task.next = this;
-}
+void ScheduledTask::on_completed(Scheduler &) { this->signal_completed.store(true); }
+
+class Scheduler::Shard : public memory::ValueObject, public vm::Executable {
+public:
+    explicit Shard(Scheduler &scheduler) : scheduler(&scheduler), batch(nullptr), realtime_batch(nullptr) {}
+
+    /// The entry of the worker thread hosting this shard.
+    void execute() override { scheduler->process(*this); }
+
+    /// \return Whether both queues are empty, the batches already taken by the worker are not accounted.
+    [[nodiscard]] bool is_queue_empty() const { return tasks.is_empty() && realtime_tasks.is_empty(); }
+
+    /// Take the next task to process, the realtime tasks are taken ahead of the batch of the normal tasks; only
+    /// invoked by the worker.
+    /// \return The next task, or <code>nullptr</code> if there are no task left to do.
+    ScheduledTask *take() {
+        if (realtime_batch == nullptr && !realtime_tasks.is_empty()) realtime_batch = realtime_tasks.drain();
+        if (realtime_batch == nullptr && batch == nullptr) batch = tasks.drain();
+        ScheduledTask **source = realtime_batch != nullptr ? &realtime_batch : &batch;
+        ScheduledTask *task = *source;
+        if (task != nullptr) *source = task->next;
+        return task;
+    }
 
-void ScheduledTask::connect_next(ScheduledTask &task) {
-    // Connect the next task to the new task.
-    this->next->prev = &task;
-    task.next = this->next;
+    Scheduler *scheduler;
+    /// This is used by the worker to park itself when there are no task left to do, and should only be notified by
+    /// the method <code>Scheduler::notify()</code> only.
+    os::EventCount process_cycle_event;
+    /// The queues of the tasks added by <code>Scheduler::add_task()</code> and <code>Scheduler::add_realtime_task()
+    /// </code>, which the producers push without blocking the worker.
+    MPSCQueue<ScheduledTask, &ScheduledTask::next> tasks;
+    MPSCQueue<ScheduledTask, &ScheduledTask::next> realtime_tasks;
+    /// The batches drained from the queues yet to be processed, only accessed by the worker.
+    ScheduledTask *batch;
+    ScheduledTask *realtime_batch;
+    /// The thread hosting the worker of this shard, unused by the first shard which is hosted by the thread calling
+    /// <code>Scheduler::start()</code>.
+    os::Thread worker_thread;
+};
 
-    // Connect this task to the new task.
-    this->next = &task;
-    task.prev = this;
+Scheduler::Scheduler(uint32 worker_count, uint32 pool_min_size, uint32 pool_max_size) :
+        termination_requested(false), worker_count(worker_count ? worker_count : 1), pool_min_size(pool_min_size),
+        pool_max_size(pool_max_size > pool_min_size ? pool_max_size : (pool_min_size ? pool_min_size : 1)),
+        thread_count(0), first_deferred_service(nullptr), last_deferred_service(nullptr) {
+    this->shards = static_cast<Shard *>(os::malloc(this->worker_count * sizeof(Shard)));
+    // The class forbids the allocation of arrays, thus the elements are constructed in place explicitly.
+    for (uint32 index = 0; index < this->worker_count; index++) ::new(&this->shards[index]) Shard(*this);
 }
 
-void ScheduledTask::disconnect() {
-    // Connect the previous task to the next task.
-    this->prev->next = this->next;
-    this->next->prev = this->prev;
+Scheduler::~Scheduler() {
+    for (uint32 index = 0; index < this->worker_count; index++) this->shards[index].~Shard();
+    os::free(this->shards);
 }
 
-ScheduledTask *ScheduledTask::get_next() { return next; }
+uint32 Scheduler::get_worker_count() const { return this->worker_count; }
 
-ScheduledTask *ScheduledTask::get_prev() { return prev; }
+uint32 Scheduler::get_thread_count() {
+    os::CriticalSection _(thread_m);
+    return this->thread_count;
+}
 
-Scheduler::Scheduler() : process_cycle_paused(true), current_task(nullptr), termination_requested(false) {}
+Scheduler::Shard &Scheduler::shard_of(ScheduledTask &task) {
+    if (this->worker_count == 1) return this->shards[0];
+    return this->shards[util::standard_u64_hash_function(task.get_shard_key()) % this->worker_count];
+}
 
 class VMServiceTable {
 private:
@@ -193,33 +234,38 @@ SchedulerService::SchedulerService() : VMService("Runtime:ThreadScheduler") {}
 void SchedulerService::run() {} // This is a dummy definition, as it will never be used.
 
 void Scheduler::start() {
+    {
+        os::CriticalSection _(thread_m);
+        // The threads are warmed up ahead, thus the first services are hosted without spawning the OS threads.
+        while (this->thread_count < this->pool_min_size) (void) start_thread();
+    }
+    // The first shard is processed by the calling thread, while the other workers are hosted by their own threads.
+    for (uint32 index = 1; index < this->worker_count; index++)
+        this->shards[index].worker_thread.start(this->shards[index]);
+    process(this->shards[0]);
+    // All the workers must have left their task loops before the threads are finalized.
+    for (uint32 index = 1; index < this->worker_count; index++) this->shards[index].worker_thread.join();
+    finalization_on_termination();
+}
+
+void Scheduler::process(Shard &shard) {
     SchedulerService scheduler_service;
     global_thread_id_to_service_table.put(os::Thread::current_thread_id(), scheduler_service);
 
     ScheduledTask *selected;
     Fetch:
-    {
-        os::CriticalSection _(scheduler_action_m);
-
-        if (termination_requested.load()) goto Terminate;
-
-        else if (current_task == nullptr)
-            // If there are no task left to do, the scheduler thread will be paused to avoid occupying the CPU.
-            // NOTE: current_task == nullptr is count as explicit information to signify the scheduler is now free,
-            // since the scheduler loop is protected by the mutex scheduler_action_m, no new task will be added until
-            // this cycle ends, thus we can safely head to the pause state.
-            goto Pause;
-
-        else if (current_task->get_next() == current_task) {
-            // If there are only one task left, fetch it and set current_task to nullptr.
-            selected = current_task;
-            // Setting this to nullptr signals the scheduler to pause on the next round.
-            current_task = nullptr;
-        } else {
-            // Fetch the current task and set the next task as the current task.
-            selected = current_task;
-            current_task = current_task->get_next();
-        }
+    if (termination_requested.load()) goto Terminate;
+
+    selected = shard.take();
+    if (selected == nullptr) {
+        // If there are no task left to do, the worker thread will be parked to avoid occupying the CPU.
+        // NOTE: The wait is prepared before the queues and the termination are checked again, while a producer pushes
+        // the task before notifying the event count in Scheduler::notify(); thus either the worker observes the task
+        // or the notification wakes the worker.
+        uint32 key = shard.process_cycle_event.prepare_wait();
+        if (!termination_requested.load() && shard.is_queue_empty()) shard.process_cycle_event.wait(key);
+        else shard.process_cycle_event.cancel_wait();
+        goto Fetch;
     }
 
     // Check if the task is active, if not we will skip this task and move on to the next fetching operation.
@@ -228,33 +274,21 @@ void Scheduler::start() {
     // start: process the selected task.
     selected->vm::HasRoot<Scheduler>::bind(*this);
     selected->run();
-    selected->disconnect(); // Disconnect the task from the circle task list as it is completed.
-    selected->signal_completed = true; // Set the task as completed.
-    // After the completion of the task, we have to wake up the thread that owns the task if the request thread is
-    // blocked on the request_thread_cv.
-    while (selected->request_thread_waiting) {
-        selected->request_thread_cv.notify();
-        os::Thread::static_sleep(0);
-    }
+    // The task might be reused, for example the ThreadReturnTask of a thread returned more than once.
+    selected->vm::HasRoot<Scheduler>::unbind();
+    // Set the task as completed, the task must not be accessed afterwards.
+    selected->on_completed(*this);
+    // After the completion of the task, we have to wake up the thread waiting for the task completion if any.
+    task_completion_event.notify_all();
     // end: process the selected task.
 
     goto Fetch;
 
-    // start: idle state.
-    Pause:
-    process_cycle_paused = true;
-    process_cycle_pause_cv.wait();
-    process_cycle_paused = false;
-    // end: idle state.
-
-    goto Fetch;
-
-    // NOTE: The action of Scheduler::terminate() will not use the scheduler process loop, it should independently
-    // interrupt all existing threads and wait for all to terminate. A sweet spot is here due to the inactivity of the
-    // scheduler loop, there will be no new threads spawning, pausing or terminating at this point, thus this can be
-    // handled effortlessly (should be).
+    // NOTE: The action of Scheduler::terminate() will not use the task loop, it should independently interrupt all
+    // existing threads and wait for all to terminate. A sweet spot is after all workers returned from here due to the
+    // inactivity of the task loops, there will be no new threads spawning, pausing or terminating at that point, thus
+    // this can be handled effortlessly (should be).
     Terminate:
-    finalization_on_termination();
     global_thread_id_to_service_table.remove(os::Thread::current_thread_id());
 }
 
@@ -266,15 +300,16 @@ void Scheduler::terminate() {
 bool Scheduler::is_terminated() { return termination_requested.load(); }
 
 void Scheduler::finalization_on_termination() {
-    memory::TArenaIterator<VMThread> iterator_for_interrupt(*this);
-    VMThread *current = iterator_for_interrupt.next();
+    memory::TArenaIterator<VMThread> iterator_for_retire(*this);
+    VMThread *current = iterator_for_retire.next();
     while (current != nullptr) {
-        current->interrupt();
-        current = iterator_for_interrupt.next();
+        current->retire();
+        current = iterator_for_retire.next();
     }
     memory::TArenaIterator<VMThread> iterator_for_join(*this);
     current = iterator_for_join.next();
     while (current != nullptr) {
+        // Every thread is started upon its allocation, the idle threads leave their loops right after the retirement.
         current->embedded_os_thread.join();
         current = iterator_for_join.next();
     }
@@ -282,62 +317,73 @@ void Scheduler::finalization_on_termination() {
 }
 
 void Scheduler::add_task(ScheduledTask &task) {
-    // Scheduler state specific task is protected by the mutex scheduler_action_m.
-    // The following process is to:
-    // 1. Connect the new task to the left side of the current task or the 'end' of the circle list according to the
-    //    direction of process flow (from left to right); if there are no task in the circle list place the new task
-    //    in the position of the current task.
-    // 2. If the scheduler is in pause state, attempt to resume it to start processing new tasks.
-    os::CriticalSection _(scheduler_action_m);
-
-    // Connect the new task to the circle task list.
-    if (this->current_task == nullptr) current_task = &task;
-    else current_task->connect_last(task);
+    // The task is pushed without any lock, the worker of the shard is woken by the subsequent Scheduler::notify().
+    (void) shard_of(task).tasks.push(task);
 }
 
 void Scheduler::add_realtime_task(ScheduledTask &task) {
-    // Scheduler state specific task is protected by the mutex scheduler_action_m.
-    // The following process is to:
-    // 1. Connect the new task to the right side of the current task or the 'next' of the circle list according to the
-    //    direction of process flow (from left to right); if there are no task in the circle list place the new task
-    //    in the position of the current task.
-    // 2. If the scheduler is in pause state, attempt to resume it to start processing new tasks.
-    os::CriticalSection _(scheduler_action_m);
-
-    // Connect the new task to the circle task list.
-    if (this->current_task == nullptr) current_task = &task;
-    else
-        // Put the task to the next processing slot as it is important, if there are other high priority tasks placed
-        // before this, they will be displaced backwards.
-        current_task->connect_next(task);
+    // The realtime queue is checked by the worker before every task, thus the task is processed right after the task
+    // in progress; if there are other high priority tasks queued before this, they are processed first.
+    (void) shard_of(task).realtime_tasks.push(task);
 }
 
 void Scheduler::notify() {
-    // Just in case if the scheduler is slept, attempt to wake it up.
-    while (process_cycle_paused) {
-        process_cycle_pause_cv.notify();
-        // Abandon the time slice of the underlying thread to other OS threads, especially the thread running the
-        // scheduler, to run.
-        os::Thread::static_sleep(0);
+    bool terminating = termination_requested.load();
+    for (uint32 index = 0; index < this->worker_count; index++) {
+        Shard &shard = this->shards[index];
+        // A worker without any task would park again right after the wake, which is only required for termination. A
+        // single notification is enough to wake the worker if it is parked, and it costs nothing otherwise.
+        if (terminating || !shard.is_queue_empty()) shard.process_cycle_event.notify_all();
     }
 }
 
-VMThread &Scheduler::idle_thread() {
+VMThread &Scheduler::start_thread() {
+    VMThread *thread = this->memory::TArena<VMThread>::allocate();
+    new(thread) VMThread();
+    thread->embedded_os_thread.start(*thread);
+    this->thread_count++;
+    return *thread;
+}
+
+VMThread *Scheduler::idle_thread() {
+    // The thread is claimed by clearing the idle flag while the mutex is held, thus the thread retrieved will only be
+    // available for hosting one service, even if multiple workers are starting services concurrently.
     memory::TArenaIterator<VMThread> iterator(*this);
     VMThread *current = iterator.next();
     while (current != nullptr) {
-        if (current->is_idle()) return *current;
+        if (current->idle) {
+            current->idle = false;
+            return current;
+        }
         current = iterator.next();
     }
 
-    current = this->memory::TArena<VMThread>::allocate();
-    new(current) VMThread();
+    if (this->thread_count == this->pool_max_size) return nullptr;
+    current = &start_thread();
+    current->idle = false;
+
+    return current;
+}
 
-    return *current;
+void Scheduler::host_service(VMService &service) {
+    VMThread *thread;
+    {
+        os::CriticalSection _(thread_m);
+        thread = idle_thread();
+        if (thread == nullptr) {
+            // The service is hosted by the next thread returned, see ThreadReturnTask::on_completed().
+            service.next_deferred = nullptr;
+            if (this->last_deferred_service != nullptr) this->last_deferred_service->next_deferred = &service;
+            else this->first_deferred_service = &service;
+            this->last_deferred_service = &service;
+            return;
+        }
+    }
+    thread->host(service);
 }
 
 VMThread::VMThread() : idle(true), current_service_identifier(NULL_SERVICE_IDENTIFIER), signaled_interrupt(false),
-                       thread_join_negotiated(false), self_return_task(*this) {}
+                       hosted_service(nullptr), retire_requested(false), self_return_task(*this) {}
 
 // This might be weird, but it is required as destructing the thread means that we need to call the destructor for all
 // underlying structures or objects, which one of them is the ThreadReturnTask self_return_task, destructing a task
@@ -345,16 +391,33 @@ VMThread::VMThread() : idle(true), current_service_identifier(NULL_SERVICE_IDENT
 // to inactivate the task explicitly.
 VMThread::~VMThread() { self_return_task.inactivate(); }
 
-bool VMThread::is_idle() const { return idle; }
+void VMThread::execute() {
+    while (true) {
+        VMService *service = hosted_service.exchange(nullptr);
+        if (service != nullptr) {
+            service->execute();
+            continue;
+        }
+        if (retire_requested.load()) return;
+        // NOTE: The wait is prepared before the hand-off and the retirement are checked again, while the scheduler sets
+        // them before notifying the host_event; thus either the thread observes them or the notification wakes it.
+        uint32 key = host_event.prepare_wait();
+        if (hosted_service.load() != nullptr || retire_requested.load()) host_event.cancel_wait();
+        else host_event.wait(key);
+    }
+}
+
+void VMThread::retire() {
+    retire_requested.store(true);
+    interrupt();
+    host_event.notify_all();
+}
 
 void VMThread::host(VMService &service) {
-    // Since this operation is protected by the single threaded nature of the scheduler task loop, the idle thread
-    // retrieved will only be available for hosting the target_service, thus setting the idle flag here will not cause
-    // another hosting request to mistake this thread as an idle thread.
-    idle = false;
+    // The idle flag is already cleared by Scheduler::idle_thread(), thus another hosting request will not mistake this
+    // thread as an idle thread.
     // Reset the all thread states for a fresh start.
     signaled_interrupt.store(false);
-    thread_join_negotiated = false;
 
     // The scheduler requires to access each running services via this link between the VMService and the VMThread,
     // which VMThread is a member of Scheduler. This have to be un-bind before the service completed its lifecycle.
@@ -363,7 +426,9 @@ void VMThread::host(VMService &service) {
     // before the service completed its lifecycle.
     service.vm::HasRoot<VMThread>::bind(*this);
     this->current_service_identifier = service.get_identifier(); // Set the current service identifier of this thread.
-    this->embedded_os_thread.start(service); // Start the service with the embedded os thread.
+    // Hand the service to the OS thread parked in the idle state, which is started upon the allocation of the thread.
+    hosted_service.store(&service);
+    host_event.notify_all();
 }
 
 bool VMThread::sleep(uint32 milliseconds) {
@@ -405,6 +470,8 @@ void VMThread::wake() {
     // actions which uses these states.
     wake_handshake.tik();
     self_blocking_cv.notify();
+    // The service might be blocked on its own primitives instead of the self_blocking_cv.
+    if (this->vm::HasMember<VMService>::is_bound()) this->vm::HasMember<VMService>::member()->on_wake();
 }
 
 void VMThread::interrupt() {
@@ -484,36 +551,66 @@ void VMService::execute() {
     // The current service's lifecycle ends gracefully here.
 }
 
-VMService::VMService(const std::string &name) : vm::HasName("Service:" + name) {
+VMService::VMService(const std::string &name) : vm::HasName("Service:" + name), next_deferred(nullptr) {
     // Retrieve the identifier which is unique within the entire process.
     identifier = global_vm_service_identifier_distribution.fetch_add(1);
 }
 
 uint64 VMService::get_identifier() const { return this->identifier; }
 
+void VMService::on_wake() {}
+
+void VMService::pause_if_requested() { this->vm::HasRoot<VMThread>::root()->pause_if_requested(); }
+
+bool VMService::is_interrupted() { return this->vm::HasRoot<VMThread>::root()->check_if_interrupted(); }
+
 VMService::~VMService() = default;
 
 Scheduler::StartServiceTask::StartServiceTask(VMService &target_service) : target_service(&target_service) {}
 
+// The thread hosting the service is unknown until the task is processed, thus the task is keyed by the service.
+uint64 Scheduler::StartServiceTask::get_shard_key() const { return target_service->get_identifier(); }
+
 void Scheduler::StartServiceTask::run() {
     Scheduler *scheduler = this->vm::HasRoot<Scheduler>::root();
     target_service->vm::HasRoot<Scheduler>::bind(*scheduler);
-    scheduler->idle_thread().host(*target_service);
+    scheduler->host_service(*target_service);
 }
 
 Scheduler::ThreadReturnTask::ThreadReturnTask(VMThread &target_thread) : target_thread(&target_thread) {}
 
+uint64 Scheduler::ThreadReturnTask::get_shard_key() const { return reinterpret_cast<uint64>(target_thread); }
+
 void Scheduler::ThreadReturnTask::run() {
     // Unbind the VMThread root from the member VMService.
     target_thread->vm::HasMember<VMService>::member()->vm::HasRoot<VMThread>::unbind();
     target_thread->vm::HasMember<VMService>::unbind();
+    // The OS thread is not joined, as it returns to its loop to pick up the next service.
+}
 
-    target_thread->embedded_os_thread.join();
-    target_thread->idle = true;
+void Scheduler::ThreadReturnTask::on_completed(Scheduler &scheduler) {
+    // The task is no longer accessed once its completion is signaled, as the waiter might reuse or destruct it.
+    VMThread *thread = target_thread;
+    ScheduledTask::on_completed(scheduler);
+    VMService *deferred;
+    {
+        os::CriticalSection _(scheduler.thread_m);
+        deferred = scheduler.first_deferred_service;
+        if (deferred == nullptr) {
+            thread->idle = true;
+            return;
+        }
+        scheduler.first_deferred_service = deferred->next_deferred;
+        if (scheduler.first_deferred_service == nullptr) scheduler.last_deferred_service = nullptr;
+    }
+    // The thread is handed to the deferred service directly without entering the idle state.
+    thread->host(*deferred);
 }
 
 Scheduler::ThreadPauseTask::ThreadPauseTask(VMThread &target_thread) : target_thread(&target_thread) {}
 
+uint64 Scheduler::ThreadPauseTask::get_shard_key() const { return reinterpret_cast<uint64>(target_thread); }
+
 void Scheduler::ThreadPauseTask::run() {
     if (!target_thread->request_pause(config::pause_request_wait_milliseconds)) {
         std::string service_name = target_thread->vm::HasMember<VMService>::member()->get_name();
@@ -523,6 +620,8 @@ void Scheduler::ThreadPauseTask::run() {
 
 Scheduler::ThreadResumeTask::ThreadResumeTask(VMThread &target_thread) : target_thread(&target_thread) {}
 
+uint64 Scheduler::ThreadResumeTask::get_shard_key() const { return reinterpret_cast<uint64>(target_thread); }
+
 void Scheduler::ThreadResumeTask::run() { target_thread->resume(); }
 
 VMService &veil::threading::current_service() {
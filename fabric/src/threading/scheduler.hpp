@@ -17,6 +17,7 @@
 #define VEIL_FABRIC_SRC_THREADING_SCHEDULER_HPP
 
 #include "src/memory/global.hpp"
+#include "src/threading/config.hpp"
 #include "src/threading/os.hpp"
 #include "src/threading/handshake.hpp"
 #include "src/vm/structures.hpp"
@@ -26,7 +27,13 @@ namespace veil::threading {
     /// manages their own life cycle after spawning (pause/resume/termination), it will all be handled by the scheduler
     /// in a single-threaded task loop. Each task (sub classes of <code>ScheduledTask</code>) will encapsulate the
     /// requests to control or signal the thread's lifecycle, thus maximal thread-safety during these events are tightly
-    /// guaranteed.
+    /// guaranteed.<br><br>
+    /// The task loop can be sharded across multiple scheduler workers, each processing its own shard of the tasks in
+    /// a single-threaded loop; the tasks are sharded by their target <code>VMThread</code>, thus all the tasks of a
+    /// thread are processed by the same worker in order and the lifecycle guarantee holds per thread.<br><br>
+    /// The OS threads are pooled: each <code>VMThread</code> starts its OS thread once, which is parked in the idle
+    /// state after its service returns and picks up the next service hosted on it directly; thus starting a service
+    /// costs a wakeup instead of the spawn of an OS thread.
     class Scheduler;
 
     /// A subclass of this class encapsulate a request to control or signal a thread's lifecycle, each task will be
@@ -55,9 +62,22 @@ namespace veil::threading {
     private:
         class ThreadPauseTask;
         class ThreadResumeTask;
+        /// A shard of the task loop processed by a single scheduler worker.
+        class Shard;
 
     public:
-        Scheduler();
+        /// \param worker_count The number of the scheduler workers, each processes a shard of the task loop; the first
+        ///                     worker is hosted by the thread calling <code>Scheduler::start()</code>, while the others
+        ///                     are hosted by their own threads. The value <code>0</code> is treated as <code>1</code>.
+        /// \param pool_min_size The number of the threads started by <code>Scheduler::start()</code> ahead of any
+        ///                      service, which are parked in the idle state.
+        /// \param pool_max_size The maximum number of the threads, the services started while all the threads are
+        ///                      busy are deferred until a thread returns; which is raised to <code>pool_min_size
+        ///                      </code> and <code>1</code> if smaller.
+        explicit Scheduler(uint32 worker_count = 1, uint32 pool_min_size = config::thread_pool_min_size,
+                           uint32 pool_max_size = config::thread_pool_max_size);
+
+        ~Scheduler();
 
         /// \brief Start the task loop of the scheduler.
         /// This method will kick start the task loop of the scheduler, which handles the spawning of a new thread, the
@@ -65,41 +85,68 @@ namespace veil::threading {
         /// in a single threaded loop, synchronization of thread events are guaranteed.
         /// \attention This method will not return until the scheduler is terminated, thus we should choose carefully
         /// which thread will host the scheduler itself. To kept the scheduler manageable, it is best to be hosted on
-        /// the main thread, which is not part of the scheduler managed threads.
+        /// the main thread, which is not part of the scheduler managed threads. The additional workers are started by
+        /// this method, and joined before it returns.
         void start();
 
         void terminate();
 
         bool is_terminated();
 
+        /// Queue the <code>task</code> to its shard without blocking, the tasks of a shard are processed in the order
+        /// they are queued.
         void add_task(ScheduledTask &task);
 
+        /// Queue the <code>task</code> to its shard without blocking, ahead of the tasks queued by <code>
+        /// Scheduler::add_task()</code>.
         void add_realtime_task(ScheduledTask &task);
 
+        /// Wake the workers having tasks to process, or all the workers if the termination is requested.
         void notify();
 
+        [[nodiscard]] uint32 get_worker_count() const;
+
+        /// \return The number of the threads started, either hosting a service or parked in the idle state.
+        [[nodiscard]] uint32 get_thread_count();
+
     private:
         /// This flag determines whether the scheduler <b>will be</b> terminated, if this is set to <code>true</code>
         /// then the scheduler will be terminated at the next process cycle and <code>Scheduler::start()</code> will
         /// return.
         os::atomic_bool_t termination_requested;
-        /// This is used by the scheduler to pause itself when there are no task left to do, and should only be notified
-        /// by the method <code>Scheduler::add_task()</code> only.
-        os::ConditionVariable process_cycle_pause_cv;
-        /// This flag determines whether the scheduler <b>is</b> paused, and should not be modified by all but the
-        /// method <code>Scheduler::start()</code> to ensure the explicitness of state.
-        volatile bool process_cycle_paused;
-        /// This is used to ensure only one thread will fiddle with the state of the scheduler, all action within the
-        /// scheduler which will mutate the state must lock this mutex.
-        os::Mutex scheduler_action_m;
-        /// This is the anchor element of the circle task list of the scheduler, the list have the structure of:<br>
-        /// <pre>...-[added_task]-[current_task]-[next_task]-...-[added_task]-...</pre><br>
-        /// Which all added task will be connected on the left side of the current task, and the circle will rotate
-        /// when the scheduler processes the tasks. <br>
-        /// This pointer will be <code>nullptr</code> if there are no task left to do.
-        ScheduledTask *current_task;
-
-        VMThread &idle_thread();
+        const uint32 worker_count;
+        /// The shards of the task loop, one for each worker.
+        Shard *shards;
+        const uint32 pool_min_size;
+        const uint32 pool_max_size;
+        /// The threads are hosted and returned by all the workers, thus the allocation of the threads, the transitions
+        /// of their idle state and the deferred services are guarded by this mutex.
+        os::Mutex thread_m;
+        uint32 thread_count;
+        /// The services waiting for a thread in the order they are started, linked by <code>
+        /// VMService::next_deferred</code>.
+        VMService *first_deferred_service;
+        VMService *last_deferred_service;
+
+        /// Allocate a new thread and start its OS thread, which is parked in the idle state until a service is hosted.
+        /// \attention Must be invoked with the <code>thread_m</code> held.
+        VMThread &start_thread();
+
+        /// Claim an idle thread to host a service, a new thread is started if no thread is idle and the pool is not
+        /// full.
+        /// \attention Must be invoked with the <code>thread_m</code> held.
+        /// \return The thread claimed, or <code>nullptr</code> if all the threads of the full pool are busy.
+        VMThread *idle_thread();
+
+        /// Host the <code>service</code> on an idle thread, or defer it until a thread returns.
+        void host_service(VMService &service);
+
+        /// \return The shard processing the <code>task</code>, determined by <code>ScheduledTask::get_shard_key()
+        /// </code>.
+        Shard &shard_of(ScheduledTask &task);
+
+        /// The task loop of a worker processing the <code>shard</code>, which returns upon the termination.
+        void process(Shard &shard);
 
         /// Internal method to be called within <code>start()</code> only if the flag <code>termination_requested</code>
         /// is set <code>true</code>.
@@ -117,12 +164,12 @@ namespace veil::threading {
         virtual ~ScheduledTask();
 
         /// \brief Wait until the task is being processed by the scheduler.
-        /// By calling this method the calling thread will be blocked on the <code>request_thread_cv</code> until the
-        /// scheduler notifies it after the task is completed.
+        /// By calling this method the calling thread will be parked without occupying the CPU until the scheduler
+        /// notifies it after the task is completed.
         /// \attention If this method is called before <code>Scheduler::add_task(ScheduledTask)</code>, the calling
         /// thread will enters an unrecoverable sleep. Please don't call this method if the calling thread is the thread
         /// that runs the scheduler task loop, it would result in another unrecoverable sleep since there is no other
-        /// thread that can notify <code>request_thread_cv</code> than the scheduler itself.
+        /// thread that can complete the task than the scheduler itself.
         void wait_for_completion();
 
         void reset_state_for_reuse();
@@ -131,29 +178,24 @@ namespace veil::threading {
 
         virtual void run() = 0;
 
+        /// \return The key which the task is sharded by, the tasks of the same key are processed by the same scheduler
+        /// worker in order; the tasks targeting a <code>VMThread</code> are keyed by the thread. By default the task
+        /// is keyed by its own address.
+        [[nodiscard]] virtual uint64 get_shard_key() const;
+
+    protected:
+        /// Invoked by the scheduler worker after the task is completed, which signals the completion to <code>
+        /// ScheduledTask::wait_for_completion()</code>; the worker no longer accesses the task afterwards, thus the
+        /// task can be reused or destructed from the signal on.
+        virtual void on_completed(Scheduler &scheduler);
+
     private:
-        ScheduledTask *prev;
+        /// The next task within the queue of a shard, or within the batch taken by the worker from the queue.
         ScheduledTask *next;
-        os::ConditionVariable request_thread_cv;
         os::atomic_bool_t task_active;
-        bool volatile request_thread_waiting;
-        bool volatile signal_completed;
-
-        void connect_last(ScheduledTask &task);
-
-        void connect_next(ScheduledTask &task);
+        os::atomic_bool_t signal_completed;
 
-        void disconnect();
-
-        ScheduledTask *get_next();
-
-        ScheduledTask *get_prev();
-
-        friend void Scheduler::start();
-
-        friend void Scheduler::add_task(ScheduledTask &task);
-
-        friend void Scheduler::add_realtime_task(ScheduledTask &task);
+        friend class Scheduler;
     };
 
     class Scheduler::StartServiceTask : public memory::ValueObject, public ScheduledTask {
@@ -162,6 +204,8 @@ namespace veil::threading {
 
         void run() override;
 
+        [[nodiscard]] uint64 get_shard_key() const override;
+
     private:
         VMService *target_service;
     };
@@ -172,6 +216,12 @@ namespace veil::threading {
 
         void run() override;
 
+        [[nodiscard]] uint64 get_shard_key() const override;
+
+    protected:
+        /// Return the thread to the idle state, as the task belongs to the thread and is reused by its next service.
+        void on_completed(Scheduler &scheduler) override;
+
     private:
         VMThread *target_thread;
     };
@@ -182,6 +232,8 @@ namespace veil::threading {
 
         void run() override;
 
+        [[nodiscard]] uint64 get_shard_key() const override;
+
     private:
         VMThread *target_thread;
     };
@@ -192,6 +244,8 @@ namespace veil::threading {
 
         void run() override;
 
+        [[nodiscard]] uint64 get_shard_key() const override;
+
     private:
         VMThread *target_thread;
     };
@@ -215,19 +269,41 @@ namespace veil::threading {
 
         virtual void run() = 0;
 
+        /// Invoked when the hosting thread is woken by the scheduler, for example upon a pause request or an interrupt.
+        /// A service blocking on its own primitives instead of <code>VMThread::sleep()</code> should unblock itself
+        /// here to respond to the scheduler; it is invoked by the scheduler thus must not block.
+        virtual void on_wake();
+
+    protected:
+        /// The safe-point of the service, the calling thread is paused here if a pause is requested by the scheduler,
+        /// until it is resumed.
+        void pause_if_requested();
+
+        /// \return Whether the service is interrupted, for example upon the termination of the scheduler.
+        [[nodiscard]] bool is_interrupted();
+
     private:
         uint64 identifier;
+        /// The next service waiting for a thread in the <code>Scheduler</code>.
+        VMService *next_deferred;
 
-        friend void Scheduler::start();
+        friend class Scheduler;
         friend void Scheduler::StartServiceTask::run();
     };
 
-    class VMThread : public memory::ArenaObject, public vm::HasRoot<Scheduler>, public vm::HasMember<VMService> {
+    /// Each thread is aligned to a cache line, as the handshakes of a thread are polled by both the thread itself and
+    /// the scheduler, which should not contend with the neighbouring threads in the <code>TArena</code>.
+    class alignas(memory::CACHE_LINE_SIZE) VMThread : public memory::ArenaObject, public vm::Executable,
+                                                      public vm::HasRoot<Scheduler>, public vm::HasMember<VMService> {
     public:
         VMThread();
 
         ~VMThread();
 
+        /// The loop of the OS thread, which executes the services hosted one by one and parks in between, until the
+        /// thread is retired.
+        void execute() override;
+
     protected:
         bool sleep(uint32 milliseconds);
 
@@ -243,12 +319,17 @@ namespace veil::threading {
         HandShake wake_handshake;
         os::atomic_bool_t signaled_interrupt;
 
-        bool volatile thread_join_negotiated;
-        os::ConditionVariable thread_join_blocking_cv;
+        /// The service handed to the OS thread by <code>VMThread::host()</code> yet to be picked up.
+        os::atomic_pointer_t<VMService> hosted_service;
+        /// Whether the OS thread should leave its loop once the current service returns.
+        os::atomic_bool_t retire_requested;
+        /// The parked OS thread is notified on the hosting of a service and the retirement.
+        os::EventCount host_event;
 
         void host(VMService &service);
 
-        [[nodiscard]] bool is_idle() const;
+        /// Interrupt the current service and request the OS thread to leave its loop, upon the termination.
+        void retire();
 
         void wake();
 
@@ -264,7 +345,7 @@ namespace veil::threading {
 
         Scheduler::ThreadReturnTask self_return_task;
 
-        friend void VMService::execute();
+        friend class VMService;
         friend class Scheduler;
     };
 
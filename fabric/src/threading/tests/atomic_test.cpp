@@ -32,4 +32,22 @@ int main() {
     std::cout << "Expected: 0x" << std::hex << reinterpret_cast<uint64>(nullptr) << std::endl << std::endl;
 
     delete obj;
+
+    std::cout << std::dec << "Begin test on fetch operations, expects: add = 7, sub = 4, or = 6, xor = 2" << std::endl;
+    atomic_u32_t a_u32(5);
+    uint32 added = a_u32.fetch_add(2);
+    uint32 subtracted = a_u32.fetch_sub(3);
+    uint32 ored = a_u32.fetch_or(2);
+    uint32 xored = a_u32.fetch_xor(4);
+    std::cout << "Test result: add = " << added << ", sub = " << subtracted << ", or = " << ored << ", xor = " << xored
+              << std::endl;
+
+    std::cout << "Begin test on 64-bit fetch operations, expects: add = 7, sub = 4, or = 6, xor = 2" << std::endl;
+    atomic_u64_t a_u64(5);
+    uint64 added_u64 = a_u64.fetch_add(2);
+    uint64 subtracted_u64 = a_u64.fetch_sub(3);
+    uint64 ored_u64 = a_u64.fetch_or(2);
+    uint64 xored_u64 = a_u64.fetch_xor(4);
+    std::cout << "Test result: add = " << added_u64 << ", sub = " << subtracted_u64 << ", or = " << ored_u64
+              << ", xor = " << xored_u64 << std::endl;
 }
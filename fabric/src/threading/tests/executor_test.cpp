@@ -0,0 +1,98 @@
+#include <iostream>
+
+#include "src/threading/executor.hpp"
+#include "src/threading/scheduler.hpp"
+
+using namespace veil::threading;
+
+const uint32 ELEMENT_COUNT = 1 << 22;
+const uint32 GRAIN = 1 << 12;
+const uint32 SUBMIT_COUNT = 10000;
+
+/// Sum the elements within [begin, end) by dividing the range recursively.
+class SumJob : public veil::vm::Executable {
+public:
+    SumJob(Executor &executor, const uint32 *elements, uint32 begin, uint32 end) :
+            executor(executor), elements(elements), begin(begin), end(end), sum(0) {}
+
+    void execute() override {
+        if (end - begin <= GRAIN) {
+            for (uint32 index = begin; index < end; index++) sum += elements[index];
+            return;
+        }
+        uint32 middle = begin + (end - begin) / 2;
+        SumJob left(executor, elements, begin, middle);
+        SumJob right(executor, elements, middle, end);
+        Executor::Job left_job(left);
+        Executor::Group group(executor);
+        group.fork(left_job);
+        right.execute();
+        group.join();
+        sum = left.sum + right.sum;
+    }
+
+    Executor &executor;
+    const uint32 *elements;
+    uint32 begin;
+    uint32 end;
+    uint64 sum;
+};
+
+class CountJob : public veil::vm::Executable {
+public:
+    veil::os::atomic_u32_t *completed = nullptr;
+
+    void execute() override { (void) completed->fetch_add(1); }
+};
+
+/// Drive the executor from a service, then terminate the scheduler along with the workers.
+class DriverService : public VMService {
+public:
+    explicit DriverService(Executor &executor) : VMService("executor-driver"), executor(executor) {}
+
+    void run() override {
+        auto elements = new uint32[ELEMENT_COUNT];
+        uint64 expected = 0;
+        for (uint32 index = 0; index < ELEMENT_COUNT; index++) {
+            elements[index] = index % 1000;
+            expected += elements[index];
+        }
+        std::cout << "Begin test on fork-join sum, expects: sum = " << expected << std::endl;
+        SumJob root(executor, elements, 0, ELEMENT_COUNT);
+        root.execute();
+        std::cout << "Test result: sum = " << root.sum << std::endl;
+        delete[] elements;
+
+        std::cout << "Begin test on submitted jobs, expects: completed = " << SUBMIT_COUNT << std::endl;
+        veil::os::atomic_u32_t completed(0);
+        auto jobs = new CountJob[SUBMIT_COUNT];
+        for (uint32 index = 0; index < SUBMIT_COUNT; index++) {
+            jobs[index].completed = &completed;
+            executor.submit(jobs[index]);
+        }
+        while (completed.load() != SUBMIT_COUNT) veil::os::Thread::static_sleep(1);
+        std::cout << "Test result: completed = " << completed.load() << std::endl;
+        delete[] jobs;
+
+        // The parked workers are interrupted upon the termination.
+        this->veil::vm::HasRoot<Scheduler>::root()->terminate();
+    }
+
+private:
+    Executor &executor;
+};
+
+int main() {
+    Scheduler scheduler(2);
+    Executor executor(4);
+    executor.start(scheduler);
+
+    DriverService driver(executor);
+    Scheduler::StartServiceTask driver_task(driver);
+    scheduler.add_task(driver_task);
+
+    scheduler.start();
+    std::cout << "Scheduler terminated with workers = " << executor.get_worker_count() << std::endl;
+
+    return 0;
+}
@@ -53,6 +53,26 @@ private:
     veil::os::ConditionVariable *cv;
 };
 
+class EventWaitFunction : public veil::vm::Executable {
+public:
+    EventWaitFunction(veil::os::EventCount *event, veil::os::atomic_bool_t *ready, veil::os::atomic_u32_t *awaken):
+            event(event), ready(ready), awaken(awaken) {}
+
+    void execute() override {
+        while (!ready->load()) {
+            uint32 key = event->prepare_wait();
+            if (ready->load()) event->cancel_wait();
+            else event->wait(key);
+        }
+        (void) awaken->fetch_add(1);
+    }
+
+private:
+    veil::os::EventCount *event;
+    veil::os::atomic_bool_t *ready;
+    veil::os::atomic_u32_t *awaken;
+};
+
 int main() {
     veil::os::Thread thread_0;
     veil::os::Thread thread_1;
@@ -94,6 +114,50 @@ int main() {
         thread_2.join();
         notify_thread.join();
     }
+    std::cout << "Begin test on event count, expects: awaken = 3" << std::endl;
+    {
+        veil::os::EventCount event;
+        veil::os::atomic_bool_t ready(false);
+        veil::os::atomic_u32_t awaken(0);
+
+        EventWaitFunction wait_function_0(&event, &ready, &awaken);
+        EventWaitFunction wait_function_1(&event, &ready, &awaken);
+        EventWaitFunction wait_function_2(&event, &ready, &awaken);
+
+        thread_0.start(wait_function_0);
+        thread_1.start(wait_function_1);
+        thread_2.start(wait_function_2);
+        veil::os::Thread::static_sleep(500);
+        // A single notification wakes all the waiters.
+        ready.store(true);
+        event.notify_all();
+        thread_0.join();
+        thread_1.join();
+        thread_2.join();
+        std::cout << "Test result: awaken = " << awaken.load() << std::endl;
+    }
+    std::cout << "Begin test on event count single notification, expects: awaken = 1, awaken = 2" << std::endl;
+    {
+        veil::os::EventCount event;
+        veil::os::atomic_bool_t ready(false);
+        veil::os::atomic_u32_t awaken(0);
+
+        EventWaitFunction wait_function_0(&event, &ready, &awaken);
+        EventWaitFunction wait_function_1(&event, &ready, &awaken);
+
+        thread_0.start(wait_function_0);
+        thread_1.start(wait_function_1);
+        veil::os::Thread::static_sleep(500);
+        // Both waiters are blocked, thus a single notification wakes only one of them.
+        ready.store(true);
+        event.notify_one();
+        veil::os::Thread::static_sleep(500);
+        std::cout << "Test result: awaken = " << awaken.load();
+        event.notify_all();
+        thread_0.join();
+        thread_1.join();
+        std::cout << ", awaken = " << awaken.load() << std::endl;
+    }
 
     return 0;
 }
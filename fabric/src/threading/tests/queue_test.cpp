@@ -2,7 +2,9 @@
 #include <thread>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "src/threading/mpsc-queue.hpp"
 #include "src/threading/ordered-queue.hpp"
 
 using namespace veil::threading;
@@ -90,6 +92,18 @@ void nested_reentrance_with_count_sleep_1s(Params *params) {
     }
 }
 
+struct Node {
+    uint32 producer = 0;
+    uint32 sequence = 0;
+    Node *next = nullptr;
+};
+
+typedef MPSCQueue<Node, &Node::next> NodeQueue;
+
+void produce(NodeQueue *queue, std::vector<Node> *nodes) {
+    for (Node &node: *nodes) queue->push(node);
+}
+
 int main() {
     OrderedQueueClient client_0;
     OrderedQueueClient client_1;
@@ -175,5 +189,31 @@ int main() {
     }
     std::cout << "Test result: count = " << count << std::endl;
 
+    const uint32 PRODUCER_COUNT = 4;
+    const uint32 NODE_COUNT = 100000;
+    std::cout << "Begin test on multiple producer single consumer queue, expects: count = "
+              << PRODUCER_COUNT * NODE_COUNT << ", disordered = 0" << std::endl;
+    {
+        NodeQueue queue;
+        std::vector<std::vector<Node>> nodes(PRODUCER_COUNT, std::vector<Node>(NODE_COUNT));
+        std::vector<std::thread> producers;
+        for (uint32 producer = 0; producer < PRODUCER_COUNT; producer++) {
+            for (uint32 sequence = 0; sequence < NODE_COUNT; sequence++)
+                nodes[producer][sequence] = {producer, sequence, nullptr};
+            producers.emplace_back(produce, &queue, &nodes[producer]);
+        }
+        // The nodes of each producer must be drained in the order they are pushed, across the batches.
+        std::vector<uint32> expected(PRODUCER_COUNT, 0);
+        uint32 drained = 0, disordered = 0;
+        while (drained < PRODUCER_COUNT * NODE_COUNT) {
+            for (Node *node = queue.drain(); node != nullptr; node = node->next) {
+                if (node->sequence != expected[node->producer]++) disordered++;
+                drained++;
+            }
+        }
+        for (std::thread &producer: producers) producer.join();
+        std::cout << "Test result: count = " << drained << ", disordered = " << disordered << std::endl;
+    }
+
     return 0;
 }
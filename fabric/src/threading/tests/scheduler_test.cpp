@@ -1,4 +1,7 @@
+#include <deque>
 #include <iostream>
+#include <set>
+#include <vector>
 
 #include "src/threading/scheduler.hpp"
 #include "src/vm/structures.hpp"
@@ -20,6 +23,42 @@ public:
     }
 };
 
+const uint32 SERVICE_COUNT = 256;
+
+/// Count the completed services, the last service terminates the scheduler.
+class CountingService : public VMService {
+public:
+    veil::os::atomic_u32_t &completed;
+
+    explicit CountingService(veil::os::atomic_u32_t &completed) : VMService("counting-service"), completed(completed) {}
+
+    void run() override {
+        if (completed.fetch_add(1) == SERVICE_COUNT) this->veil::vm::HasRoot<Scheduler>::root()->terminate();
+    }
+};
+
+const uint32 POOLED_SERVICE_COUNT = 64;
+const uint32 POOL_MAX_SIZE = 2;
+
+/// Record the OS threads hosting the services, the last service terminates the scheduler.
+class PooledService : public VMService {
+public:
+    veil::os::atomic_u32_t &completed;
+    veil::os::Mutex &threads_m;
+    std::set<uint64> &threads;
+
+    PooledService(veil::os::atomic_u32_t &completed, veil::os::Mutex &threads_m, std::set<uint64> &threads) :
+            VMService("pooled-service"), completed(completed), threads_m(threads_m), threads(threads) {}
+
+    void run() override {
+        {
+            veil::os::CriticalSection _(threads_m);
+            threads.insert(veil::os::Thread::current_thread_id());
+        }
+        if (completed.fetch_add(1) == POOLED_SERVICE_COUNT) this->veil::vm::HasRoot<Scheduler>::root()->terminate();
+    }
+};
+
 int main() {
     Scheduler scheduler;
 
@@ -32,5 +71,46 @@ int main() {
 
     scheduler.start();
 
+    std::cout << "Begin test on sharded scheduler, expects: workers = 4, completed = " << SERVICE_COUNT << std::endl;
+    {
+        Scheduler sharded_scheduler(4);
+        veil::os::atomic_u32_t completed(0);
+        std::vector<CountingService *> services;
+        // The tasks are neither copyable nor allocatable on the heap individually.
+        std::deque<Scheduler::StartServiceTask> tasks;
+        for (uint32 index = 0; index < SERVICE_COUNT; index++) {
+            services.push_back(new CountingService(completed));
+            tasks.emplace_back(*services.back());
+            sharded_scheduler.add_task(tasks.back());
+        }
+        sharded_scheduler.start();
+        std::cout << "Test result: workers = " << sharded_scheduler.get_worker_count() << ", completed = "
+                  << completed.load() << std::endl;
+        tasks.clear();
+        for (CountingService *service: services) delete service;
+    }
+
+    std::cout << "Begin test on pooled threads, expects: threads = " << POOL_MAX_SIZE << ", completed = "
+              << POOLED_SERVICE_COUNT << ", bounded = 1" << std::endl;
+    {
+        // The services beyond the pool are deferred until a thread returns, and are hosted by the same OS threads.
+        Scheduler pooled_scheduler(1, POOL_MAX_SIZE, POOL_MAX_SIZE);
+        veil::os::atomic_u32_t completed(0);
+        veil::os::Mutex threads_m;
+        std::set<uint64> threads;
+        std::vector<PooledService *> services;
+        std::deque<Scheduler::StartServiceTask> tasks;
+        for (uint32 index = 0; index < POOLED_SERVICE_COUNT; index++) {
+            services.push_back(new PooledService(completed, threads_m, threads));
+            tasks.emplace_back(*services.back());
+            pooled_scheduler.add_task(tasks.back());
+        }
+        pooled_scheduler.start();
+        std::cout << "Test result: threads = " << pooled_scheduler.get_thread_count() << ", completed = "
+                  << completed.load() << ", bounded = " << (threads.size() <= POOL_MAX_SIZE) << std::endl;
+        tasks.clear();
+        for (PooledService *service: services) delete service;
+    }
+
     return 0;
 }
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "src/threading/thin-lock.hpp"
+
+using namespace veil::threading;
+
+/// Increment the \a count under the \a lock, each increment is performed with a reentrant acquisition.
+void increment(ThinLockClient *client, ThinLock *lock, uint32 *count, uint32 iteration_count) {
+    for (uint32 i = 0; i < iteration_count; i++) {
+        client->wait(*lock);
+        client->wait(*lock);
+        (*count)++;
+        client->exit(*lock);
+        client->exit(*lock);
+    }
+}
+
+/// Increment the \a count under the \a lock while holding it for a while, which inflates the lock of the contenders.
+void increment_slowly(ThinLockClient *client, ThinLock *lock, uint32 *count, uint32 iteration_count) {
+    for (uint32 i = 0; i < iteration_count; i++) {
+        client->wait(*lock);
+        uint32 value = *count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        *count = value + 1;
+        client->exit(*lock);
+    }
+}
+
+int main() {
+    const uint32 THREAD_COUNT = 4;
+    const uint32 ITERATION_COUNT = 65536;
+    ThinLockClient clients[THREAD_COUNT];
+
+    uint32 count = 0;
+    std::cout << "Begin test on biased lock, expects: count = " << ITERATION_COUNT << std::endl;
+    {
+        ThinLock lock;
+        lock.bias(clients[0]);
+        std::thread thread(increment, &clients[0], &lock, &count, ITERATION_COUNT);
+        thread.join();
+    }
+    std::cout << "Test result: count = " << count << std::endl;
+
+    count = 0;
+    std::cout << "Begin test on bias revocation, expects: count = " << ITERATION_COUNT * THREAD_COUNT << std::endl;
+    {
+        ThinLock lock;
+        lock.bias(clients[0]);
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            threads.emplace_back(increment, &clients[i], &lock, &count, ITERATION_COUNT);
+        for (std::thread &thread: threads) thread.join();
+    }
+    std::cout << "Test result: count = " << count << std::endl;
+
+    count = 0;
+    std::cout << "Begin test on bias restoration, expects: count = " << ITERATION_COUNT * 2 << ", biased = 1"
+              << std::endl;
+    {
+        ThinLock lock;
+        lock.bias(clients[0]);
+        ThinLockClient visitor(true);
+        std::thread owner_thread(increment, &clients[0], &lock, &count, ITERATION_COUNT);
+        owner_thread.join();
+        // The visitor revokes the bias on each acquisition and restores it on each release.
+        std::thread visitor_thread(increment, &visitor, &lock, &count, ITERATION_COUNT);
+        visitor_thread.join();
+        bool biased = lock.is_biased() && clients[0].try_wait(lock);
+        if (biased) clients[0].exit(lock);
+        std::cout << "Test result: count = " << count << ", biased = " << biased << std::endl;
+    }
+
+    count = 0;
+    std::cout << "Begin test on lock inflation, expects: count = " << 64 * THREAD_COUNT << std::endl;
+    {
+        ThinLock lock;
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < THREAD_COUNT; i++)
+            threads.emplace_back(increment_slowly, &clients[i], &lock, &count, 64);
+        for (std::thread &thread: threads) thread.join();
+    }
+    std::cout << "Test result: count = " << count << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "src/threading/thin-lock.hpp"
+#include "src/threading/config.hpp"
+#include "src/threading/os.hpp"
+
+using namespace veil::threading;
+
+ThinLock::ThinLock() : word(WORD_UNLOCKED), biased_holding(0), reentrance_count(0) {}
+
+void ThinLock::bias(ThinLockClient &client) {
+    this->word.store(client.identity() | TAG_BIASED);
+}
+
+bool ThinLock::is_biased() const { return (this->word.load() & WORD_FLAGS) == TAG_BIASED; }
+
+ThinLockClient::ThinLockClient(bool rebiasing) : rebiasing(rebiasing), revoked_lock(nullptr), revoked_word(0) {}
+
+void ThinLockClient::wait(ThinLock &target) {
+    uint64 self = this->identity();
+    uint32 spin_count = 0;
+    // The biased lock word observed by this client, which is restored by a rebiasing client on its release.
+    uint64 revoked = ThinLock::WORD_UNLOCKED;
+    while (true) {
+        uint64 word = target.word.load();
+
+        if ((word & ~ThinLock::WORD_FLAGS) == self) {
+            // The lock is either biased towards or thinly held by this client, which is the only writer of the word
+            // beside the pending flag.
+            if (word & ThinLock::TAG_THIN || target.biased_holding.load()) {
+                target.reentrance_count++;
+                return;
+            }
+            if (!(word & ThinLock::FLAG_PENDING)) {
+                // The holding flag is published before the word is checked again, while a revoker publishes the
+                // pending flag before it checks the holding flag; thus at least one of them observes the other.
+                target.biased_holding.store(1);
+                if (target.word.load() == word) return;
+                target.biased_holding.store(0);
+            }
+            // The bias is being revoked, the lock is competed as a thin lock once the revocation completes.
+            os::Thread::static_sleep(0);
+            continue;
+        }
+
+        if (word == ThinLock::WORD_UNLOCKED) {
+            if (target.word.compare_exchange(word, self | ThinLock::TAG_THIN) != word) continue;
+            if (this->rebiasing && revoked != ThinLock::WORD_UNLOCKED) {
+                this->revoked_lock = &target;
+                this->revoked_word = revoked;
+            }
+            return;
+        }
+
+        if (word & ThinLock::TAG_BIASED) {
+            revoked = (word & ~ThinLock::WORD_FLAGS) | ThinLock::TAG_BIASED;
+            if (!(word & ThinLock::FLAG_PENDING)) {
+                (void) target.word.compare_exchange(word, word | ThinLock::FLAG_PENDING);
+                continue;
+            }
+            // Any revoker completes the revocation once the biased client is not holding the lock.
+            if (!target.biased_holding.load()) (void) target.word.compare_exchange(word, ThinLock::WORD_UNLOCKED);
+            else os::Thread::static_sleep(0);
+            continue;
+        }
+
+        if (word & ThinLock::TAG_THIN && !(word & ThinLock::FLAG_PENDING)) {
+            if (spin_count++ < config::mutex_spin_count) {
+                os::Thread::static_sleep(0);
+                continue;
+            }
+            // The holder inflates the lock on its release.
+            (void) target.word.compare_exchange(word, word | ThinLock::FLAG_PENDING);
+            continue;
+        }
+
+        // The lock is inflated or being inflated, the first client of the queue waits for the thin holder to hand
+        // over the lock.
+        this->queue_client.wait(target);
+        while (target.word.load() != ThinLock::WORD_INFLATED) os::Thread::static_sleep(0);
+        return;
+    }
+}
+
+void ThinLockClient::exit(ThinLock &target) {
+    uint64 word = target.word.load();
+    if ((word & ~ThinLock::WORD_FLAGS) != this->identity()) {
+        this->queue_client.exit(target);
+        return;
+    }
+    if (target.reentrance_count) {
+        target.reentrance_count--;
+        return;
+    }
+    if (word & ThinLock::TAG_BIASED) {
+        target.biased_holding.store(0);
+        return;
+    }
+    // The biased client is not holding the lock since the revocation, thus the bias is restored as a release.
+    uint64 released = ThinLock::WORD_UNLOCKED;
+    if (this->revoked_lock == &target) {
+        released = this->revoked_word;
+        this->revoked_lock = nullptr;
+    }
+    // The exchange fails only if a contender has set the pending flag, which is only set while the lock is held.
+    uint64 thin = this->identity() | ThinLock::TAG_THIN;
+    if (target.word.compare_exchange(thin, released) != thin) target.word.store(ThinLock::WORD_INFLATED);
+}
@@ -0,0 +1,141 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_THREADING_THIN_LOCK_HPP
+#define VEIL_FABRIC_SRC_THREADING_THIN_LOCK_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/threading/ordered-queue.hpp"
+
+namespace veil::threading {
+
+    class ThinLockClient;
+
+    /// A reentrant lock designed to be embedded in a large set of objects, most of which are only ever locked by a
+    /// single thread. The state of the lock is a single lock word, which goes through the following modes:
+    /// <ul>
+    ///     <li> <b>Biased</b>: The lock is reserved for the <code>ThinLockClient</code> given to <code>ThinLock::bias
+    ///          </code>, which acquires and releases the lock without any read-modify-write operation. Another client
+    ///          revokes the bias once it requests the lock, and waits until the biased client is not holding it. A
+    ///          rebiasing client restores the bias it revoked once it releases the lock. </li>
+    ///     <li> <b>Thin</b>: The lock is acquired by a compare & exchange of the lock word from the unlocked state to
+    ///          the identity of the client, and released by the reverse operation. </li>
+    ///     <li> <b>Inflated</b>: Once a client has spun on a thin lock held by another client for
+    ///          <code>config::mutex_spin_count</code> times, the lock is inflated to the embedded <code>OrderedQueue
+    ///          </code>, which the subsequent acquisitions are ordered by. The first client in the queue takes over the
+    ///          lock once the thin holder releases it. An inflated lock stays inflated. </li>
+    /// </ul>
+    /// \sa ThinLockClient
+    class ThinLock : private OrderedQueue {
+    public:
+        ThinLock();
+
+        /// Bias the lock towards the <code>client</code>, which is typically the client of the thread creating the
+        /// object embedding the lock.
+        /// \attention This method must only be invoked before the lock is shared with any other thread.
+        void bias(ThinLockClient &client);
+
+        /// \return Whether the lock is biased towards a client, and the bias is not being revoked.
+        [[nodiscard]] bool is_biased() const;
+
+    private:
+        /// The unlocked lock word.
+        static const uint64 WORD_UNLOCKED = 0;
+        /// The tag of a lock word holding the identity of the thin holder.
+        static const uint64 TAG_THIN = 1;
+        /// The tag of a lock word holding the identity of the biased client.
+        static const uint64 TAG_BIASED = 2;
+        /// The flag set by a contender onto a thin lock word, which requests the holder to inflate the lock on
+        /// release; or onto a biased lock word, which revokes the bias.
+        static const uint64 FLAG_PENDING = 4;
+        /// The lock word of an inflated lock.
+        static const uint64 WORD_INFLATED = FLAG_PENDING;
+        static const uint64 WORD_FLAGS = TAG_THIN | TAG_BIASED | FLAG_PENDING;
+
+        os::atomic_u64_t word;
+        /// Whether the biased client is holding the lock, only set by the biased client.
+        os::atomic_u32_t biased_holding;
+        /// The count of reentrant acquisitions of a biased or thin holder, only modified by the holder.
+        uint32 reentrance_count;
+
+        friend class ThinLockClient;
+    };
+
+    /// The identity of a thread acquiring <code>ThinLock</code> objects, each thread must use its own client; an
+    /// <code>OrderedQueueClient</code> is embedded to acquire the inflated locks.
+    class ThinLockClient : public memory::ValueObject {
+    public:
+        /// \param rebiasing Whether the bias revoked by this client is restored once it releases the lock, which suits
+        ///                  a client visiting the objects of the other threads transiently, such as a collector.
+        explicit ThinLockClient(bool rebiasing = false);
+
+        /// Wait on the <code>target</code> for exclusive access, this method will not return until the exclusive access
+        /// right is acquired.
+        void wait(ThinLock &target);
+
+        /// Leaving the state of exclusive access to the <code>target</code>.
+        void exit(ThinLock &target);
+
+        /// The inline fast path of <code>ThinLockClient::wait</code>, which only acquires the <code>target</code> if it
+        /// is biased towards this client and not held.
+        /// \return Whether the exclusive access right is acquired, otherwise <code>ThinLockClient::wait</code> must be
+        /// invoked.
+        inline bool try_wait(ThinLock &target);
+
+        /// The inline fast path of <code>ThinLockClient::exit</code>, which only releases the <code>target</code> if it
+        /// is biased towards this client and held without reentrance.
+        /// \return Whether the <code>target</code> is released, otherwise <code>ThinLockClient::exit</code> must be
+        /// invoked.
+        inline bool try_exit(ThinLock &target);
+
+    private:
+        /// The client used for the inflated locks.
+        OrderedQueueClient queue_client;
+        const bool rebiasing;
+        /// The lock held by this rebiasing client whose bias is revoked by it, and the biased lock word restored once
+        /// the lock is released; a single lock is tracked as a rebiasing client visits one object at a time.
+        ThinLock *revoked_lock;
+        uint64 revoked_word;
+
+        /// \return The lock word of this client holding or biasing a lock, which is the address of this client.
+        [[nodiscard]] inline uint64 identity() const { return reinterpret_cast<uint64>(this); }
+
+        friend class ThinLock;
+    };
+
+    inline bool ThinLockClient::try_wait(ThinLock &target) {
+        uint64 biased = this->identity() | ThinLock::TAG_BIASED;
+        if (target.word.load() != biased || target.biased_holding.load()) return false;
+        // The same handshake against the revokers as ThinLockClient::wait.
+        target.biased_holding.store(1);
+        if (target.word.load() == biased) return true;
+        target.biased_holding.store(0);
+        return false;
+    }
+
+    inline bool ThinLockClient::try_exit(ThinLock &target) {
+        uint64 word = target.word.load();
+        if ((word & ~ThinLock::WORD_FLAGS) != this->identity() || !(word & ThinLock::TAG_BIASED) ||
+            target.reentrance_count)
+            return false;
+        target.biased_holding.store(0);
+        return true;
+    }
+
+}
+
+#endif //VEIL_FABRIC_SRC_THREADING_THIN_LOCK_HPP
@@ -0,0 +1,168 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_THREADING_WORK_STEALING_DEQUE_HPP
+#define VEIL_FABRIC_SRC_THREADING_WORK_STEALING_DEQUE_HPP
+
+#include "src/typedefs.hpp"
+#include "src/memory/global.hpp"
+#include "src/memory/os.hpp"
+#include "src/threading/atomic.hpp"
+#include "src/vm/diagnostics.hpp"
+
+namespace veil::threading {
+
+    /// A lock-free deque of the elements owned by a single thread, which pushes and pops the elements at the bottom in
+    /// the last-in-first-out order, while any other thread steals the elements at the top in the first-in-first-out
+    /// order (the Chase-Lev deque). The owner only contends with the thieves when a single element is left, which is
+    /// resolved by a compare-exchange on the top; thus the owner works on its recent elements without any
+    /// synchronization while the thieves take the oldest elements, which are usually the largest pieces of work.
+    /// <br><br>
+    /// A bounded deque rejects the push once full, for the owner to overflow the element elsewhere; a growable deque
+    /// doubles its circular buffer instead. The replaced buffers are kept until the deque is destructed as a thief
+    /// might still be reading them, which costs less than the current buffer in total.
+    /// \attention The deque stores the pointers of the elements only, the elements must outlive their stay.
+    template<typename T>
+    class WorkStealingDeque : public memory::ValueObject {
+    public:
+        /// \param capacity The initial maximum number of the elements, which must be a power of 2.
+        /// \param growable Whether the capacity is doubled when the deque is full, instead of rejecting the push.
+        explicit WorkStealingDeque(uint64 capacity, bool growable = false);
+
+        ~WorkStealingDeque();
+
+        /// Push the <code>element</code> at the bottom, only invoked by the owner.
+        /// \return Whether the element is pushed, or <code>false</code> if the deque is bounded and full.
+        bool push(T *element);
+
+        /// Pop the element at the bottom, only invoked by the owner.
+        /// \return The element pushed last, or <code>nullptr</code> if the deque is empty or the last element is
+        ///         stolen.
+        T *pop();
+
+        /// Steal the element at the top, which is safe to be invoked by any number of threads concurrently.
+        /// \return The element pushed first, or <code>nullptr</code> if the deque is empty or another thread won the
+        ///         element.
+        T *steal();
+
+        [[nodiscard]] bool is_empty() const;
+
+    private:
+        struct Buffer;
+
+        const bool growable;
+        /// The index of the next element to be stolen, only advanced.
+        os::atomic_u64_t top;
+        /// The index of the next element to be pushed, only modified by the owner.
+        os::atomic_u64_t bottom;
+        os::atomic_pointer_t<Buffer> buffer;
+        /// The buffers replaced by the growth, linked by <code>Buffer::next</code>.
+        Buffer *retired;
+    };
+
+    /// A circular buffer of a capacity of a power of 2, the slots are atomic as a thief reads the slot written by the
+    /// owner without any other synchronization.
+    template<typename T>
+    struct WorkStealingDeque<T>::Buffer : public memory::HeapObject {
+        /// The indices are mapped to the slots by the mask.
+        const uint64 mask;
+        os::atomic_pointer_t<T> *slots;
+        Buffer *next;
+
+        explicit Buffer(uint64 capacity) : mask(capacity - 1), next(nullptr) {
+            VeilAssert(capacity && !(capacity & (capacity - 1)), "The capacity must be a power of 2.");
+            this->slots = static_cast<os::atomic_pointer_t<T> *>(
+                    os::malloc(capacity * sizeof(os::atomic_pointer_t<T>)));
+            for (uint64 index = 0; index < capacity; index++)
+                ::new(&this->slots[index]) os::atomic_pointer_t<T>(nullptr);
+        }
+
+        ~Buffer() { os::free(this->slots); }
+
+        os::atomic_pointer_t<T> &at(uint64 index) { return this->slots[index & this->mask]; }
+    };
+
+    template<typename T>
+    WorkStealingDeque<T>::WorkStealingDeque(uint64 capacity, bool growable) :
+            growable(growable), top(0), bottom(0), buffer(new Buffer(capacity)), retired(nullptr) {}
+
+    template<typename T>
+    WorkStealingDeque<T>::~WorkStealingDeque() {
+        delete this->buffer.load();
+        while (this->retired) {
+            Buffer *next = this->retired->next;
+            delete this->retired;
+            this->retired = next;
+        }
+    }
+
+    template<typename T>
+    bool WorkStealingDeque<T>::push(T *element) {
+        uint64 b = bottom.load();
+        uint64 t = top.load();
+        Buffer *current = buffer.load();
+        if (b - t > current->mask) {
+            if (!growable) return false;
+            auto *grown = new Buffer((current->mask + 1) * 2);
+            for (uint64 index = t; index < b; index++) grown->at(index).store(current->at(index).load());
+            current->next = this->retired;
+            this->retired = current;
+            buffer.store(grown);
+            current = grown;
+        }
+        current->at(b).store(element);
+        // The element is published to the thieves by the advance of the bottom.
+        bottom.store(b + 1);
+        return true;
+    }
+
+    template<typename T>
+    T *WorkStealingDeque<T>::pop() {
+        // The bottom is reserved before the top is read, thus a thief reading the bottom afterwards will not take the
+        // element reserved; all of these are sequentially consistent.
+        uint64 b = bottom.load() - 1;
+        Buffer *current = buffer.load();
+        bottom.store(b);
+        uint64 t = top.load();
+        // The indices are compared by their signed difference, as the reserved bottom is below the top if empty.
+        if (static_cast<int64>(b - t) < 0) {
+            bottom.store(t);
+            return nullptr;
+        }
+        T *element = current->at(b).load();
+        if (b != t) return element;
+        // The last element might be stolen concurrently, which is resolved by advancing the top.
+        bool won = top.compare_exchange(t, t + 1) == t;
+        bottom.store(t + 1);
+        return won ? element : nullptr;
+    }
+
+    template<typename T>
+    T *WorkStealingDeque<T>::steal() {
+        uint64 t = top.load();
+        uint64 b = bottom.load();
+        if (static_cast<int64>(b - t) <= 0) return nullptr;
+        // The element is read before the top is advanced, after which the owner might overwrite the slot; a replaced
+        // buffer still holds the elements between the top and the bottom at the time it is replaced.
+        T *element = buffer.load()->at(t).load();
+        return top.compare_exchange(t, t + 1) == t ? element : nullptr;
+    }
+
+    template<typename T>
+    bool WorkStealingDeque<T>::is_empty() const { return static_cast<int64>(bottom.load() - top.load()) <= 0; }
+
+}
+
+#endif //VEIL_FABRIC_SRC_THREADING_WORK_STEALING_DEQUE_HPP
@@ -0,0 +1,52 @@
+/// This file is part of the Veil distribution (https://github.com/Alphaharrius/Veil).
+/// Copyright (c) 2023 Alphaharrius.
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, version 3.
+///
+/// This program is distributed in the hope that it will be useful, but
+/// WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+/// General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VEIL_FABRIC_SRC_UTIL_BITS_HPP
+#define VEIL_FABRIC_SRC_UTIL_BITS_HPP
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "src/typedefs.hpp"
+
+namespace veil::util {
+
+    /// \return The index of the least significant set bit of \a value, the result is undefined if \a value is 0.
+    /// \attention Defined inline as this is used within the hot loops of the bitmap scanning of the arenas.
+    inline uint32 count_trailing_zeros(uint64 value) {
+#   if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32>(index);
+#   else
+        return static_cast<uint32>(__builtin_ctzll(value));
+#   endif
+    }
+
+    /// \return The number of the leading zero bits of \a value, the result is undefined if \a value is 0.
+    inline uint32 count_leading_zeros(uint64 value) {
+#   if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - static_cast<uint32>(index);
+#   else
+        return static_cast<uint32>(__builtin_clzll(value));
+#   endif
+    }
+
+}
+
+#endif //VEIL_FABRIC_SRC_UTIL_BITS_HPP
@@ -100,4 +100,27 @@ void veil::print_callstack_trace() {
 }
 // @formatter:on
 
+// @formatter:off
+int32 veil::capture_callstack(void **frames, int32 max_count, int32 skip_count) {
+    static const int32 MAX_SKIP_COUNT = 8;
+    // Skip this function itself as well.
+    skip_count = (skip_count < MAX_SKIP_COUNT ? skip_count : MAX_SKIP_COUNT) + 1;
+    if (max_count <= 0) return 0;
+
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    return CaptureStackBackTrace(skip_count, max_count, frames, nullptr);
+#   elif defined(__linux__) || defined(__linux) || defined(linux)
+    // The glibc backtrace does not support skipping frames, the skipped frames are captured into a larger buffer.
+    static const int32 MAX_BUFFER_COUNT = 64;
+    void *buffer[MAX_BUFFER_COUNT];
+    int32 buffer_count = max_count + skip_count < MAX_BUFFER_COUNT ? max_count + skip_count : MAX_BUFFER_COUNT;
+    int32 count = backtrace(buffer, buffer_count) - skip_count;
+    for (int32 i = 0; i < count; i++) frames[i] = buffer[i + skip_count];
+    return count > 0 ? count : 0;
+#   else
+    return 0;
+#   endif
+}
+// @formatter:on
+
 #pragma clang diagnostic pop
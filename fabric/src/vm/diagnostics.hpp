@@ -44,6 +44,13 @@ namespace veil {
 
     void print_callstack_trace();
 
+    /// Capture the return addresses of the callstack of the calling thread, the innermost frame first.
+    /// \param frames      The buffer receiving the return addresses.
+    /// \param max_count   The capacity of the \c frames buffer.
+    /// \param skip_count  The number of the innermost frames to be skipped, excluding this function itself.
+    /// \return            The number of the captured frames, which is 0 if the platform does not support stack tracing.
+    int32 capture_callstack(void **frames, int32 max_count, int32 skip_count = 0);
+
 }
 
 #define VeilGetLineInfo veil::LineInfo(__FILE__, __func__, __LINE__)
@@ -20,6 +20,7 @@
 #elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
 
 #include <sys/time.h>
+#include <time.h>
 
 #endif
 
@@ -42,3 +43,20 @@ uint64 veil::os::current_time_milliseconds() {
     return ((uint64) now.tv_sec) * 1000ULL + (uint64) (now.tv_usec / 1000);
 #   endif
 }
+
+uint64 veil::os::current_time_nanoseconds() {
+#   if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    LARGE_INTEGER counter, frequency;
+    // These will always succeed on Windows XP or later.
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    // The counter is split to avoid the overflow of the multiplication.
+    uint64 seconds = counter.QuadPart / frequency.QuadPart;
+    uint64 remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000000ULL + remainder * 1000000000ULL / frequency.QuadPart;
+#   elif defined(__linux__) || defined(__linux) || defined(linux) || defined(__CYGWIN__)
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64) now.tv_sec) * 1000000000ULL + (uint64) now.tv_nsec;
+#   endif
+}
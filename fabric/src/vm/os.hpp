@@ -22,6 +22,10 @@ namespace veil::os {
 
     uint64 current_time_milliseconds();
 
+    /// \return The nanoseconds elapsed from an arbitrary point of time, which is monotonic thus suitable for measuring
+    ///         durations.
+    uint64 current_time_nanoseconds();
+
 }
 
 #endif //VEIL_FABRIC_SRC_VM_OS_HPP
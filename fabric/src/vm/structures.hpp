@@ -110,6 +110,8 @@ namespace veil::vm {
 
         M *member();
 
+        [[nodiscard]] bool is_bound() const;
+
     private:
         M *target;
     };
@@ -131,6 +133,11 @@ namespace veil::vm {
         this->HasMember<M>::target = nullptr;
     }
 
+    template<class M>
+    bool HasMember<M>::is_bound() const {
+        return this->HasMember<M>::target != nullptr;
+    }
+
     class Executable {
     public:
         virtual void execute() = 0;